@@ -21,8 +21,11 @@
 #include <string.h>
 #include <time.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "demo.h"
+#include "demo_dir.h"
+#include "demo_scan.h"
 #include "audio.h"
 #include "config.h"
 #include "binary.h"
@@ -30,17 +33,26 @@
 #include "level.h"
 #include "array.h"
 #include "dir.h"
+#include "writer.h"
 
 #include "game_server.h"
 #include "game_client.h"
 #include "game_proxy.h"
 #include "game_common.h"
 
-#define DEMO_MAGIC (0xAF | 'N' << 8 | 'B' << 16 | 'R' << 24)
-#define DEMO_VERSION 9
-
 #define DATELEN sizeof ("YYYY-MM-DDTHH:MM:SS")
 
+/* Updates between key frames, and the most a seek index can hold. */
+
+#define KEY_UPDATES (UPS * 4)
+#define KEY_MAX     (SHRT_MAX / (INDEX_BYTES * 2) - 1)
+
+/* Updates between snapshots of the replay history. */
+
+#define HISTORY_UPDATES (UPS / 2)
+
+#define PLAY_BUFFER 4096                /* Bytes of an update, at most       */
+
 fs_file demo_fp;
 
 /*---------------------------------------------------------------------------*/
@@ -75,9 +87,13 @@ static int demo_header_read(fs_file fp, struct demo *d)
 
     t = get_index(fp);
 
-    if (magic == DEMO_MAGIC && version == DEMO_VERSION && t)
+    if (magic == DEMO_MAGIC && t &&
+        version >= DEMO_VERSION_MIN && version <= DEMO_VERSION)
     {
-        d->timer = t;
+        int flags;
+
+        d->version = version;
+        d->timer   = t;
 
         d->coins  = get_index(fp);
         d->status = get_index(fp);
@@ -106,11 +122,13 @@ static int demo_header_read(fs_file fp, struct demo *d)
 
         d->time  = get_index(fp);
         d->goal  = get_index(fp);
-        (void)     get_index(fp);
+        flags    = get_index(fp);
         d->score = get_index(fp);
         d->balls = get_index(fp);
         d->times = get_index(fp);
 
+        d->flags = (version >= 10) ? flags : 0;
+
         return 1;
     }
     return 0;
@@ -137,7 +155,7 @@ static void demo_header_write(fs_file fp, struct demo *d)
 
     put_index(fp, d->time);
     put_index(fp, d->goal);
-    put_index(fp, 0);                   /* Unused (was goal enabled flag).   */
+    put_index(fp, d->flags);            /* Was goal enabled flag.            */
     put_index(fp, d->score);
     put_index(fp, d->balls);
     put_index(fp, d->times);
@@ -272,11 +290,53 @@ const char *demo_format_name(const char *fmt,
 
 static struct demo demo_play;
 
+/*
+ * Key frames written so far: update number and file offset of each.
+ */
+static Array play_keys;
+static int   play_updates;
+
+static struct cmd_stream play_stream;
+static long              play_head;     /* Length of the header              */
+
+/*
+ * Recorded commands are gathered in memory, in demo_fp, and handed to
+ * a writer once per update.  PLAY_BASE is the offset in the file of the
+ * start of demo_fp.
+ */
+static struct writer *play_writer;
+static long           play_base;
+
+/*
+ * What to do with the file once the writer is done with it.
+ */
+struct demo_save
+{
+    char path[MAXSTR];
+    int  discard;
+};
+
+static struct demo_save play_save;
+
+static void demo_play_flush(void);
+static void demo_play_flags(int);
+
+struct demo_key
+{
+    int        u;                       /* Updates played at the key frame   */
+    long       pos;                     /* Offset of the key frame command   */
+    union cmd *cmd;                     /* Key frame, if not in the file     */
+
+    struct cmd_delta *delta;            /* Stream state, if not in the file  */
+};
+
 int demo_play_init(const char *name, const struct level *level,
                    int mode, int scores, int balls, int times)
 {
     struct demo *d = &demo_play;
 
+    demo_play_wait(-1);
+
     memset(d, 0, sizeof (*d));
 
     SAFECPY(d->path,   demo_path(name));
@@ -285,6 +345,9 @@ int demo_play_init(const char *name, const struct level *level,
     SAFECPY(d->shot,   level_shot(level));
     SAFECPY(d->file,   level_file(level));
 
+    d->version = DEMO_VERSION;
+    d->flags   = config_get_d(CONFIG_REPLAY_DEFLATE) ? DEMO_DEFLATE : 0;
+
     d->mode  = mode;
     d->date  = time(NULL);
     d->time  = level_time(level);
@@ -293,27 +356,172 @@ int demo_play_init(const char *name, const struct level *level,
     d->balls = balls;
     d->times = times;
 
-    if ((demo_fp = fs_open_write(d->path)))
+    play_updates = 0;
+
+    if (!play_keys)
+        play_keys = array_new(sizeof (struct demo_key));
+
+    while (array_len(play_keys))
+        array_del(play_keys);
+
+    cmd_stream_init(&play_stream, DEMO_VERSION);
+
+    if ((play_writer = writer_open(d->path)))
     {
-        demo_header_write(demo_fp, d);
-        return 1;
+        if ((demo_fp = fs_open_mem_write(PLAY_BUFFER)))
+        {
+            demo_header_write(demo_fp, d);
+            play_head = fs_tell(demo_fp);
+            play_base = 0;
+
+            /* The header stays as it is, so that listing replays does
+             * not need to inflate anything. */
+
+            if (d->flags & DEMO_DEFLATE)
+            {
+                demo_play_flush();
+
+                if (!writer_deflate(play_writer))
+                {
+                    d->flags &= ~DEMO_DEFLATE;
+                    demo_play_flags(d->flags);
+                }
+            }
+            return 1;
+        }
+
+        writer_close(play_writer, NULL, NULL);
+        writer_wait(play_writer, -1);
+        play_writer = NULL;
     }
     return 0;
 }
 
-void demo_play_stat(int status, int coins, int timer)
+/*
+ * Hand what was recorded to the writer.
+ */
+static void demo_play_flush(void)
+{
+    void *data;
+    int size;
+
+    if ((data = fs_mem_data(demo_fp, &size)) && size > 0)
+    {
+        writer_put(play_writer, data, size);
+        fs_seek(demo_fp, 0, SEEK_SET);
+        play_base += size;
+    }
+}
+
+/*
+ * Record a command.  The client calls this for each one it runs.
+ */
+void demo_play_put(const union cmd *cmd)
 {
     if (demo_fp)
+        cmd_put_stream(demo_fp, &play_stream, cmd);
+}
+
+/*
+ * Count a recorded update and write a key frame every so often.  The
+ * client calls this after each update it writes.
+ */
+void demo_play_step(void)
+{
+    struct demo_key *kp;
+    union cmd cmd;
+
+    if (!demo_fp)
+        return;
+
+    demo_play_flush();
+
+    if (++play_updates % KEY_UPDATES != 0)
+        return;
+
+    if (play_keys && array_len(play_keys) < KEY_MAX && game_client_save(&cmd))
     {
-        long pos = fs_tell(demo_fp);
+        /* Skip key frames too large for a command. */
+
+        if (INDEX_BYTES * (2 + cmd.keyframe.ic) +
+            ARRAY_BYTES(cmd.keyframe.fc) <= SHRT_MAX &&
+            (kp = array_add(play_keys)))
+        {
+            kp->u     = play_updates;
+            kp->pos   = play_base + fs_tell(demo_fp);
+            kp->cmd   = NULL;
+            kp->delta = NULL;
+
+            cmd_put_stream(demo_fp, &play_stream, &cmd);
+        }
+        cmd_clear(&cmd);
+    }
+}
 
-        fs_seek(demo_fp, 8, SEEK_SET);
+/*
+ * Close the replay with the index of its key frames.
+ */
+static void demo_play_index(void)
+{
+    union cmd cmd;
+    int i, n = play_keys ? array_len(play_keys) : 0;
 
-        put_index(demo_fp, timer);
-        put_index(demo_fp, coins);
-        put_index(demo_fp, status);
+    cmd.type = CMD_SEEK_INDEX;
 
-        fs_seek(demo_fp, pos, SEEK_SET);
+    cmd.seekindex.n   = n;
+    cmd.seekindex.uv  = n ? malloc(n * sizeof (int)) : NULL;
+    cmd.seekindex.pv  = n ? malloc(n * sizeof (int)) : NULL;
+    cmd.seekindex.pos = (int) (play_base + fs_tell(demo_fp));
+
+    if (n && (!cmd.seekindex.uv || !cmd.seekindex.pv))
+    {
+        cmd_clear(&cmd);
+        return;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        const struct demo_key *kp = array_get(play_keys, i);
+
+        cmd.seekindex.uv[i] = kp->u;
+        cmd.seekindex.pv[i] = (int) kp->pos;
+    }
+
+    cmd_put_stream(demo_fp, &play_stream, &cmd);
+    cmd_clear(&cmd);
+}
+
+static void put_le(unsigned char *p, int v)
+{
+    p[0] = (v)       & 0xff;
+    p[1] = (v >> 8)  & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+/*
+ * Rewrite the header flags.  They are followed by three more values.
+ */
+static void demo_play_flags(int flags)
+{
+    unsigned char buf[INDEX_BYTES];
+
+    put_le(buf, flags);
+    writer_patch(play_writer, play_head - INDEX_BYTES * 4, buf, sizeof (buf));
+}
+
+void demo_play_stat(int status, int coins, int timer)
+{
+    unsigned char buf[INDEX_BYTES * 3];
+
+    if (demo_fp)
+    {
+        put_le(buf + INDEX_BYTES * 0, timer);
+        put_le(buf + INDEX_BYTES * 1, coins);
+        put_le(buf + INDEX_BYTES * 2, status);
+
+        demo_play_flush();
+        writer_patch(play_writer, 8, buf, sizeof (buf));
     }
 }
 
@@ -327,21 +535,64 @@ static void demo_refresh(void)
     return;
 }
 
+/*
+ * Wait up to MS milliseconds, or for good if MS is negative, for the
+ * last replay to be written out.  Returns 1 once it is.
+ */
+int demo_play_wait(int ms)
+{
+    if (play_writer && !demo_fp)
+    {
+        if (!writer_wait(play_writer, ms))
+            return 0;
+
+        play_writer = NULL;
+
+        if (play_save.discard)
+        {
+            fs_remove(play_save.path);
+            demo_dir_remove(play_save.path);
+        }
+        else
+            demo_dir_update(play_save.path);
+
+        demo_refresh();
+    }
+    return 1;
+}
+
+/*
+ * Stop recording.  The rest of the replay is written on the writer
+ * thread; this waits no longer than the replay budget for it.  A
+ * discarded replay is removed once it is written.
+ */
 void demo_play_stop(int d)
 {
     if (demo_fp)
     {
+        if (!d)
+            demo_play_index();
+
+        demo_play_flush();
+
         fs_close(demo_fp);
         demo_fp = NULL;
 
-        if (d) fs_remove(demo_play.path);
+        SAFECPY(play_save.path, demo_play.path);
 
-        demo_refresh();
+        play_save.discard = d;
+
+        writer_close(play_writer, NULL, NULL);
+
+        demo_play_wait(config_get_d(CONFIG_REPLAY_BUDGET));
     }
 }
 
 int demo_saved(void)
 {
+    if (play_writer)
+        return !play_save.discard;
+
     return fs_exists(demo_play.path);
 }
 
@@ -351,11 +602,17 @@ void demo_rename(const char *name)
 
     if (name && *name)
     {
+        demo_play_wait(-1);
+
         SAFECPY(path, demo_path(name));
 
         if (strcmp(demo_play.name, name) != 0 && fs_exists(demo_play.path))
         {
             fs_rename(demo_play.path, path);
+
+            demo_dir_remove(demo_play.path);
+            demo_dir_update(path);
+
             demo_refresh();
         }
     }
@@ -371,15 +628,30 @@ void demo_rename_player(const char *name, const char *player)
 
 static struct lockstep update_step;
 
+static int replay_updates;
+
+static struct cmd_stream replay_stream;
+
+static void demo_history_keep(void);
+
 static void demo_update_read(float dt)
 {
     if (demo_fp)
     {
         union cmd cmd;
 
-        while (cmd_get(demo_fp, &cmd))
+        while (cmd_get_stream(demo_fp, &replay_stream, &cmd))
         {
+            /* Key frames are only read when seeking. */
+
+            if (cmd.type == CMD_KEY_FRAME || cmd.type == CMD_SEEK_INDEX)
+            {
+                cmd_clear(&cmd);
+                continue;
+            }
+
             game_proxy_enq(&cmd);
+            cmd_clear(&cmd);
 
             if (cmd.type == CMD_UPDATES_PER_SECOND)
                 update_step.dt = 1.0f / cmd.ups.n;
@@ -387,6 +659,10 @@ static void demo_update_read(float dt)
             if (cmd.type == CMD_END_OF_UPDATE)
             {
                 game_client_sync(NULL);
+                replay_updates++;
+
+                if (replay_updates % HISTORY_UPDATES == 0)
+                    demo_history_keep();
                 break;
             }
         }
@@ -410,16 +686,375 @@ const char *curr_demo(void)
     return demo_replay.path;
 }
 
+/*
+ * Key frames to seek to.  The first is the state after the initial
+ * update, kept in memory.  The rest come from the seek index at the
+ * end of the replay or, for replays recorded without one, from a scan
+ * of the whole replay on the first seek.
+ */
+static Array replay_keys;
+static int   replay_indexed;
+static int   replay_open;
+
+/*
+ * Snapshots of the client taken every so often during playback, so
+ * that seeking back to a recent moment needs no trip to a key frame
+ * and no more than a few updates played forward.  They are kept in no
+ * order, within the replay history budget.  Those farthest from where
+ * playback is go first.
+ */
+static Array  replay_history;
+static size_t history_bytes;
+static int    history_off;              /* Not while indexing                */
+
+static void demo_key_free(struct demo_key *kp)
+{
+    cmd_free(kp->cmd);
+    free(kp->delta);
+}
+
+static size_t demo_key_bytes(const struct demo_key *kp)
+{
+    return (sizeof (*kp) + sizeof (*kp->cmd) + sizeof (*kp->delta) +
+            sizeof (int)   * kp->cmd->keyframe.ic +
+            sizeof (float) * kp->cmd->keyframe.fc);
+}
+
+static void demo_replay_free_keys(void)
+{
+    int i;
+
+    if (replay_keys)
+    {
+        for (i = 0; i < array_len(replay_keys); i++)
+            demo_key_free(array_get(replay_keys, i));
+
+        array_free(replay_keys);
+        replay_keys = NULL;
+    }
+    replay_indexed = 0;
+
+    if (replay_history)
+    {
+        for (i = 0; i < array_len(replay_history); i++)
+            demo_key_free(array_get(replay_history, i));
+
+        array_free(replay_history);
+        replay_history = NULL;
+    }
+    history_bytes = 0;
+}
+
+/*
+ * Add a key frame of the current state, kept in memory, to KEYS.
+ */
+static struct demo_key *demo_replay_keep(Array keys)
+{
+    struct cmd_delta *delta;
+    struct demo_key *kp;
+    union cmd *cmd;
+
+    if ((cmd = malloc(sizeof (*cmd))))
+    {
+        /* Commands that follow are coded against the stream state. */
+
+        if ((delta = malloc(sizeof (*delta))) &&
+            game_client_save(cmd) && (kp = array_add(keys)))
+        {
+            *delta = replay_stream.delta;
+
+            kp->u     = replay_updates;
+            kp->pos   = fs_tell(demo_fp);
+            kp->cmd   = cmd;
+            kp->delta = delta;
+
+            return kp;
+        }
+
+        cmd_free(cmd);
+        free(delta);
+    }
+    return NULL;
+}
+
+/*
+ * Drop snapshots, farthest first, until the history is within BYTES.
+ */
+static void demo_history_trim(size_t bytes)
+{
+    struct demo_key *kp;
+    int i, j, n;
+
+    while (history_bytes > bytes && (n = array_len(replay_history)))
+    {
+        for (j = 0, i = 1; i < n; i++)
+        {
+            const struct demo_key *kq = array_get(replay_history, i);
+            const struct demo_key *kr = array_get(replay_history, j);
+
+            if (abs(kq->u - replay_updates) > abs(kr->u - replay_updates))
+                j = i;
+        }
+
+        kp = array_get(replay_history, j);
+
+        history_bytes -= demo_key_bytes(kp);
+        demo_key_free(kp);
+
+        if (j < n - 1)
+            memcpy(kp, array_get(replay_history, n - 1), sizeof (*kp));
+
+        array_del(replay_history);
+    }
+}
+
+/*
+ * Take a snapshot of the current update, unless there is one.
+ */
+static void demo_history_keep(void)
+{
+    const size_t bytes = (size_t) config_get_d(CONFIG_REPLAY_HISTORY) * 1024;
+
+    struct demo_key *kp;
+    int i;
+
+    /* Snapshots start after the first key frame. */
+
+    if (history_off || bytes == 0 || !replay_keys)
+        return;
+
+    if (!replay_history &&
+        !(replay_history = array_new(sizeof (struct demo_key))))
+        return;
+
+    for (i = 0; i < array_len(replay_history); i++)
+        if (((struct demo_key *) array_get(replay_history, i))->u == replay_updates)
+            return;
+
+    if ((kp = demo_replay_keep(replay_history)))
+        history_bytes += demo_key_bytes(kp);
+
+    demo_history_trim(bytes);
+}
+
+static int demo_replay_load(const struct demo_key *kp)
+{
+    union cmd cmd;
+    int ok = 0;
+
+    if (kp->cmd)
+    {
+        ok = (game_client_load(kp->cmd) &&
+              fs_seek(demo_fp, kp->pos, SEEK_SET) == 0);
+
+        if (ok && kp->delta)
+            replay_stream.delta = *kp->delta;
+    }
+    else if (fs_seek(demo_fp, kp->pos, SEEK_SET) == 0 &&
+             cmd_get_stream(demo_fp, &replay_stream, &cmd))
+    {
+        ok = game_client_load(&cmd);
+        cmd_clear(&cmd);
+    }
+
+    if (ok)
+    {
+        replay_updates = kp->u;
+
+        if (replay_open)
+        {
+            cmd.type = CMD_GOAL_OPEN;
+            game_proxy_enq(&cmd);
+            game_client_sync(NULL);
+        }
+    }
+    return ok;
+}
+
+/*
+ * Read the seek index at the end of the replay.
+ */
+static int demo_replay_read_index(void)
+{
+    const struct demo_key *k0 = array_get(replay_keys, 0);
+
+    struct demo_key *kp;
+    union cmd cmd;
+    int i, pos, found = 0;
+
+    if (fs_seek(demo_fp, -INDEX_BYTES, SEEK_END) == 0 &&
+        (pos = get_index(demo_fp)) > k0->pos &&
+        fs_seek(demo_fp, pos, SEEK_SET) == 0 &&
+        cmd_get_stream(demo_fp, &replay_stream, &cmd))
+    {
+        if (cmd.type == CMD_SEEK_INDEX && cmd.seekindex.pos == pos)
+        {
+            for (i = 0; i < cmd.seekindex.n; i++)
+            {
+                kp = array_get(replay_keys, array_len(replay_keys) - 1);
+
+                if (cmd.seekindex.uv[i] > kp->u &&
+                    cmd.seekindex.pv[i] > k0->pos &&
+                    cmd.seekindex.pv[i] < pos &&
+                    (kp = array_add(replay_keys)))
+                {
+                    kp->u     = cmd.seekindex.uv[i];
+                    kp->pos   = cmd.seekindex.pv[i];
+                    kp->cmd   = NULL;
+                    kp->delta = NULL;
+                }
+            }
+            found = 1;
+        }
+        cmd_clear(&cmd);
+    }
+    return found;
+}
+
+/*
+ * Find the key frames, once per replay.
+ */
+static void demo_replay_index(void)
+{
+    long pos;
+    int  u;
+
+    if (replay_indexed)
+        return;
+
+    replay_indexed = 1;
+
+    pos = fs_tell(demo_fp);
+
+    if (demo_replay_read_index())
+    {
+        fs_seek(demo_fp, pos, SEEK_SET);
+        return;
+    }
+
+    /* No index.  Play through the replay and keep our own key frames. */
+
+    if (demo_replay_load(array_get(replay_keys, 0)))
+    {
+        game_client_quiet(1);
+        history_off = 1;
+
+        do
+        {
+            u = replay_updates;
+            demo_update_read(0);
+
+            if (replay_updates != u && replay_updates % KEY_UPDATES == 0)
+                demo_replay_keep(replay_keys);
+        }
+        while (replay_updates != u);
+
+        history_off = 0;
+        game_client_quiet(0);
+    }
+}
+
+/*
+ * Find the latest of KEYS at or before update TARGET, if later than KP.
+ */
+static const struct demo_key *demo_replay_find(Array keys, int target,
+                                               const struct demo_key *kp)
+{
+    int i;
+
+    for (i = 0; keys && i < array_len(keys); i++)
+    {
+        const struct demo_key *kq = array_get(keys, i);
+
+        if (kq->u <= target && kq->u > kp->u)
+            kp = kq;
+    }
+    return kp;
+}
+
+/*
+ * Jump to T seconds after the start of the replay.  The client is
+ * restored from the nearest key frame or snapshot and brought forward
+ * from there.
+ */
+int demo_replay_seek(float t)
+{
+    const struct demo_key *kp = NULL;
+    int u, target;
+
+    if (!demo_fp || !replay_keys || !array_len(replay_keys))
+        return 0;
+
+    demo_replay_index();
+
+    kp     = array_get(replay_keys, 0);
+    target = kp->u + (int) (MAX(t, 0.0f) / update_step.dt);
+
+    kp = demo_replay_find(replay_keys,    target, kp);
+    kp = demo_replay_find(replay_history, target, kp);
+
+    /* Play forward from here if that's closer than the key frame. */
+
+    if (replay_updates > target || replay_updates < kp->u)
+    {
+        if (!demo_replay_load(kp) &&
+            !demo_replay_load(array_get(replay_keys, 0)))
+            return 0;
+    }
+
+    game_client_quiet(1);
+
+    while (replay_updates < target)
+    {
+        u = replay_updates;
+        demo_update_read(0);
+
+        if (replay_updates == u)
+            break;
+    }
+
+    game_client_quiet(0);
+
+    update_step.at = 0.0f;
+
+    return 1;
+}
+
+/*
+ * Return the time into the replay, as demo_replay_seek takes it.
+ */
+float demo_replay_time(void)
+{
+    const struct demo_key *k0;
+
+    if (replay_keys && array_len(replay_keys))
+    {
+        k0 = array_get(replay_keys, 0);
+        return (replay_updates - k0->u) * update_step.dt;
+    }
+    return 0.0f;
+}
+
 int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
 {
+    demo_play_wait(-1);
+
     lockstep_clr(&update_step);
 
-    if ((demo_fp = fs_open_read(path)))
+    demo_replay_free_keys();
+
+    replay_updates = 0;
+    replay_open    = !g;
+
+    if ((demo_fp = fs_open_map(path)))
     {
-        if (demo_header_read(demo_fp, &demo_replay))
+        if (demo_header_read(demo_fp, &demo_replay) &&
+            (demo_fp = demo_scan_body(demo_fp, demo_replay.flags)))
         {
             struct level level;
 
+            cmd_stream_init(&replay_stream, demo_replay.version);
+
             SAFECPY(demo_replay.path, path);
             SAFECPY(demo_replay.name, demo_name(path));
 
@@ -452,7 +1087,12 @@ int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
                     demo_update_read(0);
 
                     if (!fs_eof(demo_fp))
+                    {
+                        if ((replay_keys = array_new(sizeof (struct demo_key))))
+                            demo_replay_keep(replay_keys);
+
                         return 1;
+                    }
                 }
             }
         }
@@ -476,12 +1116,18 @@ int demo_replay_step(float dt)
 
 void demo_replay_stop(int d)
 {
+    demo_replay_free_keys();
+
     if (demo_fp)
     {
         fs_close(demo_fp);
         demo_fp = NULL;
 
-        if (d) fs_remove(demo_replay.path);
+        if (d)
+        {
+            fs_remove(demo_replay.path);
+            demo_dir_remove(demo_replay.path);
+        }
 
         demo_refresh();
     }
@@ -6,6 +6,7 @@
 
 #include "level.h"
 #include "fs.h"
+#include "cmd.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -14,6 +15,9 @@ struct demo
     char   path[MAXSTR];                /* Demo path                         */
     char   name[PATHMAX];               /* Demo basename                     */
 
+    int    version;
+    int    flags;
+
     char   player[MAXSTR];
     time_t date;
 
@@ -47,9 +51,11 @@ const char *demo_format_name(const char *fmt,
 /*---------------------------------------------------------------------------*/
 
 int  demo_play_init(const char *, const struct level *, int, int, int, int);
+void demo_play_put(const union cmd *);
 void demo_play_step(void);
 void demo_play_stat(int, int, int);
 void demo_play_stop(int);
+int  demo_play_wait(int);
 
 int  demo_saved (void);
 void demo_rename(const char *);
@@ -62,6 +68,8 @@ int  demo_replay_init(const char *, int *, int *, int *, int *, int *);
 int  demo_replay_step(float);
 void demo_replay_stop(int);
 float demo_replay_blend(void);
+int  demo_replay_seek(float);
+float demo_replay_time(void);
 
 const char *curr_demo(void);
 
@@ -14,9 +14,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "array.h"
+#include "binary.h"
 #include "common.h"
 #include "demo.h"
 #include "demo_dir.h"
@@ -24,6 +26,266 @@
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * The replay index keeps the header of every replay in the write dir,
+ * keyed by path, so that listing replays need not open or stat them.
+ * Entries are matched by name against the directory on each scan and
+ * kept up to date as replays are saved and removed.  The size and time
+ * of a replay tell whether a save changed it.
+ */
+
+#define INDEX_PATH    "Replays/index.nbi"
+#define INDEX_MAGIC   (0xAF | 'N' << 8 | 'B' << 16 | 'I' << 24)
+#define INDEX_VERSION 1
+
+struct entry
+{
+    struct demo d;
+
+    int size;
+    int mtime;                          /* Truncated, only compared          */
+    int seen;
+};
+
+static Array index_entries;
+static int   index_sorted;              /* Length of the sorted prefix       */
+static int   index_dirty;
+
+static int cmp_entries(const void *A, const void *B)
+{
+    const struct entry *a = A, *b = B;
+    return strcmp(a->d.path, b->d.path);
+}
+
+static void index_sort(void)
+{
+    if (index_sorted < array_len(index_entries))
+    {
+        array_sort(index_entries, cmp_entries);
+        index_sorted = array_len(index_entries);
+    }
+}
+
+/*
+ * Find an entry among those sorted.  Entries added since the last
+ * sort are not searched.
+ */
+static int index_find(const char *path)
+{
+    int lo = 0, hi = index_sorted, mid, c;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        c   = strcmp(path, ((struct entry *) array_get(index_entries, mid))->d.path);
+
+        if      (c < 0) hi = mid;
+        else if (c > 0) lo = mid + 1;
+        else return mid;
+    }
+    return -1;
+}
+
+/*
+ * Remove an entry by moving the last one into its place.
+ */
+static void index_del(int i)
+{
+    int n = array_len(index_entries) - 1;
+
+    if (i < n)
+        memcpy(array_get(index_entries, i), array_get(index_entries, n),
+               sizeof (struct entry));
+
+    array_del(index_entries);
+
+    index_sorted = MIN(index_sorted, i);
+    index_dirty  = 1;
+}
+
+static int entry_read(fs_file fp, struct entry *ep)
+{
+    struct demo *d = &ep->d;
+
+    memset(ep, 0, sizeof (*ep));
+
+    get_string(fp, d->path, sizeof (d->path));
+
+    ep->size  = get_index(fp);
+    ep->mtime = get_index(fp);
+
+    d->version = get_index(fp);
+    d->flags   = get_index(fp);
+    d->date    = (time_t) get_index(fp);
+    d->timer   = get_index(fp);
+    d->coins   = get_index(fp);
+    d->status  = get_index(fp);
+    d->mode    = get_index(fp);
+    d->time    = get_index(fp);
+    d->goal    = get_index(fp);
+    d->score   = get_index(fp);
+    d->balls   = get_index(fp);
+    d->times   = get_index(fp);
+
+    get_string(fp, d->player, sizeof (d->player));
+    get_string(fp, d->shot,   sizeof (d->shot));
+    get_string(fp, d->file,   sizeof (d->file));
+
+    SAFECPY(d->name, base_name_sans(d->path, ".nbr"));
+
+    return !fs_eof(fp);
+}
+
+static void entry_write(fs_file fp, const struct entry *ep)
+{
+    const struct demo *d = &ep->d;
+
+    put_string(fp, d->path);
+
+    put_index(fp, ep->size);
+    put_index(fp, ep->mtime);
+
+    put_index(fp, d->version);
+    put_index(fp, d->flags);
+    put_index(fp, (int) d->date);
+    put_index(fp, d->timer);
+    put_index(fp, d->coins);
+    put_index(fp, d->status);
+    put_index(fp, d->mode);
+    put_index(fp, d->time);
+    put_index(fp, d->goal);
+    put_index(fp, d->score);
+    put_index(fp, d->balls);
+    put_index(fp, d->times);
+
+    put_string(fp, d->player);
+    put_string(fp, d->shot);
+    put_string(fp, d->file);
+}
+
+static int index_load(void)
+{
+    fs_file fp;
+    int i, n;
+
+    if (index_entries)
+        return 1;
+
+    if (!(index_entries = array_new(sizeof (struct entry))))
+        return 0;
+
+    index_sorted = 0;
+    index_dirty  = 0;
+
+    if ((fp = fs_open_read(INDEX_PATH)))
+    {
+        if (get_index(fp) == INDEX_MAGIC && get_index(fp) == INDEX_VERSION)
+        {
+            n = get_index(fp);
+
+            for (i = 0; i < n; i++)
+            {
+                struct entry *ep;
+
+                if (!(ep = array_add(index_entries)))
+                    break;
+
+                if (!entry_read(fp, ep))
+                {
+                    array_del(index_entries);
+                    break;
+                }
+            }
+        }
+        fs_close(fp);
+    }
+
+    index_sort();
+
+    return 1;
+}
+
+static void index_save(void)
+{
+    fs_file fp;
+    int i;
+
+    if (index_entries && index_dirty)
+    {
+        index_sort();
+
+        if ((fp = fs_open_write(INDEX_PATH)))
+        {
+            put_index(fp, INDEX_MAGIC);
+            put_index(fp, INDEX_VERSION);
+            put_index(fp, array_len(index_entries));
+
+            for (i = 0; i < array_len(index_entries); i++)
+                entry_write(fp, array_get(index_entries, i));
+
+            fs_close(fp);
+
+            index_dirty = 0;
+        }
+    }
+}
+
+/*
+ * Read the header of a replay and index it.  An unreadable replay is
+ * left unseen, so a full scan drops it.
+ */
+static struct entry *index_put(struct entry *ep, const char *path)
+{
+    static struct demo d;
+
+    int size  = fs_size(path);
+    int mtime = (int) fs_mtime(path);
+
+    if (ep && ep->size == size && ep->mtime == mtime)
+        return ep;
+
+    if (!demo_load(&d, path))
+        return NULL;
+
+    if (!ep && !(ep = array_add(index_entries)))
+        return NULL;
+
+    ep->d     = d;
+    ep->size  = size;
+    ep->mtime = mtime;
+
+    index_dirty = 1;
+
+    return ep;
+}
+
+/*
+ * Return the header of a replay.  A replay the index has is taken as
+ * it is, as the game updates the index whenever it writes one.  Only
+ * new replays are read.
+ */
+static const struct demo *index_get(const char *path)
+{
+    struct entry *ep;
+    int i;
+
+    if ((i = index_find(path)) >= 0)
+        ep = array_get(index_entries, i);
+    else if (!(ep = index_put(NULL, path)))
+        return NULL;
+
+    ep->seen = 1;
+
+    return &ep->d;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int query_sort;
+static int query_filter;
+
+static struct demo query_like;
+
 static void free_item(struct dir_item *item)
 {
     if (item->data)
@@ -51,32 +313,123 @@ static void load_item(struct dir_item *item)
     }
 }
 
+static int match_item(const struct demo *d)
+{
+    switch (query_filter)
+    {
+    case DEMO_FILTER_PLAYER:
+        return d && strcmp(d->player, query_like.player) == 0;
+
+    case DEMO_FILTER_LEVEL:
+        return d && strcmp(d->file, query_like.file) == 0;
+
+    case DEMO_FILTER_STATUS:
+        return d && d->status == query_like.status;
+    }
+    return 1;
+}
+
 static int scan_item(struct dir_item *item)
 {
-    return str_ends_with(item->path, ".nbr");
+    const struct demo *d;
+
+    if (!str_ends_with(item->path, ".nbr"))
+        return 0;
+
+    d = index_entries ? index_get(item->path) : NULL;
+
+    if (!match_item(d))
+        return 0;
+
+    if (d && (item->data = malloc(sizeof (struct demo))))
+        memcpy(item->data, d, sizeof (struct demo));
+
+    return 1;
 }
 
 static int cmp_items(const void *A, const void *B)
 {
     const struct dir_item *a = A, *b = B;
+    const struct demo *p = a->data, *q = b->data;
+    int c = 0;
 
     if (strcmp(base_name_sans(a->path, ".nbr"), USER_REPLAY_FILE) == 0)
         return -1;
     if (strcmp(base_name_sans(b->path, ".nbr"), USER_REPLAY_FILE) == 0)
         return +1;
 
-    return strcmp(a->path, b->path);
+    /* Unreadable replays go last. */
+
+    if (query_sort != DEMO_SORT_NAME && (!p || !q))
+        return (p ? -1 : 0) + (q ? +1 : 0);
+
+    switch (query_sort)
+    {
+    case DEMO_SORT_DATE:
+        c = (p->date < q->date) - (p->date > q->date);
+        break;
+
+    case DEMO_SORT_PLAYER:
+        c = strcmp(p->player, q->player);
+        break;
+
+    case DEMO_SORT_LEVEL:
+        c = strcmp(p->file, q->file);
+        break;
+
+    case DEMO_SORT_STATUS:
+        c = p->status - q->status;
+        break;
+    }
+
+    return c ? c : strcmp(a->path, b->path);
 }
 
 /*---------------------------------------------------------------------------*/
 
 Array demo_dir_scan(void)
+{
+    return demo_dir_query(DEMO_SORT_NAME, DEMO_FILTER_NONE, NULL);
+}
+
+/*
+ * Scan replays, sorted by SORT and, unless FILTER is DEMO_FILTER_NONE,
+ * only those that match LIKE in the given field.
+ */
+Array demo_dir_query(int sort, int filter, const struct demo *like)
 {
     Array items;
+    int i;
+
+    /* List the last replay only once it is written. */
+
+    demo_play_wait(-1);
+
+    query_sort   = sort;
+    query_filter = like ? filter : DEMO_FILTER_NONE;
+
+    if (like)
+        query_like = *like;
+
+    if (index_load())
+        for (i = 0; i < array_len(index_entries); i++)
+            ((struct entry *) array_get(index_entries, i))->seen = 0;
 
     if ((items = fs_dir_scan("Replays", scan_item)))
         array_sort(items, cmp_items);
 
+    /* Forget replays that are gone, unless some were filtered out. */
+
+    if (index_entries)
+    {
+        if (query_filter == DEMO_FILTER_NONE)
+            for (i = array_len(index_entries) - 1; i >= 0; i--)
+                if (!((struct entry *) array_get(index_entries, i))->seen)
+                    index_del(i);
+
+        index_save();
+    }
+
     return items;
 }
 
@@ -102,3 +455,51 @@ void demo_dir_free(Array items)
 }
 
 /*---------------------------------------------------------------------------*/
+
+/*
+ * Index a replay that was just written.
+ */
+void demo_dir_update(const char *path)
+{
+    int i;
+
+    if (index_load())
+    {
+        index_sort();
+
+        i = index_find(path);
+
+        if (index_put(i >= 0 ? array_get(index_entries, i) : NULL, path))
+            index_save();
+    }
+}
+
+/*
+ * Drop a replay that was removed or renamed from the index.
+ */
+void demo_dir_remove(const char *path)
+{
+    int i;
+
+    if (index_load())
+    {
+        index_sort();
+
+        if ((i = index_find(path)) >= 0)
+        {
+            index_del(i);
+            index_save();
+        }
+    }
+}
+
+void demo_dir_quit(void)
+{
+    if (index_entries)
+    {
+        array_free(index_entries);
+        index_entries = NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
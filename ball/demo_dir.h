@@ -7,8 +7,34 @@
 
 #define DEMO_GET(a, i) ((struct demo *) DIR_ITEM_GET((a), (i))->data)
 
+enum
+{
+    DEMO_SORT_NAME = 0,
+    DEMO_SORT_DATE,
+    DEMO_SORT_PLAYER,
+    DEMO_SORT_LEVEL,
+    DEMO_SORT_STATUS,
+
+    DEMO_SORT_MAX
+};
+
+enum
+{
+    DEMO_FILTER_NONE = 0,
+    DEMO_FILTER_PLAYER,
+    DEMO_FILTER_LEVEL,
+    DEMO_FILTER_STATUS,
+
+    DEMO_FILTER_MAX
+};
+
 Array demo_dir_scan(void);
+Array demo_dir_query(int sort, int filter, const struct demo *like);
 void  demo_dir_load(Array, int lo, int hi);
 void  demo_dir_free(Array);
 
+void  demo_dir_update(const char *);
+void  demo_dir_remove(const char *);
+void  demo_dir_quit(void);
+
 #endif
@@ -35,6 +35,7 @@
 #include "game_draw.h"
 
 #include "cmd.h"
+#include "demo.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -54,6 +55,8 @@ static int   coins  = 0;                /* Collected coins                   */
 
 static struct cmd_state cs;             /* Command state                     */
 
+static int quiet = 0;                   /* Skip sound and particles          */
+
 struct
 {
     int x, y;
@@ -121,7 +124,8 @@ static void game_run_cmd(const union cmd *cmd)
                         gd.jump_b = 0;
                 }
 
-                part_step(v, dt);
+                if (!quiet)
+                    part_step(v, dt);
             }
 
             break;
@@ -145,8 +149,11 @@ static void game_run_cmd(const union cmd *cmd)
 
                 sol_entity_world(p, vary, hp->mi, hp->mj, hp->p);
 
-                item_color(hp, v);
-                part_burst(p, v);
+                if (!quiet)
+                {
+                    item_color(hp, v);
+                    part_burst(p, v);
+                }
 
                 hp->t = ITEM_NONE;
             }
@@ -173,7 +180,7 @@ static void game_run_cmd(const union cmd *cmd)
         case CMD_SOUND:
             /* Play the sound. */
 
-            if (cmd->sound.n)
+            if (cmd->sound.n && !quiet)
                 audio_play(cmd->sound.n, cmd->sound.a);
 
             break;
@@ -306,6 +313,8 @@ static void game_run_cmd(const union cmd *cmd)
             v_cpy(tilt->z, cmd->tiltaxes.z);
             break;
 
+        case CMD_KEY_FRAME:
+        case CMD_SEEK_INDEX:
         case CMD_NONE:
         case CMD_MAX:
             break;
@@ -313,18 +322,19 @@ static void game_run_cmd(const union cmd *cmd)
     }
 }
 
-void game_client_sync(fs_file demo_fp)
+void game_client_sync(fs_file fp)
 {
-    union cmd *cmdp;
+    const union cmd *cmdp;
 
     while ((cmdp = game_proxy_deq()))
     {
-        if (demo_fp)
-            cmd_put(demo_fp, cmdp);
+        if (fp)
+            demo_play_put(cmdp);
 
         game_run_cmd(cmdp);
 
-        cmd_free(cmdp);
+        if (fp && cmdp->type == CMD_END_OF_UPDATE)
+            demo_play_step();
     }
 }
 
@@ -448,6 +458,268 @@ void game_client_free(const char *next)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Key frames hold the client state at the end of an update: the
+ * current half of the interpolation state, the varying SOL data that
+ * commands change directly, and the game state.
+ */
+
+#define KEY_LAYOUT 1
+
+#define KEY_INTS(v)       (14 + (v)->pc + (v)->mc + (v)->hc + (v)->xc)
+#define KEY_FLOATS(v, uc) (30 + (v)->mc + (uc) * 22)
+
+static float *put_key_view(float *f, const struct game_view *view)
+{
+    *f++ = view->dc;
+    *f++ = view->dp;
+    *f++ = view->dz;
+
+    v_cpy(f, view->c);    f += 3;
+    v_cpy(f, view->p);    f += 3;
+    v_cpy(f, view->e[0]); f += 3;
+    v_cpy(f, view->e[1]); f += 3;
+    v_cpy(f, view->e[2]); f += 3;
+
+    *f++ = view->a;
+
+    return f;
+}
+
+static const float *get_key_view(const float *f, struct game_view *view)
+{
+    view->dc = *f++;
+    view->dp = *f++;
+    view->dz = *f++;
+
+    v_cpy(view->c,    f); f += 3;
+    v_cpy(view->p,    f); f += 3;
+    v_cpy(view->e[0], f); f += 3;
+    v_cpy(view->e[1], f); f += 3;
+    v_cpy(view->e[2], f); f += 3;
+
+    view->a = *f++;
+
+    return f;
+}
+
+/*
+ * Fill in a key frame of the current state.  The command must be
+ * released with cmd_clear.
+ */
+int game_client_save(union cmd *cmd)
+{
+    const struct s_vary *vary = &gd.vary;
+    const struct s_lerp *lerp = &gl.lerp;
+
+    const struct game_tilt *tilt = &gl.tilt[CURR];
+
+    int   *i;
+    float *f;
+    int    k;
+
+    cmd->type = CMD_KEY_FRAME;
+
+    cmd->keyframe.ic = 0;
+    cmd->keyframe.iv = NULL;
+    cmd->keyframe.fc = 0;
+    cmd->keyframe.fv = NULL;
+
+    if (!gd.state || lerp->uc != vary->uc)
+        return 0;
+
+    cmd->keyframe.ic = KEY_INTS(vary);
+    cmd->keyframe.fc = KEY_FLOATS(vary, vary->uc);
+    cmd->keyframe.iv = malloc(cmd->keyframe.ic * sizeof (int));
+    cmd->keyframe.fv = malloc(cmd->keyframe.fc * sizeof (float));
+
+    if (!cmd->keyframe.iv || !cmd->keyframe.fv)
+    {
+        cmd_clear(cmd);
+        return 0;
+    }
+
+    i = cmd->keyframe.iv;
+    f = cmd->keyframe.fv;
+
+    *i++ = KEY_LAYOUT;
+    *i++ = status;
+    *i++ = coins;
+    *i++ = cs.ups;
+    *i++ = cs.curr_ball;
+    *i++ = gd.goal_e;
+    *i++ = gd.jump_e;
+    *i++ = gd.jump_b;
+    *i++ = game_compat_map;
+    *i++ = vary->pc;
+    *i++ = vary->mc;
+    *i++ = vary->hc;
+    *i++ = vary->xc;
+    *i++ = vary->uc;
+
+    for (k = 0; k < vary->pc; k++) *i++ = vary->pv[k].f;
+    for (k = 0; k < vary->mc; k++) *i++ = lerp->mv[k][CURR].pi;
+    for (k = 0; k < vary->hc; k++) *i++ = vary->hv[k].t;
+    for (k = 0; k < vary->xc; k++) *i++ = vary->xv[k].e | vary->xv[k].f << 1;
+
+    *f++ = timer;
+    *f++ = gl.goal_k[CURR];
+    *f++ = gl.jump_dt[CURR];
+
+    v_cpy(f, tilt->x); f += 3;
+    *f++ = tilt->rx;
+    v_cpy(f, tilt->z); f += 3;
+    *f++ = tilt->rz;
+
+    f = put_key_view(f, &gl.view[CURR]);
+
+    for (k = 0; k < vary->mc; k++)
+        *f++ = lerp->mv[k][CURR].t;
+
+    for (k = 0; k < vary->uc; k++)
+    {
+        const struct l_ball *up = &lerp->uv[k][CURR];
+
+        v_cpy(f, up->e[0]); f += 3;
+        v_cpy(f, up->e[1]); f += 3;
+        v_cpy(f, up->e[2]); f += 3;
+        v_cpy(f, up->p);    f += 3;
+        v_cpy(f, up->E[0]); f += 3;
+        v_cpy(f, up->E[1]); f += 3;
+        v_cpy(f, up->E[2]); f += 3;
+        *f++ = up->r;
+    }
+
+    return 1;
+}
+
+/*
+ * Return the client to the state of a key frame.
+ */
+int game_client_load(const union cmd *cmd)
+{
+    struct s_vary *vary = &gd.vary;
+    struct s_lerp *lerp = &gl.lerp;
+
+    struct game_tilt *tilt = &gl.tilt[CURR];
+
+    const int   *i = cmd->keyframe.iv;
+    const float *f = cmd->keyframe.fv;
+
+    union cmd ball;
+    int k, uc;
+
+    /* Make sure the key frame is of this level. */
+
+    if (!gd.state || cmd->type != CMD_KEY_FRAME ||
+        cmd->keyframe.ic < 14 || i[0] != KEY_LAYOUT ||
+        i[9]  != vary->pc ||
+        i[10] != vary->mc ||
+        i[11] != vary->hc ||
+        i[12] != vary->xc ||
+        cmd->keyframe.ic != KEY_INTS(vary))
+        return 0;
+
+    if ((uc = i[13]) < 0 || uc > cmd->keyframe.fc / 22 ||
+        cmd->keyframe.fc != KEY_FLOATS(vary, uc))
+        return 0;
+
+    game_proxy_clr();
+
+    /* Rebuild the balls. */
+
+    ball.type = CMD_CLEAR_BALLS;
+    sol_lerp_cmd(lerp, &cs, &ball);
+
+    ball.type = CMD_MAKE_BALL;
+
+    for (k = 0; k < uc; k++)
+        sol_lerp_cmd(lerp, &cs, &ball);
+
+    if (lerp->uc != uc)
+        return 0;
+
+    i++;
+
+    status          = *i++;
+    coins           = *i++;
+    cs.ups          = *i++;
+    cs.curr_ball    = *i++;
+    gd.goal_e       = *i++;
+    gd.jump_e       = *i++;
+    gd.jump_b       = *i++;
+    game_compat_map = *i++;
+
+    i += 5;
+
+    for (k = 0; k < vary->pc; k++) vary->pv[k].f = *i++;
+
+    for (k = 0; k < vary->mc; k++)
+        if ((lerp->mv[k][CURR].pi = *i++) < 0 || lerp->mv[k][CURR].pi >= vary->base->pc)
+            lerp->mv[k][CURR].pi = vary->mv[k].pi;
+
+    for (k = 0; k < vary->hc; k++) vary->hv[k].t = *i++;
+
+    for (k = 0; k < vary->xc; k++, i++)
+    {
+        vary->xv[k].e = (*i & 1);
+        vary->xv[k].f = (*i & 2) >> 1;
+    }
+
+    timer = *f++;
+
+    gl.goal_k[CURR]  = *f++;
+    gl.jump_dt[CURR] = *f++;
+
+    v_cpy(tilt->x, f); f += 3;
+    tilt->rx = *f++;
+    v_cpy(tilt->z, f); f += 3;
+    tilt->rz = *f++;
+
+    f = get_key_view(f, &gl.view[CURR]);
+
+    for (k = 0; k < vary->mc; k++)
+        lerp->mv[k][CURR].t = *f++;
+
+    for (k = 0; k < uc; k++)
+    {
+        struct l_ball *up = &lerp->uv[k][CURR];
+
+        v_cpy(up->e[0], f); f += 3;
+        v_cpy(up->e[1], f); f += 3;
+        v_cpy(up->e[2], f); f += 3;
+        v_cpy(up->p,    f); f += 3;
+        v_cpy(up->E[0], f); f += 3;
+        v_cpy(up->E[1], f); f += 3;
+        v_cpy(up->E[2], f); f += 3;
+        up->r = *f++;
+    }
+
+    cs.curr_ball     = CLAMP(0, cs.curr_ball, MAX(uc - 1, 0));
+    cs.first_update  = 0;
+    cs.next_update   = 1;
+    cs.got_tilt_axes = 0;
+
+    /* Start from rest, without stale effects. */
+
+    game_lerp_copy(&gl);
+    game_lerp_apply(&gl, &gd);
+
+    part_reset();
+
+    return 1;
+}
+
+/*
+ * Skip sound and particles, for fast-forwarding.
+ */
+void game_client_quiet(int q)
+{
+    quiet = q;
+}
+
+/*---------------------------------------------------------------------------*/
+
 int enable_interpolation = 1;
 
 void game_client_blend(float a)
@@ -30,6 +30,12 @@ void  game_fade(float);
 
 void game_client_fly(float);
 
+union cmd;
+
+int  game_client_save(union cmd *);
+int  game_client_load(const union cmd *);
+void game_client_quiet(int);
+
 /*---------------------------------------------------------------------------*/
 
 extern int game_compat_map;
@@ -3,6 +3,7 @@
 
 #include "lang.h"
 #include "solid_vary.h"
+#include "solid_world.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -31,17 +32,6 @@
 
 /*---------------------------------------------------------------------------*/
 
-enum
-{
-    GAME_NONE = 0,
-
-    GAME_TIME,
-    GAME_GOAL,
-    GAME_FALL,
-
-    GAME_MAX
-};
-
 const char *status_to_str(int);
 
 /*---------------------------------------------------------------------------*/
@@ -78,18 +68,7 @@ void cam_preset_set(int, int);
 
 /*---------------------------------------------------------------------------*/
 
-extern const float GRAVITY_UP[];
-extern const float GRAVITY_DN[];
-
-struct game_tilt
-{
-    float x[3], rx;
-    float z[3], rz;
-};
-
-void game_tilt_init(struct game_tilt *);
 void game_tilt_axes(struct game_tilt *, float view_e[3][3]);
-void game_tilt_grav(float h[3], const float g[3], const struct game_tilt *);
 
 /*---------------------------------------------------------------------------*/
 
@@ -13,12 +13,40 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "game_proxy.h"
-#include "queue.h"
+#include "common.h"
+#include "list.h"
 #include "cmd.h"
+#include "log.h"
 
-static Queue cmd_queue;
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The queue is a ring of commands.  It is allocated once and doubled
+ * only if it fills up, which a steady state never does.  The strings
+ * of queued commands are copied into an arena that is reset whenever
+ * the queue drains, that is, at least once per client update.
+ */
+
+#define RING_MIN  1024
+#define ARENA_MIN 4096
+
+static union cmd *ring;
+static int        ring_max;
+static int        ring_head;
+static int        ring_len;
+
+static char  *arena;
+static size_t arena_len;
+static size_t arena_max;
+static List   arena_old;                /* Blocks outgrown since the reset   */
+
+static struct proxy_stats stats;
+static int                frame_cmds;
+
+static union cmd deq_cmd;
 
 /*
  * Command filtering.
@@ -33,8 +61,81 @@ void game_proxy_filter(int (*fn)(const union cmd *))
     filter_fn = fn;
 }
 
+/*---------------------------------------------------------------------------*/
+
+static int ring_grow(void)
+{
+    int n = ring_max ? ring_max * 2 : RING_MIN;
+    int i;
+
+    union cmd *v;
+
+    if (!(v = malloc(n * sizeof (*v))))
+        return 0;
+
+    /* Unwrap the queue to the start of the new ring. */
+
+    for (i = 0; i < ring_len; i++)
+        v[i] = ring[(ring_head + i) % ring_max];
+
+    free(ring);
+
+    ring      = v;
+    ring_max  = n;
+    ring_head = 0;
+
+    return 1;
+}
+
+/*
+ * Copy a string into the arena.  A full arena is set aside until the
+ * next reset, as queued commands may still point into it.
+ */
+static char *arena_put(const char *str)
+{
+    size_t n = strlen(str) + 1;
+    char *p;
+
+    if (arena_len + n > arena_max)
+    {
+        size_t max = MAX(arena_max * 2, ARENA_MIN);
+
+        while (max < n)
+            max *= 2;
+
+        if (!(p = malloc(max)))
+            return NULL;
+
+        if (arena)
+            arena_old = list_cons(arena, arena_old);
+
+        arena     = p;
+        arena_len = 0;
+        arena_max = max;
+    }
+
+    p = arena + arena_len;
+    memcpy(p, str, n);
+    arena_len += n;
+
+    return p;
+}
+
+static void arena_reset(void)
+{
+    while (arena_old)
+    {
+        free(arena_old->data);
+        arena_old = list_rest(arena_old);
+    }
+    arena_len = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
 /*
- * Enqueue SRC in the game's command queue.
+ * Enqueue a copy of SRC in the game's command queue.  Strings are
+ * copied too, so the caller keeps ownership of those of SRC.
  */
 void game_proxy_enq(const union cmd *src)
 {
@@ -43,33 +144,61 @@ void game_proxy_enq(const union cmd *src)
     if (!FILTER(src))
         return;
 
-    /*
-     * Create the queue.  This is done only once during the life time
-     * of the program.  For simplicity's sake, the queue is never
-     * destroyed.
-     */
+    /* Key frames and seek indices are for the replay code alone. */
 
-    if (!cmd_queue)
-        cmd_queue = queue_new();
+    if (src->type == CMD_KEY_FRAME || src->type == CMD_SEEK_INDEX)
+        return;
 
-    /*
-     * Add a copy of the command to the end of the queue.
-     */
+    if (ring_len == ring_max && !ring_grow())
+        return;
 
-    if ((dst = malloc(sizeof (*dst))))
-    {
-        *dst = *src;
-        queue_enq(cmd_queue, dst);
-    }
+    dst  = &ring[(ring_head + ring_len) % ring_max];
+    *dst = *src;
+
+    if (dst->type == CMD_SOUND && dst->sound.n)
+        dst->sound.n = arena_put(dst->sound.n);
+
+    if (dst->type == CMD_MAP && dst->map.name)
+        dst->map.name = arena_put(dst->map.name);
+
+    ring_len++;
+
+    if (stats.depth_max < ring_len)
+        stats.depth_max = ring_len;
 }
 
 /*
- * Dequeue and return the head element in the game's command queue.
- * The element must be freed after use.
+ * Dequeue the head element of the game's command queue.  The command
+ * returned is valid until the next call and must not be freed.
  */
-union cmd *game_proxy_deq(void)
+const union cmd *game_proxy_deq(void)
 {
-    return cmd_queue ? queue_deq(cmd_queue) : NULL;
+    if (ring_len == 0)
+    {
+        /* Drained: the strings are no longer needed. */
+
+        arena_reset();
+
+        /* Empty drains between updates leave the count of the last. */
+
+        if (frame_cmds)
+            stats.frame = frame_cmds;
+        if (stats.frame_max < frame_cmds)
+            stats.frame_max = frame_cmds;
+
+        frame_cmds = 0;
+
+        return NULL;
+    }
+
+    deq_cmd = ring[ring_head];
+
+    ring_head = (ring_head + 1) % ring_max;
+    ring_len--;
+
+    frame_cmds++;
+
+    return &deq_cmd;
 }
 
 /*
@@ -77,8 +206,28 @@ union cmd *game_proxy_deq(void)
  */
 void game_proxy_clr(void)
 {
-    union cmd *cmdp;
+    while (game_proxy_deq())
+        ;
+}
+
+/*---------------------------------------------------------------------------*/
 
-    while ((cmdp = game_proxy_deq()))
-        cmd_free(cmdp);
+/*
+ * Get the queue counters, for the HUD or anything else that cares.
+ */
+void game_proxy_stats(struct proxy_stats *sp)
+{
+    *sp = stats;
+
+    sp->depth = ring_len;
 }
+
+void game_proxy_log(void)
+{
+    if (stats.depth_max)
+        log_printf("Proxy: %d commands queued at most, %d in one drain, "
+                   "ring of %d, arena of %d KiB\n", stats.depth_max,
+                   stats.frame_max, ring_max, (int) (arena_max / 1024));
+}
+
+/*---------------------------------------------------------------------------*/
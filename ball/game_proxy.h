@@ -3,9 +3,23 @@
 
 #include "cmd.h"
 
-void       game_proxy_filter(int (*fn)(const union cmd *));
-void       game_proxy_enq(const union cmd *);
-union cmd *game_proxy_deq(void);
-void       game_proxy_clr(void);
+void             game_proxy_filter(int (*fn)(const union cmd *));
+void             game_proxy_enq(const union cmd *);
+const union cmd *game_proxy_deq(void);
+void             game_proxy_clr(void);
+
+/*
+ * Queue counters.
+ */
+struct proxy_stats
+{
+    int depth;                          /* Commands queued now               */
+    int depth_max;                      /* Most commands queued at once      */
+    int frame;                          /* Commands in the last drain        */
+    int frame_max;                      /* Most commands in one drain        */
+};
+
+void game_proxy_stats(struct proxy_stats *);
+void game_proxy_log(void);
 
 #endif
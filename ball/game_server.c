@@ -17,13 +17,11 @@
 #include <assert.h>
 
 #include "vec3.h"
-#include "geom.h"
 #include "config.h"
 #include "binary.h"
 #include "common.h"
 #include "ease.h"
 
-#include "solid_sim.h"
 #include "solid_all.h"
 
 #include "game_common.h"
@@ -36,12 +34,7 @@
 
 static int server_state = 0;
 
-static struct s_vary vary;
-
-static float time_limit = 0;            /* Effective time limit              */
-static float time_elapsed = 0;          /* Time elapsed                      */
-static float timer = 0.0f;              /* Clock                             */
-static int status = GAME_NONE;          /* Outcome of the game               */
+static struct s_world world;           /* Ball, rules and their state       */
 
 static struct game_tilt tilt;           /* Floor rotation                    */
 static struct game_view view;           /* Current view                      */
@@ -64,13 +57,6 @@ static float view_zoom_time;            /* Running zoom animation time       */
 #define ZOOM_MIN 0.75f
 #define ZOOM_MAX 1.25f
 
-static int   coins  = 0;                /* Collected coins                   */
-static int   goal_e = 0;                /* Goal enabled flag                 */
-static int   jump_e = 1;                /* Jumping enabled flag              */
-static int   jump_b = 0;                /* Jump-in-progress flag             */
-static float jump_dt;                   /* Jump duration                     */
-static float jump_p[3];                 /* Jump destination                  */
-
 /*---------------------------------------------------------------------------*/
 
 /*
@@ -170,7 +156,7 @@ static union cmd cmd;
 static void game_cmd_map(const char *name, int ver_x, int ver_y)
 {
     cmd.type          = CMD_MAP;
-    cmd.map.name      = strdup(name);
+    cmd.map.name      = (char *) name;  /* Copied by the proxy.           */
     cmd.map.version.x = ver_x;
     cmd.map.version.y = ver_y;
     game_proxy_enq(&cmd);
@@ -193,7 +179,7 @@ static void game_cmd_sound(const char *filename, float a)
 {
     cmd.type = CMD_SOUND;
 
-    cmd.sound.n = strdup(filename);
+    cmd.sound.n = (char *) filename;    /* Copied by the proxy.              */
     cmd.sound.a = a;
 
     game_proxy_enq(&cmd);
@@ -210,17 +196,17 @@ static void game_cmd_goalopen(void)
 static void game_cmd_updball(void)
 {
     cmd.type = CMD_BALL_POSITION;
-    v_cpy(cmd.ballpos.p, vary.uv[0].p);
+    v_cpy(cmd.ballpos.p, world.vary.uv[0].p);
     game_proxy_enq(&cmd);
 
     cmd.type = CMD_BALL_BASIS;
-    v_cpy(cmd.ballbasis.e[0], vary.uv[0].e[0]);
-    v_cpy(cmd.ballbasis.e[1], vary.uv[0].e[1]);
+    v_cpy(cmd.ballbasis.e[0], world.vary.uv[0].e[0]);
+    v_cpy(cmd.ballbasis.e[1], world.vary.uv[0].e[1]);
     game_proxy_enq(&cmd);
 
     cmd.type = CMD_BALL_PEND_BASIS;
-    v_cpy(cmd.ballpendbasis.E[0], vary.uv[0].E[0]);
-    v_cpy(cmd.ballpendbasis.E[1], vary.uv[0].E[1]);
+    v_cpy(cmd.ballpendbasis.E[0], world.vary.uv[0].E[0]);
+    v_cpy(cmd.ballpendbasis.E[1], world.vary.uv[0].E[1]);
     game_proxy_enq(&cmd);
 }
 
@@ -243,7 +229,7 @@ static void game_cmd_updview(void)
 static void game_cmd_ballradius(void)
 {
     cmd.type         = CMD_BALL_RADIUS;
-    cmd.ballradius.r = vary.uv[0].r;
+    cmd.ballradius.r = world.vary.uv[0].r;
     game_proxy_enq(&cmd);
 }
 
@@ -259,19 +245,6 @@ static void game_cmd_init_balls(void)
     game_cmd_ballradius();
 }
 
-static void game_cmd_pkitem(int hi)
-{
-    cmd.type      = CMD_PICK_ITEM;
-    cmd.pkitem.hi = hi;
-    game_proxy_enq(&cmd);
-}
-
-static void game_cmd_jump(int e)
-{
-    cmd.type = e ? CMD_JUMP_ENTER : CMD_JUMP_EXIT;
-    game_proxy_enq(&cmd);
-}
-
 static void game_cmd_tiltangles(void)
 {
     cmd.type = CMD_TILT_ANGLES;
@@ -295,88 +268,19 @@ static void game_cmd_tiltaxes(void)
 static void game_cmd_timer(void)
 {
     cmd.type    = CMD_TIMER;
-    cmd.timer.t = timer;
-    game_proxy_enq(&cmd);
-}
-
-static void game_cmd_coins(void)
-{
-    cmd.type    = CMD_COINS;
-    cmd.coins.n = coins;
+    cmd.timer.t = world.timer;
     game_proxy_enq(&cmd);
 }
 
 static void game_cmd_status(void)
 {
     cmd.type     = CMD_STATUS;
-    cmd.status.t = status;
+    cmd.status.t = world.status;
     game_proxy_enq(&cmd);
 }
 
 /*---------------------------------------------------------------------------*/
 
-static int grow_init(int type)
-{
-    struct v_ball *up = &vary.uv[0];
-
-    int size = up->size;
-
-    if (type == ITEM_SHRINK)
-        size--;
-    else if (type == ITEM_GROW)
-        size++;
-
-    size = CLAMP(0, size, 2);
-
-    if (size != up->size)
-    {
-        const int old_size = up->size;
-
-        up->r_vel = (up->sizes[size] - up->r) / GROW_TIME;
-        up->size = size;
-
-        if (size < old_size)
-            return -1;
-
-        if (size > old_size)
-            return +1;
-    }
-
-    return 0;
-}
-
-static void grow_step(float dt)
-{
-    struct v_ball *up = &vary.uv[0];
-
-    if (up->r_vel != 0.0f)
-    {
-        float r, dr;
-
-        /* Calculate new size based on how long since you touched the coin... */
-
-        r = up->r + up->r_vel * dt;
-
-        if ((up->r < up->sizes[up->size] && r >= up->sizes[up->size]) ||
-            (up->r > up->sizes[up->size] && r <= up->sizes[up->size]))
-        {
-            r = up->sizes[up->size];
-            up->r_vel = 0.0f;
-        }
-
-        dr = r - up->r;
-
-        /* No sinking through the floor! Keeps ball's bottom constant. */
-
-        up->p[1] += dr;
-        up->r     = r;
-
-        game_cmd_ballradius();
-    }
-}
-
-/*---------------------------------------------------------------------------*/
-
 static struct lockstep server_step;
 
 int game_server_init(const char *file_name, int t, int e)
@@ -384,13 +288,6 @@ int game_server_init(const char *file_name, int t, int e)
     struct { int x, y; } version;
     int i;
 
-    time_limit = (float) t / 100.0f;
-    time_elapsed = 0.0f;
-
-    timer = 0.0f;
-    status = GAME_NONE;
-    coins = 0;
-
     game_server_free(file_name);
 
     /* Load SOL data. */
@@ -398,7 +295,7 @@ int game_server_init(const char *file_name, int t, int e)
     if (!game_base_load(file_name))
         return (server_state = 0);
 
-    if (!sol_load_vary(&vary, &game_base))
+    if (!world_init(&world, &game_base, NULL, game_proxy_enq, t / 100.0f, e))
     {
         game_base_free(NULL);
         return (server_state = 0);
@@ -411,10 +308,10 @@ int game_server_init(const char *file_name, int t, int e)
     version.x = 0;
     version.y = 0;
 
-    for (i = 0; i < vary.base->dc; i++)
+    for (i = 0; i < game_base.dc; i++)
     {
-        char *k = vary.base->av + vary.base->dv[i].ai;
-        char *v = vary.base->av + vary.base->dv[i].aj;
+        char *k = game_base.av + game_base.dv[i].ai;
+        char *v = game_base.av + game_base.dv[i].aj;
 
         if (strcmp(k, "version") == 0)
             sscanf(v, "%d.%d", &version.x, &version.y);
@@ -424,16 +321,9 @@ int game_server_init(const char *file_name, int t, int e)
 
     game_tilt_init(&tilt);
 
-    /* Initialize jump and goal states. */
-
-    jump_e = 1;
-    jump_b = 0;
-
-    goal_e = e ? 1 : 0;
-
     /* Initialize the view (and put it at the ball). */
 
-    game_view_fly(&view, &vary, 0.0f);
+    game_view_fly(&view, &world.vary, 0.0f);
 
     view_k = 1.0f;
 
@@ -443,17 +333,13 @@ int game_server_init(const char *file_name, int t, int e)
     view_zoom_curr = 1.0f;
     view_zoom_time = ZOOM_TIME;
 
-    /* Initialize simulation. */
-
-    sol_init_sim(&vary);
-
     /* Send initial update. */
 
     game_cmd_map(file_name, version.x, version.y);
     game_cmd_ups();
     game_cmd_timer();
 
-    if (goal_e)
+    if (world.goal_e)
         game_cmd_goalopen();
 
     game_cmd_init_balls();
@@ -472,8 +358,7 @@ void game_server_free(const char *next)
 {
     if (server_state)
     {
-        sol_quit_sim();
-        sol_free_vary(&vary);
+        world_free(&world);
 
         game_base_free(next);
 
@@ -518,8 +403,8 @@ static void game_update_view(float dt)
     int velocity_xz = cam_velocity_xz(cam);
     float rotate_max = (float) cam_rotate_max(cam) / 100.0f;
 
-    float dc = view.dc * (jump_b > 0 ? 2.0f * fabsf(jump_dt - 0.5f) : 1.0f);
-    float ball_spd = v_len(vary.uv->v);
+    float dc = view.dc * (world.jump_b > 0 ? 2.0f * fabsf(world.jump_dt - 0.5f) : 1.0f);
+    float ball_spd = v_len(world.vary.uv->v);
     float rot_mult = torque ? CLAMP(1.0f, 1.0f + ball_spd / 24.0f, rotate_max) : 1.0f;
     float da = 90.0f * input_get_r() * rot_mult * dt;
     float dx = (!velocity_xz && spd >= 0.0f) ? (input_get_r() * rot_mult * dt * 5.0f) : 0.0f;
@@ -559,19 +444,19 @@ static void game_update_view(float dt)
 
     /* Center the view about the ball. */
 
-    v_cpy(view.c, vary.uv->p);
+    v_cpy(view.c, world.vary.uv->p);
 
     /* Construct velocity vector. */
 
     if (velocity_xz)
     {
-        view_v[0] = -vary.uv->v[0];
+        view_v[0] = -world.vary.uv->v[0];
         view_v[1] =  0.0f;
-        view_v[2] = -vary.uv->v[2];
+        view_v[2] = -world.vary.uv->v[2];
     }
     else
     {
-        v_inv(view_v, vary.uv->v);
+        v_inv(view_v, world.vary.uv->v);
     }
 
     /* Compute chase vector update. */
@@ -642,11 +527,11 @@ static void game_update_view(float dt)
     v_scl(v,    view.e[1], SCL * view.dp * view_k);
     v_mad(v, v, view.e[2], SCL * view.dz * view_k);
     v_mad(v, v, view.e[0], SCL * dx      * view_k);
-    v_add(view.p, v, vary.uv->p);
+    v_add(view.p, v, world.vary.uv->p);
 
     /* Compute the new view center. */
 
-    v_cpy(view.c, vary.uv->p);
+    v_cpy(view.c, world.vary.uv->p);
     v_mad(view.c, view.c, view.e[1], SCL * dc);
 
     /* Note the current view angle. */
@@ -656,23 +541,6 @@ static void game_update_view(float dt)
     game_cmd_updview();
 }
 
-static void game_update_time(float dt, int b)
-{
-    if (b)
-    {
-        time_elapsed += dt;
-
-        if (time_limit > 0.0f && time_elapsed > time_limit)
-            time_elapsed = time_limit;
-
-        /* Something that works for both timed and untimed levels. */
-
-        timer = fabsf(time_limit - time_elapsed);
-
-        game_cmd_timer();
-    }
-}
-
 /*
  * Start view zoom animation.
  */
@@ -683,207 +551,90 @@ static void zoom_init(float target)
     view_zoom_end = CLAMP(ZOOM_MIN, target, ZOOM_MAX);
 }
 
-static int game_update_state(int bt)
+static void game_step(float dt)
 {
-    struct b_goal *zp;
-    int hi;
-
-    /* Test for an item. */
+    float p[3];
+    int   c;
 
-    if (bt && (hi = sol_item_test(&vary, NULL, ITEM_RADIUS)) != -1)
-    {
-        struct v_item *hp = vary.hv + hi;
+    /* Smooth jittery or discontinuous input. */
 
-        game_cmd_pkitem(hi);
+    tilt.rx += (input_get_x() - tilt.rx) * dt / MAX(dt, input_get_s());
+    tilt.rz += (input_get_z() - tilt.rz) * dt / MAX(dt, input_get_s());
 
-        if (hp->t == ITEM_COIN)
-        {
-            coins += hp->n;
-            game_cmd_coins();
-        }
-        else if (hp->t == ITEM_CLOCK)
-        {
-            const float value = (float) hp->n;
+    game_tilt_axes(&tilt, view.e);
 
-            audio_play(AUD_CLOCK, 1.f);
+    game_cmd_tiltaxes();
+    game_cmd_tiltangles();
 
-            /* For timed levels, increase the effective time limit. */
-            /* For untimed levels, reduce time elapsed for a better highscore. */
+    /* Run the world. */
 
-            if (time_limit > 0.0f)
-                time_limit = time_limit + value;
-            else
-                time_elapsed = MAX(0.0f, time_elapsed - value);
+    v_cpy(p, world.vary.uv->p);
 
-            game_update_time(0.0f, bt);
-        }
-        else if (hp->t == ITEM_GROW || hp->t == ITEM_SHRINK)
-        {
-            switch (grow_init(hp->t))
-            {
-                case -1:
-                    audio_play(AUD_SHRINK, 1.0f);
-                    zoom_init(vary.uv->sizes[vary.uv->size] / vary.uv->sizes[1]);
-                    break;
-
-                case +1:
-                    audio_play(AUD_GROW, 1.0f);
-                    zoom_init(vary.uv->sizes[vary.uv->size] / vary.uv->sizes[1]);
-                    break;
-
-                case 0:
-                    /* TODO: buzzer wrong (wasted item). */
-                    break;
-            }
-        }
+    c = world_step(&world, &tilt, dt);
 
-        audio_play(AUD_COIN, 1.f);
+    /* Translate view at the exact instant of the jump. */
 
-        /* Discard item. */
+    if (world.events & WORLD_LEAP)
+    {
+        float dp[3];
 
-        hp->t = ITEM_NONE;
+        v_sub(dp,     world.jump_p, p);
+        v_add(view.p, view.p, dp);
     }
 
-    /* Test for a switch. */
-
-    if (sol_swch_test(&vary, game_proxy_enq, 0) == SWCH_INSIDE)
-        audio_play(AUD_SWITCH, 1.f);
-
-    /* Test for a jump. */
+    /* Mix the sound of a ball bounce. */
 
-    if (jump_e == 1 && jump_b == 0 && (sol_jump_test(&vary, jump_p, 0) ==
-                                       JUMP_INSIDE))
+    if (world.bump > 0.5f)
     {
-        jump_b  = 1;
-        jump_e  = 0;
-        jump_dt = 0.f;
+        const struct v_ball *up = world.vary.uv;
 
-        audio_play(AUD_JUMP, 1.f);
+        float k = (world.bump - 0.5f) * 2.0f;
 
-        game_cmd_jump(1);
-    }
-    if (jump_e == 0 && jump_b == 0 && (sol_jump_test(&vary, jump_p, 0) ==
-                                       JUMP_OUTSIDE))
-    {
-        jump_e = 1;
-        game_cmd_jump(0);
+        if      (up->r > up->sizes[1]) audio_play(AUD_BUMPL, k);
+        else if (up->r < up->sizes[1]) audio_play(AUD_BUMPS, k);
+        else                           audio_play(AUD_BUMPM, k);
     }
 
-    /* Test for a goal. */
+    game_update_view(dt);
 
-    if (bt && goal_e && (zp = sol_goal_test(&vary, NULL, 0)))
-    {
-        audio_play(AUD_GOAL, 1.0f);
-        return GAME_GOAL;
-    }
+    /* Play out the events of the step. */
 
-    /* Test for time-out. */
+    if (world.events & WORLD_CLOCK)
+        audio_play(AUD_CLOCK, 1.f);
 
-    if (bt && time_limit > 0.0f && time_elapsed >= time_limit)
+    if (world.events & (WORLD_GROW | WORLD_SHRINK))
     {
-        audio_play(AUD_TIME, 1.0f);
-        return GAME_TIME;
-    }
-
-    /* Test for fall-out. */
+        const struct v_ball *up = world.vary.uv;
 
-    if (bt && (vary.base->vc == 0 || vary.uv[0].p[1] < vary.base->vv[0].p[1]))
-    {
-        audio_play(AUD_FALL, 1.0f);
-        return GAME_FALL;
+        audio_play((world.events & WORLD_GROW) ? AUD_GROW : AUD_SHRINK, 1.0f);
+        zoom_init(up->sizes[up->size] / up->sizes[1]);
     }
 
-    return GAME_NONE;
-}
+    if (world.events & WORLD_ITEM)
+        audio_play(AUD_COIN, 1.f);
+    if (world.events & WORLD_SWITCH)
+        audio_play(AUD_SWITCH, 1.f);
+    if (world.events & WORLD_JUMP)
+        audio_play(AUD_JUMP, 1.f);
 
-static int game_step(const float g[3], float dt, int bt)
-{
-    if (server_state)
+    if (c)
     {
-        float h[3];
-
-        /* Smooth jittery or discontinuous input. */
-
-        tilt.rx += (input_get_x() - tilt.rx) * dt / MAX(dt, input_get_s());
-        tilt.rz += (input_get_z() - tilt.rz) * dt / MAX(dt, input_get_s());
-
-        game_tilt_axes(&tilt, view.e);
-
-        game_cmd_tiltaxes();
-        game_cmd_tiltangles();
-
-        grow_step(dt);
-
-        game_tilt_grav(h, g, &tilt);
-
-        if (jump_b > 0)
-        {
-            jump_dt += dt;
-
-            /* Handle a jump. */
-
-            if (jump_dt >= 0.5f)
-            {
-                /* Translate view at the exact instant of the jump. */
-
-                if (jump_b == 1)
-                {
-                    float dp[3];
-
-                    v_sub(dp,     jump_p, vary.uv->p);
-                    v_add(view.p, view.p, dp);
-
-                    jump_b = 2;
-                }
-
-                /* Translate ball and hold it at the destination. */
-
-                v_cpy(vary.uv->p, jump_p);
-            }
-
-            if (jump_dt >= 1.0f)
-                jump_b = 0;
-        }
-        else
+        switch (world.status)
         {
-            /* Run the sim. */
-
-            float b = sol_step(&vary, game_proxy_enq, h, dt, 0, NULL);
-
-            /* Mix the sound of a ball bounce. */
-
-            if (b > 0.5f)
-            {
-                float k = (b - 0.5f) * 2.0f;
-
-                if      (vary.uv->r > vary.uv->sizes[1]) audio_play(AUD_BUMPL, k);
-                else if (vary.uv->r < vary.uv->sizes[1]) audio_play(AUD_BUMPS, k);
-                else                                     audio_play(AUD_BUMPM, k);
-            }
+        case GAME_GOAL: audio_play(AUD_GOAL, 1.0f); break;
+        case GAME_TIME: audio_play(AUD_TIME, 1.0f); break;
+        case GAME_FALL: audio_play(AUD_FALL, 1.0f); break;
         }
-
-        game_cmd_updball();
-
-        game_update_view(dt);
-        game_update_time(dt, bt);
-
-        return game_update_state(bt);
+        game_cmd_status();
     }
-    return GAME_NONE;
 }
 
 static void game_server_iter(float dt)
 {
-    switch (status)
-    {
-    case GAME_GOAL: game_step(GRAVITY_UP, dt, 0); break;
-    case GAME_FALL: game_step(GRAVITY_DN, dt, 0); break;
+    /* Nothing moves after a time-out. */
 
-    case GAME_NONE:
-        if ((status = game_step(GRAVITY_DN, dt, 1)) != GAME_NONE)
-            game_cmd_status();
-        break;
-    }
+    if (server_state && world.status != GAME_TIME)
+        game_step(dt);
 
     game_cmd_eou();
 }
@@ -905,9 +656,8 @@ float game_server_blend(void)
 void game_set_goal(void)
 {
     audio_play(AUD_SWITCH, 1.0f);
-    goal_e = 1;
 
-    game_cmd_goalopen();
+    world_goal(&world);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -956,7 +706,7 @@ void game_set_rot(float r)
 
 float curr_time_elapsed(void)
 {
-    return time_elapsed;
+    return world.time_elapsed;
 }
 
 /*---------------------------------------------------------------------------*/
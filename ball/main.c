@@ -30,6 +30,7 @@
 #include "image.h"
 #include "audio.h"
 #include "demo.h"
+#include "demo_dir.h"
 #include "progress.h"
 #include "gui.h"
 #include "set.h"
@@ -889,6 +890,8 @@ static int main_init(int argc, char *argv[])
     config_init();
     config_load();
 
+    fs_cache_set_budget(config_get_d(CONFIG_CACHE_BUDGET) * 1024);
+
     fetch_enable(config_get_d(CONFIG_ONLINE));
 
     package_init();
@@ -938,7 +941,10 @@ static void main_quit(void)
     game_client_free(NULL);
     game_server_free(NULL);
     game_proxy_clr();
+    game_proxy_log();
 
+    demo_play_wait(-1);
+    demo_dir_quit();
     mtrl_quit();
     video_quit();
     tilt_free();
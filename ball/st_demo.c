@@ -54,16 +54,58 @@ static int last  = 0;
 static int selected = 0;
 static int last_viewed = 0;
 
+/* Order and filter of the list, from the replay index. */
+
+static int sort   = DEMO_SORT_NAME;
+static int filter = DEMO_FILTER_NONE;
+
+static struct demo filter_like;
+
+static const char *sort_names[DEMO_SORT_MAX] = {
+    N_("Name"),
+    N_("Date"),
+    N_("Player"),
+    N_("Level"),
+    N_("Status")
+};
+
+static const char *filter_names[DEMO_FILTER_MAX] = {
+    N_("All"),
+    N_("Player"),
+    N_("Level"),
+    N_("Status")
+};
+
 /*---------------------------------------------------------------------------*/
 
 enum
 {
     DEMO_PLAY = GUI_LAST,
-    DEMO_SELECT
+    DEMO_SELECT,
+    DEMO_SORT,
+    DEMO_FILTER
 };
 
 static void demo_select(int i);
 
+/*
+ * Drop the list so that entering the screen queries it anew.
+ */
+static int demo_requery(void)
+{
+    if (items)
+    {
+        demo_dir_free(items);
+        items = NULL;
+    }
+
+    first       = 0;
+    selected    = 0;
+    last_viewed = 0;
+
+    return goto_state(&st_demo);
+}
+
 static int demo_action(int tok, int val)
 {
     audio_play(AUD_MENU, 1.0f);
@@ -87,6 +129,19 @@ static int demo_action(int tok, int val)
         demo_select(val);
         break;
 
+    case DEMO_SORT:
+        sort = (sort + 1) % DEMO_SORT_MAX;
+        return demo_requery();
+
+    case DEMO_FILTER:
+        /* Show replays like the one selected. */
+
+        if (filter == DEMO_FILTER_NONE && total && DEMO_GET(items, selected))
+            filter_like = *DEMO_GET(items, selected);
+
+        filter = (filter + 1) % DEMO_FILTER_MAX;
+        return demo_requery();
+
     case DEMO_PLAY:
         if (progress_replay(DIR_ITEM_GET(items, selected)->path))
         {
@@ -318,6 +373,9 @@ static int demo_gui(void)
             {
                 gui_label(jd, _("Select Replay"), GUI_SML, 0,0);
                 gui_filler(jd);
+                gui_state(jd, _(filter_names[filter]), GUI_SML, DEMO_FILTER, 0);
+                gui_state(jd, _(sort_names[sort]),     GUI_SML, DEMO_SORT,   0);
+                gui_space(jd);
                 gui_navig(jd, total, first, DEMO_STEP);
             }
 
@@ -364,7 +422,7 @@ static int demo_enter(struct state *st, struct state *prev, int intent)
             items = NULL;
         }
 
-        items = demo_dir_scan();
+        items = demo_dir_query(sort, filter, &filter_like);
         total = array_len(items);
     }
 
@@ -455,6 +513,14 @@ static int transition;
 
 static float prelude;
 
+/*
+ * Scrubbing: while the stick or the left and right keys lean, the
+ * replay is played at that rate, backwards too, in place of its speed.
+ */
+static float scrub_v;                   /* Rate, replay seconds per second   */
+static float scrub_t;                   /* Time into the replay              */
+static int   scrubbing;
+
 void demo_play_goto(int s)
 {
     standalone   = s;
@@ -481,6 +547,9 @@ static int demo_play_enter(struct state *st, struct state *prev, int intent)
 
     video_hide_cursor();
 
+    scrub_v   = 0.0f;
+    scrubbing = 0;
+
     if (demo_paused)
     {
         demo_paused = 0;
@@ -550,6 +619,25 @@ static void demo_play_timer(int id, float dt)
     if (time_state() < prelude)
         return;
 
+    if (scrub_v != 0.0f)
+    {
+        if (!scrubbing)
+        {
+            scrub_t   = demo_replay_time();
+            scrubbing = 1;
+        }
+
+        scrub_t = MAX(scrub_t + scrub_v * dt, 0.0f);
+
+        demo_replay_seek(scrub_t);
+
+        progress_step();
+        game_client_blend(demo_replay_blend());
+        return;
+    }
+
+    scrubbing = 0;
+
     if (!demo_replay_step(dt))
     {
         demo_paused = 0;
@@ -573,6 +661,9 @@ static void set_speed(int d)
 
 static void demo_play_stick(int id, int a, float v, int bump)
 {
+    if (config_tst_d(CONFIG_JOYSTICK_AXIS_X0, a))
+        scrub_v = v;
+
     if (!bump)
         return;
 
@@ -87,6 +87,7 @@ BALL_SRCS := \
 	share/cmd.c \
 	share/common.c \
 	share/config.c \
+	share/demo_scan.c \
 	share/dir.c \
 	share/fetch_emscripten.c \
 	share/font.c \
@@ -113,8 +114,10 @@ BALL_SRCS := \
 	share/solid_all.c \
 	share/solid_base.c \
 	share/solid_draw.c \
+	share/solid_pack.c \
 	share/solid_sim_sol.c \
 	share/solid_vary.c \
+	share/solid_world.c \
 	share/st_common.c \
 	share/st_package.c \
 	share/mapclib.c \
@@ -123,13 +126,16 @@ BALL_SRCS := \
 	share/theme.c \
 	share/tilt_null.c \
 	share/vec3.c \
-	share/video.c
+	share/video.c \
+	share/writer.c
 
 BALL_OBJS := $(BALL_SRCS:.c=.emscripten.o)
 
 %.emscripten.o: %.c
 	$(CC) -c -o $@ $(CFLAGS) $(EM_CFLAGS) $<
 
+share/solid_sim_sol.emscripten.o share/solid_pack.emscripten.o: CFLAGS += -ffp-contract=off
+
 .PHONY: neverball
 neverball: $(JSDIR)/neverball.js $(JSDIR)/service-worker.js
 
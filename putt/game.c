@@ -100,7 +100,7 @@ int game_init(const char *s)
     if (!(state = sol_load_full(&file, s, config_get_d(CONFIG_SHADOW))))
         return 0;
 
-    sol_init_sim(&file.vary);
+    sol_init_sim(&file.vary, NULL);
 
     for (i = 0; i < file.base.dc; i++)
     {
@@ -120,7 +120,7 @@ int game_init(const char *s)
 
 void game_free(void)
 {
-    sol_quit_sim();
+    sol_quit_sim(&file.vary);
     sol_free_full(&file);
 }
 
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+# Re-simulate the shipped replays and check the verdicts of nbrverify.
+# The levels must have been compiled.
+
+NBRVERIFY="${1:-./nbrverify}"
+DATA="${2:-data}"
+
+# ball.nbr was recorded by a build with other physics. It follows this
+# one to the step for 21 seconds, then drifts off.
+
+EXPECT="ball.nbr drift
+demo1.nbr ok
+demo2.nbr ok"
+
+GOT="$("$NBRVERIFY" --data "$DATA" "$DATA/gui")" || {
+    echo "$0: $NBRVERIFY failed"
+    exit 1
+}
+
+GOT="$(echo "$GOT" | awk 'NR > 1 { print $1, $NF }')"
+
+[ "$GOT" = "$EXPECT" ] || {
+    echo "$0: expected verdicts:"
+    echo "$EXPECT"
+    echo "$0: got:"
+    echo "$GOT"
+    exit 1
+}
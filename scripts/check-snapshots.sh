@@ -0,0 +1,29 @@
+#!/bin/sh
+
+# Check that world snapshots of the shipped replays restore, and that
+# the check fails when a field is left out of the restore.  The levels
+# must have been compiled.
+
+SOLBENCH="${1:-./solbench}"
+DATA="${2:-data}"
+
+REF="$(mktemp)" || exit 1
+trap 'rm -f "$REF"' EXIT
+
+"$SOLBENCH" --data "$DATA" --out "$REF" "$DATA/gui" > /dev/null || {
+    echo "$0: $SOLBENCH failed"
+    exit 1
+}
+
+"$SOLBENCH" --data "$DATA" --check "$REF" "$DATA/gui" > /dev/null || {
+    echo "$0: snapshots do not restore"
+    exit 1
+}
+
+for FIELD in accum move; do
+    if "$SOLBENCH" --data "$DATA" --check "$REF" --snap-drop $FIELD \
+                   "$DATA/gui" > /dev/null 2>&1; then
+        echo "$0: snapshot check misses a restore without $FIELD"
+        exit 1
+    fi
+done
@@ -93,6 +93,8 @@ void audio_play(const char *filename, float a)
 
             Neverball.audioPlay(fileName, fileData, a);
         }, filename, data, size, LOG_VOLUME(CLAMP(0.0f, a, 1.0f)));
+
+        fs_cache_release(data);
     }
 }
 
@@ -152,6 +154,8 @@ void audio_music_fade_to(float t, const char *filename)
 
             Neverball.audioMusicFadeTo(fileName, fileData, t);
         }, filename, data, size, t);
+
+        fs_cache_release(data);
     }
 }
 
@@ -17,6 +17,51 @@
 #include <string.h>
 
 #include "fs.h"
+#include "binary.h"
+#include "common.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Values are little-endian.  They go straight to or from the file
+ * buffer when it has room, and through fs_write or fs_read when not.
+ */
+
+static void put_bytes(fs_file fout, const unsigned char *b, int n)
+{
+    struct fs_buf *bp = FS_BUF(fout);
+
+    if (bp->we - bp->wp >= n)
+    {
+        memcpy(bp->wp, b, n);
+        bp->wp += n;
+    }
+    else fs_write(b, n, fout);
+}
+
+static const unsigned char *get_bytes(fs_file fin, unsigned char *b, int n)
+{
+    struct fs_buf *bp = FS_BUF(fin);
+
+    if (bp->re - bp->rp >= n)
+    {
+        const unsigned char *p = bp->rp;
+        bp->rp += n;
+        return p;
+    }
+
+    /* Missing bytes read as 0xff, as from fs_getc at the end. */
+
+    memset(b, 0xff, n);
+    fs_read(b, n, fin);
+
+    return b;
+}
+
+#define GET32(p) ((unsigned int) (p)[0]       | \
+                  (unsigned int) (p)[1] << 8  | \
+                  (unsigned int) (p)[2] << 16 | \
+                  (unsigned int) (p)[3] << 24)
 
 /*---------------------------------------------------------------------------*/
 
@@ -26,24 +71,29 @@ void put_float(fs_file fout, float f)
 
     memcpy(&val, &f, sizeof (val));
 
-    fs_putc((val)       & 0xff, fout);
-    fs_putc((val >> 8)  & 0xff, fout);
-    fs_putc((val >> 16) & 0xff, fout);
-    fs_putc((val >> 24) & 0xff, fout);
+    put_index(fout, (int) val);
 }
 
 void put_index(fs_file fout, int val)
 {
-    fs_putc((val)       & 0xff, fout);
-    fs_putc((val >> 8)  & 0xff, fout);
-    fs_putc((val >> 16) & 0xff, fout);
-    fs_putc((val >> 24) & 0xff, fout);
+    unsigned char b[4];
+
+    b[0] = (val)       & 0xff;
+    b[1] = (val >> 8)  & 0xff;
+    b[2] = (val >> 16) & 0xff;
+    b[3] = (val >> 24) & 0xff;
+
+    put_bytes(fout, b, 4);
 }
 
 void put_short(fs_file fout, short val)
 {
-    fs_putc((val)      & 0xff, fout);
-    fs_putc((val >> 8) & 0xff, fout);
+    unsigned char b[2];
+
+    b[0] = (val)      & 0xff;
+    b[1] = (val >> 8) & 0xff;
+
+    put_bytes(fout, b, 2);
 }
 
 void put_array(fs_file fout, const float *v, size_t n)
@@ -58,11 +108,10 @@ void put_array(fs_file fout, const float *v, size_t n)
 
 float get_float(fs_file fin)
 {
-    unsigned int val =
-        (fs_getc(fin) & 0xff)       |
-        (fs_getc(fin) & 0xff) << 8  |
-        (fs_getc(fin) & 0xff) << 16 |
-        (fs_getc(fin) & 0xff) << 24;
+    unsigned char b[4];
+    const unsigned char *p = get_bytes(fin, b, 4);
+
+    unsigned int val = GET32(p);
 
     float f = 0.0f;
 
@@ -73,18 +122,18 @@ float get_float(fs_file fin)
 
 int get_index(fs_file fin)
 {
-    int val =
-        (fs_getc(fin) & 0xff)       |
-        (fs_getc(fin) & 0xff) << 8  |
-        (fs_getc(fin) & 0xff) << 16 |
-        (fs_getc(fin) & 0xff) << 24;
+    unsigned char b[4];
+    const unsigned char *p = get_bytes(fin, b, 4);
 
-    return val;
+    return (int) GET32(p);
 }
 
 short get_short(fs_file fin)
 {
-    short val = (fs_getc(fin) & 0xff) | (fs_getc(fin) & 0xff) << 8;
+    unsigned char b[2];
+    const unsigned char *p = get_bytes(fin, b, 2);
+
+    short val = p[0] | p[1] << 8;
 
     return val;
 }
@@ -101,16 +150,35 @@ void get_array(fs_file fin, float *v, size_t n)
 
 void put_string(fs_file fout, const char *s)
 {
-    fs_puts(s, fout);
-    fs_putc('\0', fout);
+    fs_write(s, strlen(s) + 1, fout);
 }
 
 void get_string(fs_file fin, char *s, size_t max)
 {
+    struct fs_buf *bp = FS_BUF(fin);
+    const unsigned char *z = NULL;
     size_t pos = 0;
     int c;
 
-    while ((c = fs_getc(fin)) >= 0)
+    /* Copy in one go if the terminator is already buffered. */
+
+    if (bp->rp < bp->re)
+        z = memchr(bp->rp, 0, bp->re - bp->rp);
+
+    if (z)
+    {
+        if (max > 0)
+        {
+            pos = MIN((size_t) (z - bp->rp), max - 1);
+
+            memcpy(s, bp->rp, pos);
+            s[pos] = 0;
+        }
+        bp->rp = (unsigned char *) z + 1;
+        return;
+    }
+
+    while ((c = FS_GETC(fin)) >= 0)
     {
         if (pos < max)
         {
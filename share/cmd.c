@@ -13,7 +13,11 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
+#include <math.h>
 
 #include "cmd.h"
 #include "binary.h"
@@ -26,6 +30,269 @@ static int cmd_stats = 0;
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Version 10 command bodies.  Given a stream, the value functions
+ * called from the DEFINE_CMD bodies code into its buffer instead of
+ * the file, so one table serves both encodings.  Without one, they
+ * read and write the file.  All the state is in the stream, so any
+ * number of them may be coded at once.
+ *
+ * Integers are zigzag varints.  Floats that are only drawn (ball and
+ * view positions and bases) are deltas quantised to a power of two,
+ * with an escape to the exact form.  Other floats are exact: the XOR
+ * of their bits with the last value, as a varint.  Either way a value
+ * that did not change takes one byte.
+ */
+
+#define QUANT_MAX (1 << 24)
+
+#define ZIGZAG(i)   (((unsigned int) (i) << 1) ^ ((i) < 0 ? ~0u : 0u))
+#define UNZIGZAG(u) ((int) (((u) >> 1) ^ (0u - ((u) & 1))))
+
+static float cmd_quantum(enum cmd_type type)
+{
+    switch (type)
+    {
+    case CMD_BALL_POSITION:
+    case CMD_VIEW_POSITION:
+    case CMD_VIEW_CENTER:
+        return 1.0f / 4096.0f;
+
+    case CMD_BALL_BASIS:
+    case CMD_BALL_PEND_BASIS:
+    case CMD_VIEW_BASIS:
+        return 1.0f / 32768.0f;
+
+    default:
+        return 0.0f;
+    }
+}
+
+static unsigned int float_bits(float f)
+{
+    unsigned int u;
+    memcpy(&u, &f, sizeof (u));
+    return u;
+}
+
+static float bits_float(unsigned int u)
+{
+    float f;
+    memcpy(&f, &u, sizeof (f));
+    return f;
+}
+
+static void cs_put_byte(struct cmd_stream *cs, int b)
+{
+    if (cs->n < CMD_STREAM_BYTES)
+        cs->buf[cs->n++] = b;
+    else
+        cs->err = 1;
+}
+
+static int cs_get_byte(struct cmd_stream *cs)
+{
+    if (cs->i < cs->n)
+        return cs->src[cs->i++];
+
+    cs->err = 1;
+    return 0;
+}
+
+static void cs_put_varint(struct cmd_stream *cs, unsigned int u)
+{
+    while (u >= 0x80)
+    {
+        cs_put_byte(cs, (u & 0x7f) | 0x80);
+        u >>= 7;
+    }
+    cs_put_byte(cs, u);
+}
+
+static unsigned int cs_get_varint(struct cmd_stream *cs)
+{
+    unsigned int u = 0;
+    int b, n;
+
+    for (n = 0; n < 35; n += 7)
+    {
+        b = cs_get_byte(cs);
+        u |= (unsigned int) (b & 0x7f) << n;
+
+        if (!(b & 0x80))
+            break;
+    }
+    return u;
+}
+
+static float *cs_delta(struct cmd_stream *cs)
+{
+    return cs->k < CMD_DELTA_VALUES ? &cs->delta.v[cs->type][cs->k] : NULL;
+}
+
+/*
+ * Both ends must arrive at the same quantised value.
+ */
+static float cs_dequant(float p, int n, float q)
+{
+    return p + (float) n * q;
+}
+
+static void cs_put_float(struct cmd_stream *cs, float f)
+{
+    float *dp = cs_delta(cs);
+    float  p  = dp ? *dp : 0.0f;
+    float  q  = cmd_quantum(cs->type);
+    float  d;
+    int    n;
+
+    cs->k++;
+
+    if (q > 0.0f)
+    {
+        /* This is false for NaN, too. */
+
+        if ((d = (f - p) / q) > -QUANT_MAX && d < QUANT_MAX)
+        {
+            n = (int) floorf(d + 0.5f);
+
+            cs_put_varint(cs, ZIGZAG(n) << 1);
+
+            if (dp) *dp = cs_dequant(p, n, q);
+            return;
+        }
+        cs_put_varint(cs, 1);
+    }
+
+    cs_put_varint(cs, float_bits(f) ^ float_bits(p));
+
+    if (dp) *dp = f;
+}
+
+static float cs_get_float(struct cmd_stream *cs)
+{
+    float *dp = cs_delta(cs);
+    float  p  = dp ? *dp : 0.0f;
+    float  q  = cmd_quantum(cs->type);
+    float  f;
+
+    unsigned int u;
+
+    cs->k++;
+
+    u = cs_get_varint(cs);
+
+    if (q > 0.0f)
+    {
+        if (!(u & 1))
+        {
+            f = cs_dequant(p, UNZIGZAG(u >> 1), q);
+
+            if (dp) *dp = f;
+            return f;
+        }
+        u = cs_get_varint(cs);
+    }
+
+    f = bits_float(u ^ float_bits(p));
+
+    if (dp) *dp = f;
+    return f;
+}
+
+/*
+ * The value functions of the command bodies.
+ */
+
+static void cmd_put_index(fs_file fp, struct cmd_stream *cs, int val)
+{
+    if (cs)
+        cs_put_varint(cs, ZIGZAG(val));
+    else
+        put_index(fp, val);
+}
+
+static void cmd_put_float(fs_file fp, struct cmd_stream *cs, float f)
+{
+    if (cs)
+        cs_put_float(cs, f);
+    else
+        put_float(fp, f);
+}
+
+static void cmd_put_array(fs_file fp, struct cmd_stream *cs,
+                          const float *v, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        cmd_put_float(fp, cs, v[i]);
+}
+
+static void cmd_put_string(fs_file fp, struct cmd_stream *cs, const char *str)
+{
+    size_t i;
+
+    if (cs)
+    {
+        /* Readers take no more than this. */
+
+        for (i = 0; str[i] && i < MAXSTR - 1; i++)
+            cs_put_byte(cs, str[i]);
+
+        cs_put_byte(cs, 0);
+    }
+    else put_string(fp, str);
+}
+
+static int cmd_get_index(fs_file fp, struct cmd_stream *cs)
+{
+    return cs ? UNZIGZAG(cs_get_varint(cs)) : get_index(fp);
+}
+
+static float cmd_get_float(fs_file fp, struct cmd_stream *cs)
+{
+    return cs ? cs_get_float(cs) : get_float(fp);
+}
+
+static void cmd_get_array(fs_file fp, struct cmd_stream *cs,
+                          float *v, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        v[i] = cmd_get_float(fp, cs);
+}
+
+static void cmd_get_string(fs_file fp, struct cmd_stream *cs,
+                           char *str, size_t max)
+{
+    size_t pos = 0;
+    int c;
+
+    if (cs)
+    {
+        while ((c = cs_get_byte(cs)) != 0)
+            if (pos + 1 < max)
+                str[pos++] = c;
+
+        if (max)
+            str[pos] = 0;
+    }
+    else get_string(fp, str, max);
+}
+
+#define put_index  cmd_put_index
+#define put_float  cmd_put_float
+#define put_array  cmd_put_array
+#define put_string cmd_put_string
+#define get_index  cmd_get_index
+#define get_float  cmd_get_float
+#define get_array  cmd_get_array
+#define get_string cmd_get_string
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Let's pretend these aren't Ridiculously Convoluted Macros from
  * Hell, and that all this looks pretty straight-forward.  (In all
@@ -34,8 +301,9 @@ static int cmd_stats = 0;
  * A command's "write" and "read" functions are defined by calling the
  * PUT_FUNC or the GET_FUNC macro, respectively, with the command type
  * as argument, followed by the body of the function (which has
- * variables "fp" and "cmd" available), and finalised with the
- * END_FUNC macro, which must be terminated with a semi-colon.  Before
+ * variables "fp", "cs" and "cmd" available, and passes "fp" and "cs"
+ * to each value function), and finalised with the END_FUNC macro,
+ * which must be terminated with a semi-colon.  Before
  * the function definitions, the BYTES macro must be redefined for
  * each command to an expression evaluating to the number of bytes
  * that the command will occupy in the file.  (See existing commands
@@ -43,20 +311,22 @@ static int cmd_stats = 0;
  */
 
 #define PUT_FUNC(type, bytes)                                           \
-    static void cmd_put_ ## type(fs_file fp, const union cmd *cmd) {    \
+    static void cmd_put_ ## type(fs_file fp, struct cmd_stream *cs,     \
+                                 const union cmd *cmd) {                \
     const char *cmd_name = #type;                                       \
                                                                         \
     /* This is a write, so BYTES should be safe to eval already. */     \
     short cmd_bytes = (bytes);                                            \
                                                                         \
     /* Write command size info (right after the command type). */       \
-    put_short(fp, cmd_bytes);                                           \
+    if (!cs) put_short(fp, cmd_bytes);                                  \
                                                                         \
     /* Start the stats output. */                                       \
     if (cmd_stats) printf("put");                                       \
 
 #define GET_FUNC(type, bytes)                                   \
-    static void cmd_get_ ## type(fs_file fp, union cmd *cmd) {  \
+    static void cmd_get_ ## type(fs_file fp, struct cmd_stream *cs, \
+                                 union cmd *cmd) {                  \
     const char *cmd_name = #type;                               \
                                                                 \
     /* This is a read, so we'll have to eval BYTES later. */    \
@@ -91,70 +361,70 @@ DEFINE_CMD(CMD_MAKE_BALL, 0, {}, {});
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_MAKE_ITEM, ARRAY_BYTES(3) + INDEX_BYTES + INDEX_BYTES, {
-    put_array(fp, cmd->mkitem.p, 3);
-    put_index(fp, cmd->mkitem.t);
-    put_index(fp, cmd->mkitem.n);
+    put_array(fp, cs, cmd->mkitem.p, 3);
+    put_index(fp, cs, cmd->mkitem.t);
+    put_index(fp, cs, cmd->mkitem.n);
 }, {
-    get_array(fp, cmd->mkitem.p, 3);
+    get_array(fp, cs, cmd->mkitem.p, 3);
 
-    cmd->mkitem.t = get_index(fp);
-    cmd->mkitem.n = get_index(fp);
+    cmd->mkitem.t = get_index(fp, cs);
+    cmd->mkitem.n = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_PICK_ITEM, INDEX_BYTES, {
-    put_index(fp, cmd->pkitem.hi);
+    put_index(fp, cs, cmd->pkitem.hi);
 }, {
-    cmd->pkitem.hi = get_index(fp);
+    cmd->pkitem.hi = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_TILT_ANGLES, FLOAT_BYTES + FLOAT_BYTES, {
-    put_float(fp, cmd->tiltangles.x);
-    put_float(fp, cmd->tiltangles.z);
+    put_float(fp, cs, cmd->tiltangles.x);
+    put_float(fp, cs, cmd->tiltangles.z);
 }, {
-    cmd->tiltangles.x = get_float(fp);
-    cmd->tiltangles.z = get_float(fp);
+    cmd->tiltangles.x = get_float(fp, cs);
+    cmd->tiltangles.z = get_float(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_SOUND, STRING_BYTES(cmd->sound.n) + FLOAT_BYTES, {
-    put_string(fp, cmd->sound.n);
-    put_float(fp, cmd->sound.a);
+    put_string(fp, cs, cmd->sound.n);
+    put_float(fp, cs, cmd->sound.a);
 }, {
     static char buff[MAXSTR];
 
-    get_string(fp, buff, sizeof (buff));
+    get_string(fp, cs, buff, sizeof (buff));
 
-    cmd->sound.a = get_float(fp);
+    cmd->sound.a = get_float(fp, cs);
     cmd->sound.n = strdup(buff);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_TIMER, FLOAT_BYTES, {
-    put_float(fp, cmd->timer.t);
+    put_float(fp, cs, cmd->timer.t);
 }, {
-    cmd->timer.t = get_float(fp);
+    cmd->timer.t = get_float(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_STATUS, INDEX_BYTES, {
-    put_index(fp, cmd->status.t);
+    put_index(fp, cs, cmd->status.t);
 }, {
-    cmd->status.t = get_index(fp);
+    cmd->status.t = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_COINS, INDEX_BYTES, {
-    put_index(fp, cmd->coins.n);
+    put_index(fp, cs, cmd->coins.n);
 }, {
-    cmd->coins.n = get_index(fp);
+    cmd->coins.n = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
@@ -168,21 +438,21 @@ DEFINE_CMD(CMD_JUMP_EXIT, 0, {}, {});
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_BODY_PATH, INDEX_BYTES + INDEX_BYTES, {
-    put_index(fp, cmd->bodypath.bi);
-    put_index(fp, cmd->bodypath.pi);
+    put_index(fp, cs, cmd->bodypath.bi);
+    put_index(fp, cs, cmd->bodypath.pi);
 }, {
-    cmd->bodypath.bi = get_index(fp);
-    cmd->bodypath.pi = get_index(fp);
+    cmd->bodypath.bi = get_index(fp, cs);
+    cmd->bodypath.pi = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_BODY_TIME, INDEX_BYTES + FLOAT_BYTES, {
-    put_index(fp, cmd->bodytime.bi);
-    put_float(fp, cmd->bodytime.t);
+    put_index(fp, cs, cmd->bodytime.bi);
+    put_float(fp, cs, cmd->bodytime.t);
 }, {
-    cmd->bodytime.bi = get_index(fp);
-    cmd->bodytime.t  = get_float(fp);
+    cmd->bodytime.bi = get_index(fp, cs);
+    cmd->bodytime.t  = get_float(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
@@ -192,41 +462,41 @@ DEFINE_CMD(CMD_GOAL_OPEN, 0, {}, {});
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_SWCH_ENTER, INDEX_BYTES, {
-    put_index(fp, cmd->swchenter.xi);
+    put_index(fp, cs, cmd->swchenter.xi);
 }, {
-    cmd->swchenter.xi = get_index(fp);
+    cmd->swchenter.xi = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_SWCH_TOGGLE, INDEX_BYTES, {
-    put_index(fp, cmd->swchtoggle.xi);
+    put_index(fp, cs, cmd->swchtoggle.xi);
 }, {
-    cmd->swchtoggle.xi = get_index(fp);
+    cmd->swchtoggle.xi = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_SWCH_EXIT, INDEX_BYTES, {
-    put_index(fp, cmd->swchexit.xi);
+    put_index(fp, cs, cmd->swchexit.xi);
 }, {
-    cmd->swchexit.xi = get_index(fp);
+    cmd->swchexit.xi = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_UPDATES_PER_SECOND, INDEX_BYTES, {
-    put_index(fp, cmd->ups.n);
+    put_index(fp, cs, cmd->ups.n);
 }, {
-    cmd->ups.n = get_index(fp);
+    cmd->ups.n = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_BALL_RADIUS, FLOAT_BYTES, {
-    put_float(fp, cmd->ballradius.r);
+    put_float(fp, cs, cmd->ballradius.r);
 }, {
-    cmd->ballradius.r = get_float(fp);
+    cmd->ballradius.r = get_float(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
@@ -240,145 +510,250 @@ DEFINE_CMD(CMD_CLEAR_BALLS, 0, {}, {});
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_BALL_POSITION, ARRAY_BYTES(3), {
-    put_array(fp, cmd->ballpos.p, 3);
+    put_array(fp, cs, cmd->ballpos.p, 3);
 }, {
-    get_array(fp, cmd->ballpos.p, 3);
+    get_array(fp, cs, cmd->ballpos.p, 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_BALL_BASIS, ARRAY_BYTES(3) + ARRAY_BYTES(3), {
-    put_array(fp, cmd->ballbasis.e[0], 3);
-    put_array(fp, cmd->ballbasis.e[1], 3);
+    put_array(fp, cs, cmd->ballbasis.e[0], 3);
+    put_array(fp, cs, cmd->ballbasis.e[1], 3);
 }, {
-    get_array(fp, cmd->ballbasis.e[0], 3);
-    get_array(fp, cmd->ballbasis.e[1], 3);
+    get_array(fp, cs, cmd->ballbasis.e[0], 3);
+    get_array(fp, cs, cmd->ballbasis.e[1], 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_BALL_PEND_BASIS, ARRAY_BYTES(3) + ARRAY_BYTES(3), {
-    put_array(fp, cmd->ballpendbasis.E[0], 3);
-    put_array(fp, cmd->ballpendbasis.E[1], 3);
+    put_array(fp, cs, cmd->ballpendbasis.E[0], 3);
+    put_array(fp, cs, cmd->ballpendbasis.E[1], 3);
 }, {
-    get_array(fp, cmd->ballpendbasis.E[0], 3);
-    get_array(fp, cmd->ballpendbasis.E[1], 3);
+    get_array(fp, cs, cmd->ballpendbasis.E[0], 3);
+    get_array(fp, cs, cmd->ballpendbasis.E[1], 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_VIEW_POSITION, ARRAY_BYTES(3), {
-    put_array(fp, cmd->viewpos.p, 3);
+    put_array(fp, cs, cmd->viewpos.p, 3);
 }, {
-    get_array(fp, cmd->viewpos.p, 3);
+    get_array(fp, cs, cmd->viewpos.p, 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_VIEW_CENTER, ARRAY_BYTES(3), {
-    put_array(fp, cmd->viewcenter.c, 3);
+    put_array(fp, cs, cmd->viewcenter.c, 3);
 }, {
-    get_array(fp, cmd->viewcenter.c, 3);
+    get_array(fp, cs, cmd->viewcenter.c, 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_VIEW_BASIS, ARRAY_BYTES(3) + ARRAY_BYTES(3), {
-    put_array(fp, cmd->viewbasis.e[0], 3);
-    put_array(fp, cmd->viewbasis.e[1], 3);
+    put_array(fp, cs, cmd->viewbasis.e[0], 3);
+    put_array(fp, cs, cmd->viewbasis.e[1], 3);
 }, {
-    get_array(fp, cmd->viewbasis.e[0], 3);
-    get_array(fp, cmd->viewbasis.e[1], 3);
+    get_array(fp, cs, cmd->viewbasis.e[0], 3);
+    get_array(fp, cs, cmd->viewbasis.e[1], 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_CURRENT_BALL, INDEX_BYTES, {
-    put_index(fp, cmd->currball.ui);
+    put_index(fp, cs, cmd->currball.ui);
 }, {
-    cmd->currball.ui = get_index(fp);
+    cmd->currball.ui = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_PATH_FLAG, INDEX_BYTES + INDEX_BYTES, {
-    put_index(fp, cmd->pathflag.pi);
-    put_index(fp, cmd->pathflag.f);
+    put_index(fp, cs, cmd->pathflag.pi);
+    put_index(fp, cs, cmd->pathflag.f);
 }, {
-    cmd->pathflag.pi = get_index(fp);
-    cmd->pathflag.f  = get_index(fp);
+    cmd->pathflag.pi = get_index(fp, cs);
+    cmd->pathflag.f  = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_STEP_SIMULATION, FLOAT_BYTES, {
-    put_float(fp, cmd->stepsim.dt);
+    put_float(fp, cs, cmd->stepsim.dt);
 }, {
-    cmd->stepsim.dt = get_float(fp);
+    cmd->stepsim.dt = get_float(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_MAP, STRING_BYTES(cmd->map.name) + INDEX_BYTES * 2, {
-    put_string(fp, cmd->map.name);
+    put_string(fp, cs, cmd->map.name);
 
-    put_index(fp, cmd->map.version.x);
-    put_index(fp, cmd->map.version.y);
+    put_index(fp, cs, cmd->map.version.x);
+    put_index(fp, cs, cmd->map.version.y);
 }, {
     char buff[MAXSTR];
 
-    get_string(fp, buff, sizeof (buff));
+    get_string(fp, cs, buff, sizeof (buff));
 
     cmd->map.name = strdup(buff);
 
-    cmd->map.version.x = get_index(fp);
-    cmd->map.version.y = get_index(fp);
+    cmd->map.version.x = get_index(fp, cs);
+    cmd->map.version.y = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_TILT_AXES, ARRAY_BYTES(3) * 2, {
-    put_array(fp, cmd->tiltaxes.x, 3);
-    put_array(fp, cmd->tiltaxes.z, 3);
+    put_array(fp, cs, cmd->tiltaxes.x, 3);
+    put_array(fp, cs, cmd->tiltaxes.z, 3);
 }, {
-    get_array(fp, cmd->tiltaxes.x, 3);
-    get_array(fp, cmd->tiltaxes.z, 3);
+    get_array(fp, cs, cmd->tiltaxes.x, 3);
+    get_array(fp, cs, cmd->tiltaxes.z, 3);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_MOVE_PATH, INDEX_BYTES + INDEX_BYTES, {
-    put_index(fp, cmd->movepath.mi);
-    put_index(fp, cmd->movepath.pi);
+    put_index(fp, cs, cmd->movepath.mi);
+    put_index(fp, cs, cmd->movepath.pi);
 }, {
-    cmd->movepath.mi = get_index(fp);
-    cmd->movepath.pi = get_index(fp);
+    cmd->movepath.mi = get_index(fp, cs);
+    cmd->movepath.pi = get_index(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
 DEFINE_CMD(CMD_MOVE_TIME, INDEX_BYTES + FLOAT_BYTES, {
-    put_index(fp, cmd->movetime.mi);
-    put_float(fp, cmd->movetime.t);
+    put_index(fp, cs, cmd->movetime.mi);
+    put_float(fp, cs, cmd->movetime.t);
 }, {
-    cmd->movetime.mi = get_index(fp);
-    cmd->movetime.t  = get_float(fp);
+    cmd->movetime.mi = get_index(fp, cs);
+    cmd->movetime.t  = get_float(fp, cs);
 });
 
 /*---------------------------------------------------------------------------*/
 
-#define PUT_CASE(t) case t: cmd_put_ ## t(fp, cmd); break
-#define GET_CASE(t) case t: cmd_get_ ## t(fp, cmd); break
+/*
+ * Allocate and read N values of a key frame or seek index.  N comes
+ * from the file, so it is held to what a command can contain.  Values
+ * that don't fit are read and dropped.
+ */
+static int *get_index_list(fs_file fp, struct cmd_stream *cs, int *n)
+{
+    int *v = NULL;
+    int  i;
 
-int cmd_put(fs_file fp, const union cmd *cmd)
+    *n = CLAMP(0, *n, SHRT_MAX / INDEX_BYTES);
+
+    if (*n && !(v = malloc(*n * sizeof (*v))))
+    {
+        for (i = 0; i < *n; i++)
+            (void) get_index(fp, cs);
+        *n = 0;
+    }
+    for (i = 0; i < *n; i++)
+        v[i] = get_index(fp, cs);
+
+    return v;
+}
+
+static float *get_float_list(fs_file fp, struct cmd_stream *cs, int *n)
 {
-    if (!fp || !cmd)
-        return 0;
+    float *v = NULL;
+    int    i;
 
-    assert(cmd->type > CMD_NONE && cmd->type < CMD_MAX);
+    *n = CLAMP(0, *n, SHRT_MAX / FLOAT_BYTES);
 
-    fs_putc(cmd->type, fp);
+    if (*n && !(v = malloc(*n * sizeof (*v))))
+    {
+        for (i = 0; i < *n; i++)
+            (void) get_float(fp, cs);
+        *n = 0;
+    }
+    if (v)
+        get_array(fp, cs, v, *n);
+
+    return v;
+}
+
+DEFINE_CMD(CMD_KEY_FRAME, (INDEX_BYTES * (2 + cmd->keyframe.ic) +
+                           ARRAY_BYTES(cmd->keyframe.fc)), {
+    int i;
+
+    put_index(fp, cs, cmd->keyframe.ic);
+
+    for (i = 0; i < cmd->keyframe.ic; i++)
+        put_index(fp, cs, cmd->keyframe.iv[i]);
+
+    put_index(fp, cs, cmd->keyframe.fc);
+    put_array(fp, cs, cmd->keyframe.fv, cmd->keyframe.fc);
+}, {
+    cmd->keyframe.ic = get_index(fp, cs);
+    cmd->keyframe.iv = get_index_list(fp, cs, &cmd->keyframe.ic);
+    cmd->keyframe.fc = get_index(fp, cs);
+    cmd->keyframe.fv = get_float_list(fp, cs, &cmd->keyframe.fc);
+});
+
+/*---------------------------------------------------------------------------*/
+
+DEFINE_CMD(CMD_SEEK_INDEX, INDEX_BYTES * (2 + 2 * cmd->seekindex.n), {
+    int i;
+
+    put_index(fp, cs, cmd->seekindex.n);
+
+    for (i = 0; i < cmd->seekindex.n; i++)
+    {
+        put_index(fp, cs, cmd->seekindex.uv[i]);
+        put_index(fp, cs, cmd->seekindex.pv[i]);
+    }
+
+    put_index(fp, cs, cmd->seekindex.pos);
+}, {
+    int *v;
+    int  n;
+    int  i;
+
+    n = get_index(fp, cs);
+    n = CLAMP(0, n, SHRT_MAX / INDEX_BYTES / 2) * 2;
+    v = get_index_list(fp, cs, &n);
+
+    cmd->seekindex.n  = n / 2;
+    cmd->seekindex.uv = NULL;
+    cmd->seekindex.pv = NULL;
+
+    if (v && (cmd->seekindex.uv = malloc(n / 2 * sizeof (int))) &&
+             (cmd->seekindex.pv = malloc(n / 2 * sizeof (int))))
+    {
+        for (i = 0; i < n / 2; i++)
+        {
+            cmd->seekindex.uv[i] = v[i * 2 + 0];
+            cmd->seekindex.pv[i] = v[i * 2 + 1];
+        }
+    }
+    else
+    {
+        free(cmd->seekindex.uv);
+        cmd->seekindex.uv = NULL;
+        cmd->seekindex.n  = 0;
+    }
+
+    free(v);
 
+    cmd->seekindex.pos = get_index(fp, cs);
+});
+
+/*---------------------------------------------------------------------------*/
+
+#define PUT_CASE(t) case t: cmd_put_ ## t(fp, cs, cmd); break
+#define GET_CASE(t) case t: cmd_get_ ## t(fp, cs, cmd); break
+
+static void cmd_put_body(fs_file fp, struct cmd_stream *cs,
+                         const union cmd *cmd)
+{
     switch (cmd->type)
     {
         PUT_CASE(CMD_END_OF_UPDATE);
@@ -415,11 +790,94 @@ int cmd_put(fs_file fp, const union cmd *cmd)
         PUT_CASE(CMD_TILT_AXES);
         PUT_CASE(CMD_MOVE_PATH);
         PUT_CASE(CMD_MOVE_TIME);
+        PUT_CASE(CMD_KEY_FRAME);
+        PUT_CASE(CMD_SEEK_INDEX);
 
     case CMD_NONE:
     case CMD_MAX:
         break;
     }
+}
+
+static void cmd_get_body(fs_file fp, struct cmd_stream *cs, union cmd *cmd)
+{
+    switch (cmd->type)
+    {
+        GET_CASE(CMD_END_OF_UPDATE);
+        GET_CASE(CMD_MAKE_BALL);
+        GET_CASE(CMD_MAKE_ITEM);
+        GET_CASE(CMD_PICK_ITEM);
+        GET_CASE(CMD_TILT_ANGLES);
+        GET_CASE(CMD_SOUND);
+        GET_CASE(CMD_TIMER);
+        GET_CASE(CMD_STATUS);
+        GET_CASE(CMD_COINS);
+        GET_CASE(CMD_JUMP_ENTER);
+        GET_CASE(CMD_JUMP_EXIT);
+        GET_CASE(CMD_BODY_PATH);
+        GET_CASE(CMD_BODY_TIME);
+        GET_CASE(CMD_GOAL_OPEN);
+        GET_CASE(CMD_SWCH_ENTER);
+        GET_CASE(CMD_SWCH_TOGGLE);
+        GET_CASE(CMD_SWCH_EXIT);
+        GET_CASE(CMD_UPDATES_PER_SECOND);
+        GET_CASE(CMD_BALL_RADIUS);
+        GET_CASE(CMD_CLEAR_ITEMS);
+        GET_CASE(CMD_CLEAR_BALLS);
+        GET_CASE(CMD_BALL_POSITION);
+        GET_CASE(CMD_BALL_BASIS);
+        GET_CASE(CMD_BALL_PEND_BASIS);
+        GET_CASE(CMD_VIEW_POSITION);
+        GET_CASE(CMD_VIEW_CENTER);
+        GET_CASE(CMD_VIEW_BASIS);
+        GET_CASE(CMD_CURRENT_BALL);
+        GET_CASE(CMD_PATH_FLAG);
+        GET_CASE(CMD_STEP_SIMULATION);
+        GET_CASE(CMD_MAP);
+        GET_CASE(CMD_TILT_AXES);
+        GET_CASE(CMD_MOVE_PATH);
+        GET_CASE(CMD_MOVE_TIME);
+        GET_CASE(CMD_KEY_FRAME);
+        GET_CASE(CMD_SEEK_INDEX);
+
+    case CMD_NONE:
+    case CMD_MAX:
+        break;
+    }
+}
+
+int cmd_put(fs_file fp, const union cmd *cmd)
+{
+    if (!fp || !cmd)
+        return 0;
+
+    assert(cmd->type > CMD_NONE && cmd->type < CMD_MAX);
+
+    fs_putc(cmd->type, fp);
+
+    cmd_put_body(fp, NULL, cmd);
+
+    return !fs_eof(fp);
+}
+
+/*
+ * Read the rest of a version 9 command of the given type.
+ */
+static int cmd_get_type(fs_file fp, int type, union cmd *cmd)
+{
+    short size = get_short(fp);
+
+    /* Discard unrecognised commands. */
+
+    if (type >= CMD_MAX)
+    {
+        fs_seek(fp, size, SEEK_CUR);
+        type = CMD_NONE;
+    }
+
+    cmd->type = type;
+
+    cmd_get_body(fp, NULL, cmd);
 
     return !fs_eof(fp);
 }
@@ -427,75 +885,155 @@ int cmd_put(fs_file fp, const union cmd *cmd)
 int cmd_get(fs_file fp, union cmd *cmd)
 {
     int type;
-    short size;
 
     if (!fp || !cmd)
         return 0;
 
-    if ((type = fs_getc(fp)) >= 0)
+    if ((type = FS_GETC(fp)) >= 0)
+        return cmd_get_type(fp, type, cmd);
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void put_varint(fs_file fp, unsigned int u)
+{
+    while (u >= 0x80)
     {
-        size = get_short(fp);
+        fs_putc((u & 0x7f) | 0x80, fp);
+        u >>= 7;
+    }
+    fs_putc(u, fp);
+}
 
-        /* Discard unrecognised commands. */
+static unsigned int get_varint(fs_file fp)
+{
+    unsigned int u = 0;
+    int b, n;
 
-        if (type >= CMD_MAX)
-        {
-            fs_seek(fp, size, SEEK_CUR);
-            type = CMD_NONE;
-        }
+    for (n = 0; n < 35; n += 7)
+    {
+        if ((b = FS_GETC(fp)) < 0)
+            break;
 
-        cmd->type = type;
+        u |= (unsigned int) (b & 0x7f) << n;
 
-        switch (cmd->type)
-        {
-            GET_CASE(CMD_END_OF_UPDATE);
-            GET_CASE(CMD_MAKE_BALL);
-            GET_CASE(CMD_MAKE_ITEM);
-            GET_CASE(CMD_PICK_ITEM);
-            GET_CASE(CMD_TILT_ANGLES);
-            GET_CASE(CMD_SOUND);
-            GET_CASE(CMD_TIMER);
-            GET_CASE(CMD_STATUS);
-            GET_CASE(CMD_COINS);
-            GET_CASE(CMD_JUMP_ENTER);
-            GET_CASE(CMD_JUMP_EXIT);
-            GET_CASE(CMD_BODY_PATH);
-            GET_CASE(CMD_BODY_TIME);
-            GET_CASE(CMD_GOAL_OPEN);
-            GET_CASE(CMD_SWCH_ENTER);
-            GET_CASE(CMD_SWCH_TOGGLE);
-            GET_CASE(CMD_SWCH_EXIT);
-            GET_CASE(CMD_UPDATES_PER_SECOND);
-            GET_CASE(CMD_BALL_RADIUS);
-            GET_CASE(CMD_CLEAR_ITEMS);
-            GET_CASE(CMD_CLEAR_BALLS);
-            GET_CASE(CMD_BALL_POSITION);
-            GET_CASE(CMD_BALL_BASIS);
-            GET_CASE(CMD_BALL_PEND_BASIS);
-            GET_CASE(CMD_VIEW_POSITION);
-            GET_CASE(CMD_VIEW_CENTER);
-            GET_CASE(CMD_VIEW_BASIS);
-            GET_CASE(CMD_CURRENT_BALL);
-            GET_CASE(CMD_PATH_FLAG);
-            GET_CASE(CMD_STEP_SIMULATION);
-            GET_CASE(CMD_MAP);
-            GET_CASE(CMD_TILT_AXES);
-            GET_CASE(CMD_MOVE_PATH);
-            GET_CASE(CMD_MOVE_TIME);
-
-        case CMD_NONE:
-        case CMD_MAX:
+        if (!(b & 0x80))
             break;
-        }
+    }
+    return u;
+}
+
+void cmd_stream_init(struct cmd_stream *cs, int version)
+{
+    memset(cs, 0, sizeof (*cs));
+
+    cs->version = version;
+}
+
+/*
+ * Key frames and seek indices are found by file offset and read
+ * without a stream, so they keep the version 9 coding.
+ */
+static int cmd_stream_plain(const struct cmd_stream *cs, int type)
+{
+    return (!cs || cs->version < 10 ||
+            type == CMD_KEY_FRAME ||
+            type == CMD_SEEK_INDEX);
+}
+
+int cmd_put_stream(fs_file fp, struct cmd_stream *cs, const union cmd *cmd)
+{
+    if (!fp || !cmd)
+        return 0;
+
+    if (cs && cmd->type == CMD_KEY_FRAME)
+        memset(&cs->delta, 0, sizeof (cs->delta));
+
+    if (cmd_stream_plain(cs, cmd->type))
+        return cmd_put(fp, cmd);
+
+    assert(cmd->type > CMD_NONE && cmd->type < CMD_MAX);
+
+    cs->type = cmd->type;
+    cs->k    = 0;
+    cs->n    = 0;
+    cs->err  = 0;
+
+    cmd_put_body(fp, cs, cmd);
+
+    if (cs->err)
+        return 0;
+
+    fs_putc(cmd->type, fp);
+    put_varint(fp, cs->n);
+    fs_write(cs->buf, cs->n, fp);
+
+    return !fs_eof(fp);
+}
+
+int cmd_get_stream(fs_file fp, struct cmd_stream *cs, union cmd *cmd)
+{
+    unsigned int size;
+    int type;
+
+    if (!cs || cs->version < 10)
+        return cmd_get(fp, cmd);
+
+    if (!fp || !cmd || (type = FS_GETC(fp)) < 0)
+        return 0;
+
+    if (type == CMD_KEY_FRAME)
+        memset(&cs->delta, 0, sizeof (cs->delta));
 
+    if (cmd_stream_plain(cs, type))
+        return cmd_get_type(fp, type, cmd);
+
+    size = get_varint(fp);
+
+    /* Discard unrecognised commands. */
+
+    if (type == CMD_NONE || type >= CMD_MAX || size > CMD_STREAM_BYTES)
+    {
+        fs_seek(fp, (long) size, SEEK_CUR);
+        cmd->type = CMD_NONE;
         return !fs_eof(fp);
     }
-    return 0;
+
+    cs->type = type;
+    cs->k    = 0;
+    cs->i    = 0;
+    cs->err  = 0;
+
+    /* Decode the body where it lies in the file buffer, if it does. */
+
+    if (FS_BUF(fp)->re - FS_BUF(fp)->rp >= (long) size)
+    {
+        cs->src = FS_BUF(fp)->rp;
+        cs->n   = (int) size;
+
+        FS_BUF(fp)->rp += size;
+    }
+    else
+    {
+        cs->src = cs->buf;
+        cs->n   = fs_read(cs->buf, (int) size, fp);
+    }
+
+    cmd->type = type;
+
+    cmd_get_body(fp, cs, cmd);
+
+    return !fs_eof(fp);
 }
 
 /*---------------------------------------------------------------------------*/
 
-void cmd_free(union cmd *cmd)
+/*
+ * Free the data attached to a command, but not the command itself.
+ */
+void cmd_clear(union cmd *cmd)
 {
     if (cmd)
     {
@@ -503,16 +1041,39 @@ void cmd_free(union cmd *cmd)
         {
         case CMD_SOUND:
             free(cmd->sound.n);
+            cmd->sound.n = NULL;
             break;
 
         case CMD_MAP:
             free(cmd->map.name);
+            cmd->map.name = NULL;
+            break;
+
+        case CMD_KEY_FRAME:
+            free(cmd->keyframe.iv);
+            free(cmd->keyframe.fv);
+            cmd->keyframe.iv = NULL;
+            cmd->keyframe.fv = NULL;
+            break;
+
+        case CMD_SEEK_INDEX:
+            free(cmd->seekindex.uv);
+            free(cmd->seekindex.pv);
+            cmd->seekindex.uv = NULL;
+            cmd->seekindex.pv = NULL;
             break;
 
         default:
             break;
         }
+    }
+}
 
+void cmd_free(union cmd *cmd)
+{
+    if (cmd)
+    {
+        cmd_clear(cmd);
         free(cmd);
     }
 }
@@ -65,6 +65,8 @@ enum cmd_type
     CMD_TILT_AXES,
     CMD_MOVE_PATH,
     CMD_MOVE_TIME,
+    CMD_KEY_FRAME,
+    CMD_SEEK_INDEX,
 
     CMD_MAX
 };
@@ -293,6 +295,33 @@ struct cmd_move_time
     float t;
 };
 
+/*
+ * Full client state as of the end of an update, so that playback can
+ * start from here.  The layout of the values is up to the client.
+ */
+struct cmd_key_frame
+{
+    CMD_HEADER;
+    int    ic;
+    int   *iv;
+    int    fc;
+    float *fv;
+};
+
+/*
+ * Update number and file offset of each key frame.  This is the last
+ * command of a replay and ends with its own offset, so that it can be
+ * found from the end of the file.
+ */
+struct cmd_seek_index
+{
+    CMD_HEADER;
+    int  n;
+    int *uv;
+    int *pv;
+    int  pos;
+};
+
 union cmd
 {
     enum cmd_type type;
@@ -333,6 +362,8 @@ union cmd
     struct cmd_tilt_axes          tiltaxes;
     struct cmd_move_path          movepath;
     struct cmd_move_time          movetime;
+    struct cmd_key_frame          keyframe;
+    struct cmd_seek_index         seekindex;
 };
 
 #undef CMD_HEADER
@@ -342,7 +373,48 @@ union cmd
 int cmd_put(fs_file, const union cmd *);
 int cmd_get(fs_file, union cmd *);
 
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Compact command coding of replay version 10.  Floats are coded
+ * against the one at the same place in the last command of the same
+ * type, so the writer and the reader each keep that state.  Key frames
+ * and seek indices are coded as in version 9 and reset the state.
+ */
+
+#define CMD_DELTA_VALUES 6
+#define CMD_STREAM_BYTES 4096
+
+struct cmd_delta
+{
+    float v[CMD_MAX][CMD_DELTA_VALUES];
+};
+
+struct cmd_stream
+{
+    int version;                        /* Replay version                    */
+
+    struct cmd_delta delta;
+
+    /* Body of the command in progress. */
+
+    enum cmd_type type;
+    int k;                              /* Floats so far                     */
+    int n;                              /* Bytes in the buffer               */
+    int i;                              /* Read position                     */
+    int err;                            /* Body overflowed or ran short      */
+
+    const unsigned char *src;           /* Body being read                   */
+    unsigned char buf[CMD_STREAM_BYTES];
+};
+
+void cmd_stream_init(struct cmd_stream *, int version);
+
+int cmd_put_stream(fs_file, struct cmd_stream *, const union cmd *);
+int cmd_get_stream(fs_file, struct cmd_stream *, union cmd *);
+
 void cmd_free(union cmd *);
+void cmd_clear(union cmd *);
 
 /*---------------------------------------------------------------------------*/
 
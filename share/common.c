@@ -198,6 +198,14 @@ int file_size(const char *path)
     return 0;
 }
 
+long file_mtime(const char *path)
+{
+    struct stat buf;
+    if (stat(path, &buf) == 0)
+        return (long) buf.st_mtime;
+    return 0;
+}
+
 void file_copy(FILE *fin, FILE *fout)
 {
     char   buff[MAXSTR];
@@ -114,6 +114,10 @@ int CONFIG_CHEAT;
 int CONFIG_STATS;
 int CONFIG_SCREENSHOT;
 int CONFIG_LOCK_GOALS;
+int CONFIG_REPLAY_DEFLATE;
+int CONFIG_REPLAY_BUDGET;
+int CONFIG_REPLAY_HISTORY;
+int CONFIG_CACHE_BUDGET;
 int CONFIG_CAMERA_1_SPEED;
 int CONFIG_CAMERA_1_TORQUE;
 int CONFIG_CAMERA_1_FREE_ROTATE;
@@ -244,6 +248,10 @@ static struct
     { &CONFIG_STATS,       "stats",       0 },
     { &CONFIG_SCREENSHOT,  "screenshot",  0 },
     { &CONFIG_LOCK_GOALS,  "lock_goals",  1 },
+    { &CONFIG_REPLAY_DEFLATE, "replay_deflate", 1 },
+    { &CONFIG_REPLAY_BUDGET,  "replay_budget",  4 },
+    { &CONFIG_REPLAY_HISTORY, "replay_history", 2048 },
+    { &CONFIG_CACHE_BUDGET,   "cache_budget",   32768 },
 
     { &CONFIG_CAMERA_1_SPEED,       "camera_1_speed",       250 },
     { &CONFIG_CAMERA_1_TORQUE,      "camera_1_torque",      1 },
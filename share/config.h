@@ -105,6 +105,10 @@ extern int CONFIG_CHEAT;
 extern int CONFIG_STATS;
 extern int CONFIG_SCREENSHOT;
 extern int CONFIG_LOCK_GOALS;
+extern int CONFIG_REPLAY_DEFLATE;
+extern int CONFIG_REPLAY_BUDGET;
+extern int CONFIG_REPLAY_HISTORY;
+extern int CONFIG_CACHE_BUDGET;
 extern int CONFIG_CAMERA_1_SPEED;
 extern int CONFIG_CAMERA_1_TORQUE;
 extern int CONFIG_CAMERA_1_FREE_ROTATE;
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "demo_scan.h"
+#include "solid_world.h"
+#include "binary.h"
+#include "zip.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Read a replay header.  This mirrors demo_header_read, less the date
+ * conversion.
+ */
+int demo_scan_head(fs_file fp, struct demo_head *hp)
+{
+    int magic   = get_index(fp);
+    int version = get_index(fp);
+    int flags;
+
+    memset(hp, 0, sizeof (*hp));
+
+    if (magic != DEMO_MAGIC ||
+        version < DEMO_VERSION_MIN || version > DEMO_VERSION)
+        return 0;
+
+    hp->version = version;
+
+    hp->timer  = get_index(fp);
+    hp->coins  = get_index(fp);
+    hp->status = get_index(fp);
+    hp->mode   = get_index(fp);
+
+    get_string(fp, hp->player, sizeof (hp->player));
+    get_string(fp, hp->date,   sizeof (hp->date));
+    get_string(fp, hp->shot,   sizeof (hp->shot));
+    get_string(fp, hp->file,   sizeof (hp->file));
+
+    hp->time  = get_index(fp);
+    hp->goal  = get_index(fp);
+    flags     = get_index(fp);
+    hp->score = get_index(fp);
+    hp->balls = get_index(fp);
+    hp->times = get_index(fp);
+
+    if (version >= 10)
+        hp->flags = flags;
+
+    return !fs_eof(fp);
+}
+
+/*
+ * Read the rest of a file into a malloc'd buffer.
+ */
+static unsigned char *read_rest(fs_file fp, size_t *n)
+{
+    unsigned char *data = NULL, *p;
+    size_t max = 0;
+    int got;
+
+    *n = 0;
+
+    for (;;)
+    {
+        if (*n == max)
+        {
+            if (!(p = realloc(data, max = max ? max * 2 : 65536)))
+            {
+                free(data);
+                return NULL;
+            }
+            data = p;
+        }
+
+        if ((got = fs_read(data + *n, (int) (max - *n), fp)) <= 0)
+            break;
+
+        *n += got;
+    }
+    return data;
+}
+
+/*
+ * Return a file to read the commands from, positioned at them.  This
+ * is FP itself unless the commands are deflated.  Then FP is closed
+ * and the commands are inflated into memory after a copy of the
+ * header, so that offsets within the replay hold.  On failure, FP is
+ * closed and NULL returned.
+ */
+fs_file demo_scan_body(fs_file fp, int flags)
+{
+    unsigned char *src, *out = NULL, *dst = NULL;
+    size_t n, len = 0;
+    long head;
+    fs_file mp = NULL;
+
+    if (!(flags & DEMO_DEFLATE))
+        return fp;
+
+    if ((head = fs_tell(fp)) > 0 && (src = read_rest(fp, &n)))
+    {
+        out = tinfl_decompress_mem_to_heap(src, n, &len,
+                                           TINFL_FLAG_PARSE_ZLIB_HEADER);
+        free(src);
+    }
+
+    if (out && (dst = malloc(head + len)) &&
+        fs_seek(fp, 0, SEEK_SET) == 0 && fs_read(dst, head, fp) == head)
+    {
+        memcpy(dst + head, out, len);
+
+        if ((mp = fs_open_mem(dst, (int) (head + len))))
+        {
+            fs_seek(mp, head, SEEK_SET);
+            dst = NULL;
+        }
+    }
+
+    free(dst);
+    free(out);
+
+    fs_close(fp);
+
+    return mp;
+}
+
+/*
+ * Run the rest of the replay as fast as it decodes.  The outcome is
+ * what the client would show after the last update.
+ */
+int demo_scan(fs_file fp, int version, struct demo_sum *sp)
+{
+    static struct cmd_stream cs;
+
+    union cmd cmd;
+    float timer = 0.0f;
+
+    memset(sp, 0, sizeof (*sp));
+
+    sp->status = GAME_NONE;
+
+    cmd_stream_init(&cs, version);
+
+    while (cmd_get_stream(fp, &cs, &cmd))
+    {
+        sp->cmds++;
+        sp->count[cmd.type]++;
+
+        switch (cmd.type)
+        {
+        case CMD_END_OF_UPDATE:
+            sp->updates++;
+            break;
+
+        case CMD_UPDATES_PER_SECOND:
+            sp->ups = cmd.ups.n;
+            break;
+
+        case CMD_TIMER:
+            timer = cmd.timer.t;
+            break;
+
+        case CMD_STATUS:
+            sp->status = cmd.status.t;
+            break;
+
+        case CMD_COINS:
+            sp->coins = cmd.coins.n;
+            break;
+
+        default:
+            break;
+        }
+
+        cmd_clear(&cmd);
+    }
+
+    /* This is curr_clock. */
+
+    sp->timer = (int) (timer * 100.f);
+
+    return sp->updates > 0;
+}
+
+/*---------------------------------------------------------------------------*/
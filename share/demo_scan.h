@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef DEMO_SCAN_H
+#define DEMO_SCAN_H
+
+#include "base_config.h"
+#include "cmd.h"
+#include "fs.h"
+
+/*
+ * Decode-only replay reading, for tools.  The command stream is run
+ * through nothing but the game state that the outcome depends on: no
+ * SOL data, no interpolation, no sound and no particles.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+#define DEMO_MAGIC   (0xAF | 'N' << 8 | 'B' << 16 | 'R' << 24)
+#define DEMO_VERSION 10
+
+/*
+ * Version 9 replays are still read.  Version 10 codes commands as
+ * cmd_put_stream does and has header flags in place of the goal
+ * enabled flag that version 9 kept.
+ */
+
+#define DEMO_VERSION_MIN 9
+
+#define DEMO_DEFLATE 1                  /* Commands are a zlib stream        */
+
+struct demo_head
+{
+    int  version;
+    int  flags;
+
+    int  timer;                         /* Centiseconds                      */
+    int  coins;
+    int  status;
+    int  mode;
+
+    char player[MAXSTR];
+    char date[MAXSTR];
+    char shot[PATHMAX];
+    char file[PATHMAX];
+
+    int  time;                          /* Time limit                        */
+    int  goal;                          /* Coin limit                        */
+    int  score;                         /* Total coins                       */
+    int  balls;                         /* Number of balls                   */
+    int  times;                         /* Total time                        */
+};
+
+struct demo_sum
+{
+    int timer;                          /* Clock at the end, centiseconds    */
+    int coins;
+    int status;
+
+    int ups;                            /* Updates per second                */
+    int updates;
+
+    int cmds;
+    int count[CMD_MAX];                 /* Commands of each type             */
+};
+
+int     demo_scan_head(fs_file, struct demo_head *);
+fs_file demo_scan_body(fs_file, int flags);
+int     demo_scan(fs_file, int version, struct demo_sum *);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -30,7 +30,7 @@ int font_load(struct font *ft, const char *path, int sizes[FONT_SIZE_MAX])
     {
         memset(ft, 0, sizeof (*ft));
 
-        if ((ft->data = fs_load(path, &ft->datalen)))
+        if ((ft->data = fs_map(path, &ft->datalen)))
         {
             int i;
 
@@ -63,7 +63,7 @@ void font_free(struct font *ft)
             SDL_RWclose(ft->rwops);
 
         if (ft->data)
-            free(ft->data);
+            fs_unmap(ft->data);
 
         memset(ft, 0, sizeof (*ft));
     }
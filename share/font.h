@@ -23,10 +23,10 @@ struct font
 {
     char path[PATHMAX];
 
-    TTF_Font  *ttf[FONT_SIZE_MAX];
-    SDL_RWops *rwops;
-    void      *data;
-    int        datalen;
+    TTF_Font   *ttf[FONT_SIZE_MAX];
+    SDL_RWops  *rwops;
+    const void *data;
+    int         datalen;
 };
 
 int  font_load(struct font *, const char *path, int sizes[FONT_SIZE_MAX]);
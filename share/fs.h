@@ -3,6 +3,29 @@
 
 typedef struct fs_file_s *fs_file;
 
+/*
+ * Every open file starts with its buffer, so that readers and writers
+ * of small values need not make a call per byte.  Bytes in [rp, re)
+ * have been read ahead and [wp, we) is free space for writing.  When
+ * a range comes up short, fs_read or fs_write refill or drain it.
+ */
+struct fs_buf
+{
+    unsigned char *rp, *re;
+    unsigned char *wp, *we;
+};
+
+#define FS_BUF(fh) ((struct fs_buf *) (fh))
+
+/*
+ * Take, or look at, the next byte, straight from the buffer while it
+ * lasts.  FH is evaluated more than once.
+ */
+#define FS_GETC(fh) (FS_BUF(fh)->rp < FS_BUF(fh)->re ? \
+                     *FS_BUF(fh)->rp++ : fs_getc(fh))
+#define FS_PEEK(fh) (FS_BUF(fh)->rp < FS_BUF(fh)->re ? \
+                     *FS_BUF(fh)->rp   : fs_peek(fh))
+
 int fs_init(const char *argv0);
 int fs_quit(void);
 
@@ -19,9 +42,15 @@ int fs_exists(const char *);
 int fs_remove(const char *);
 int fs_rename(const char *, const char *);
 
+void fs_index_dirty(void);
+
 fs_file fs_open_read(const char *);
 fs_file fs_open_write(const char *);
 fs_file fs_open_append(const char *);
+fs_file fs_open_mem(void *data, int size);
+fs_file fs_open_map(const char *);
+fs_file fs_open_mem_write(int size);
+void   *fs_mem_data(fs_file, int *size);
 int     fs_close(fs_file);
 
 int  fs_read(void *data, int bytes, fs_file);
@@ -30,15 +59,24 @@ int  fs_flush(fs_file);
 long fs_tell(fs_file);
 int  fs_seek(fs_file, long offset, int whence);
 int  fs_eof(fs_file);
+long fs_length(fs_file);
 int  fs_size(const char *);
+long fs_mtime(const char *);
 
 int   fs_getc(fs_file);
+int   fs_peek(fs_file);
 char *fs_gets(char *dst, int count, fs_file fh);
 int   fs_putc(int c, fs_file);
 int   fs_puts(const char *src, fs_file);
 
 void *fs_load(const char *path, int *size);
+
+const void *fs_map(const char *path, int *size);
+void        fs_unmap(const void *data);
 void *fs_load_cache(const char *path, int *size);
+void  fs_cache_release(const void *data);
+void  fs_cache_set_budget(int bytes);
+void  fs_cache_log(void);
 void  fs_cache_quit(void);
 
 int fs_mkdir(const char *);
@@ -25,6 +25,7 @@
 #include "dir.h"
 #include "array.h"
 #include "common.h"
+#include "log.h"
 
 /*
  * This file implements the high-level virtual file system layer
@@ -84,6 +85,9 @@ int fs_rename(const char *src, const char *dst)
 
         free(real_src);
         free(real_dst);
+
+        if (rc == 0)
+            fs_index_dirty();
     }
 
     return rc;
@@ -93,8 +97,12 @@ int fs_rename(const char *src, const char *dst)
 
 int fs_getc(fs_file fh)
 {
+    struct fs_buf *bp = FS_BUF(fh);
     unsigned char c;
 
+    if (bp->rp < bp->re)
+        return *bp->rp++;
+
     if (fs_read(&c, 1, fh) != 1)
         return -1;
 
@@ -103,8 +111,12 @@ int fs_getc(fs_file fh)
 
 int fs_putc(int c, fs_file fh)
 {
+    struct fs_buf *bp = FS_BUF(fh);
     unsigned char b = (unsigned char) c;
 
+    if (bp->wp < bp->we)
+        return *bp->wp++ = b;
+
     if (fs_write(&b, 1, fh) != 1)
         return -1;
 
@@ -120,10 +132,17 @@ int fs_puts(const char *src, fs_file fh)
     return 0;
 }
 
+/*
+ * Read a line, as fgets does, less carriage returns.  Lines are found
+ * in the buffer with memchr and copied out whole.
+ */
 char *fs_gets(char *dst, int count, fs_file fh)
 {
-    char *s = dst;
-    int c;
+    struct fs_buf *bp = FS_BUF(fh);
+
+    char *s = dst, *e = dst + count - 1;
+    const unsigned char *nl;
+    int c, i, j, n;
 
     assert(dst);
     assert(count > 0);
@@ -131,35 +150,49 @@ char *fs_gets(char *dst, int count, fs_file fh)
     if (fs_eof(fh))
         return NULL;
 
-    while (count > 1)
-        if ((c = fs_getc(fh)) >= 0)
+    while (s < e)
+    {
+        if (fs_peek(fh) < 0)
         {
-            count--;
+            if (s == dst)
+                return NULL;
+            break;
+        }
 
-            *s = c;
+        if (bp->rp == bp->re)
+        {
+            /* Without a buffer, a byte at a time. */
 
-            /* Keep a newline and break. */
+            if ((c = fs_getc(fh)) != '\r')
+                *s++ = c;
 
-            if (*s == '\n')
-            {
-                s++;
+            if (c == '\n')
                 break;
-            }
 
-            /* Ignore carriage returns. */
+            continue;
+        }
 
-            if (*s == '\r')
-            {
-                count++;
-                s--;
-            }
+        n = (int) MIN(bp->re - bp->rp, e - s);
 
-            s++;
-        }
-        else if (s == dst)
-            return NULL;
-        else
+        if ((nl = memchr(bp->rp, '\n', n)))
+            n = (int) (nl - bp->rp) + 1;
+
+        memcpy(s, bp->rp, n);
+        bp->rp += n;
+
+        /* Ignore carriage returns. */
+
+        for (i = j = 0; i < n; i++)
+            if (s[i] != '\r')
+                s[j++] = s[i];
+
+        s += j;
+
+        /* Keep a newline and break. */
+
+        if (nl)
             break;
+    }
 
     *s = '\0';
 
@@ -259,99 +292,282 @@ void *fs_load(const char *path, int *datalen)
 
     data = NULL;
 
-    if ((*datalen = fs_size(path)) > 0)
-        if ((fh = fs_open_read(path)))
+    *datalen = 0;
+
+    if ((fh = fs_open_read(path)))
+    {
+        if ((*datalen = (int) fs_length(fh)) > 0 && (data = malloc(*datalen)))
         {
-            if ((data = malloc(*datalen)))
+            if (fs_read(data, *datalen, fh) != *datalen)
             {
-                if (fs_read(data, *datalen, fh) != *datalen)
-                {
-                    free(data);
-                    data = NULL;
-                    *datalen = 0;
-                }
+                free(data);
+                data = NULL;
             }
-
-            fs_close(fh);
         }
 
+        if (!data)
+            *datalen = 0;
+
+        fs_close(fh);
+    }
+
     return data;
 }
+/*
+ * Cache of loaded files, for callers that load the same files over and
+ * over.  Entries are found by hash and kept in order of use, and the
+ * least recently used go first once the cache outgrows its budget.  A
+ * buffer handed out is held until given back with fs_cache_release,
+ * and is not evicted before that.
+ */
+
+#define FS_CACHE_BUDGET (32 * 1024 * 1024)
+
 struct fs_cache_entry
 {
+    struct fs_cache_entry *next;        /* In its bucket                     */
+    struct fs_cache_entry *newer;       /* In order of use                   */
+    struct fs_cache_entry *older;
+
     unsigned char *data;
     int size;
-    char path[64];
+    int refs;
+
+    unsigned int hash;
+    char *path;
 };
 
-static List fs_cache_list = NULL;
+static struct fs_cache_entry **cache_v;
+static int                     cache_n; /* Buckets, a power of two           */
+static int                     cache_c; /* Entries                           */
+
+static struct fs_cache_entry *cache_newest;
+static struct fs_cache_entry *cache_oldest;
+
+static size_t cache_bytes;
+static size_t cache_budget = FS_CACHE_BUDGET;
+
+static int cache_hits;
+static int cache_misses;
+static int cache_evictions;
+
+static unsigned int cache_hash(const char *path)
+{
+    unsigned int h = 2166136261u;
+
+    while (*path)
+        h = (h ^ (unsigned char) *path++) * 16777619u;
+
+    return h;
+}
+
+static void cache_grow(void)
+{
+    struct fs_cache_entry **v, *ent;
+    int i, n = cache_n ? cache_n * 2 : 64;
+
+    if ((v = calloc(n, sizeof (*v))))
+    {
+        for (i = 0; i < cache_n; i++)
+            while ((ent = cache_v[i]))
+            {
+                cache_v[i] = ent->next;
+                ent->next = v[ent->hash & (n - 1)];
+                v[ent->hash & (n - 1)] = ent;
+            }
+
+        free(cache_v);
+
+        cache_v = v;
+        cache_n = n;
+    }
+}
+
+static void cache_unlink(struct fs_cache_entry *ent)
+{
+    if (ent->newer) ent->newer->older = ent->older; else cache_newest = ent->older;
+    if (ent->older) ent->older->newer = ent->newer; else cache_oldest = ent->newer;
+
+    ent->newer = NULL;
+    ent->older = NULL;
+}
+
+static void cache_touch(struct fs_cache_entry *ent)
+{
+    if (cache_newest != ent)
+    {
+        if (ent->newer || ent->older || cache_oldest == ent)
+            cache_unlink(ent);
+
+        ent->older = cache_newest;
+
+        if (cache_newest)
+            cache_newest->newer = ent;
+        else
+            cache_oldest = ent;
+
+        cache_newest = ent;
+    }
+}
+
+static void cache_free(struct fs_cache_entry *ent)
+{
+    struct fs_cache_entry **pp = &cache_v[ent->hash & (cache_n - 1)];
+
+    while (*pp != ent)
+        pp = &(*pp)->next;
+
+    *pp = ent->next;
+
+    cache_unlink(ent);
+
+    cache_bytes -= ent->size;
+    cache_c     -= 1;
+
+    free(ent->data);
+    free(ent->path);
+    free(ent);
+}
 
+/*
+ * Drop the least recently used entries not in use until the cache
+ * fits its budget.
+ */
+static void cache_trim(void)
+{
+    struct fs_cache_entry *ent = cache_oldest, *newer;
+
+    while (ent && cache_bytes > cache_budget)
+    {
+        newer = ent->newer;
+
+        if (ent->refs == 0)
+        {
+            cache_free(ent);
+            cache_evictions++;
+        }
+        ent = newer;
+    }
+}
+
+/*
+ * Load a file through the cache.  The buffer is held until given back
+ * with fs_cache_release.
+ */
 void *fs_load_cache(const char *path, int *size)
 {
-    unsigned char *data = NULL;
-    List l;
+    struct fs_cache_entry *ent;
+    unsigned char *data;
+    unsigned int h;
 
     if (!(path && *path && size))
-        return data;
+        return NULL;
 
-    // Look for cached file data.
+    /* Look for cached file data. */
 
-    for (l = fs_cache_list; l; l = l->next)
-    {
-        struct fs_cache_entry *ent = l->data;
+    h = cache_hash(path);
 
-        if (strcmp(path, ent->path) == 0)
+    for (ent = cache_n ? cache_v[h & (cache_n - 1)] : NULL; ent; ent = ent->next)
+        if (ent->hash == h && strcmp(ent->path, path) == 0)
         {
-            data = ent->data;
+            cache_touch(ent);
+            cache_hits++;
+
+            ent->refs++;
             *size = ent->size;
-            break;
+
+            return ent->data;
         }
-    }
 
-    if (!data)
-    {
-        // Load and cache file data.
+    /* Load and cache file data. */
+
+    cache_misses++;
+
+    if (!(data = fs_load(path, size)))
+        return NULL;
 
-        data = (unsigned char *) fs_load(path, size);
+    if (cache_c >= cache_n)
+        cache_grow();
 
-        if (data)
+    if (cache_n && (ent = calloc(1, sizeof (*ent))))
+    {
+        if ((ent->path = strdup(path)))
         {
-            struct fs_cache_entry *ent = calloc(sizeof (*ent), 1);
+            ent->data = data;
+            ent->size = *size;
+            ent->refs = 1;
+            ent->hash = h;
 
-            if (ent)
-            {
-                ent->data = data;
-                ent->size = *size;
-                SAFECPY(ent->path, path);
+            ent->next = cache_v[h & (cache_n - 1)];
+            cache_v[h & (cache_n - 1)] = ent;
 
-                fs_cache_list = list_cons(ent, fs_cache_list);
-            }
+            cache_touch(ent);
+
+            cache_bytes += ent->size;
+            cache_c     += 1;
+
+            cache_trim();
+
+            return data;
         }
+        free(ent);
     }
 
-    return data;
+    /* Not cached, and not to be given back either. */
+
+    free(data);
+    return NULL;
 }
 
-void fs_cache_quit(void)
+/*
+ * Give back a buffer from fs_load_cache.  Buffers are most often given
+ * back soon after being handed out, so the search starts at the newest.
+ */
+void fs_cache_release(const void *data)
 {
-    while (fs_cache_list)
-    {
-        struct fs_cache_entry *ent = fs_cache_list->data;
+    struct fs_cache_entry *ent;
 
-        if (ent)
+    for (ent = cache_newest; ent; ent = ent->older)
+        if (ent->data == data)
         {
-            if (ent->data)
-            {
-                free(ent->data);
-                ent->data = NULL;
-            }
-
-            free(ent);
-            ent = NULL;
+            if (ent->refs > 0 && --ent->refs == 0)
+                cache_trim();
+            break;
         }
+}
 
-        fs_cache_list = list_rest(fs_cache_list);
-    }
+/*
+ * Set the most the cache keeps in bytes, buffers in use aside.
+ */
+void fs_cache_set_budget(int bytes)
+{
+    cache_budget = (size_t) MAX(bytes, 0);
+    cache_trim();
+}
+
+void fs_cache_log(void)
+{
+    if (cache_hits || cache_misses)
+        log_printf("FS: cache %d hits, %d misses, %d evictions, "
+                   "%d files in %d KiB\n", cache_hits, cache_misses,
+                   cache_evictions, cache_c, (int) (cache_bytes / 1024));
+}
+
+void fs_cache_quit(void)
+{
+    fs_cache_log();
+
+    while (cache_newest)
+        cache_free(cache_newest);
+
+    free(cache_v);
+
+    cache_v = NULL;
+    cache_n = 0;
+
+    cache_hits      = 0;
+    cache_misses    = 0;
+    cache_evictions = 0;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -17,6 +17,16 @@
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FS_MMAP 1
+#endif
 
 #include "fs.h"
 #include "dir.h"
@@ -39,13 +49,29 @@ enum fs_path_type
     FS_PATH_ZIP,
 };
 
+#define FS_BUF_SIZE 8192
+
+/*
+ * A stdio handle reads ahead into, or writes behind from, its own
+ * buffer.  A small zip entry is inflated whole, so its buffer is the
+ * entry and the read position is just buf.rp.  So is a file in memory,
+ * and so is a mapped file.  A large zip entry is inflated a window at
+ * a time into the buffer of its stream.
+ */
 struct fs_file_s
 {
+    struct fs_buf buf;                  /* Must come first, see fs.h         */
+
     FILE *handle;
+    unsigned char *handle_buf;
+    int handle_eof;                     /* A read came up short              */
+    int handle_write;                   /* Opened for writing                */
 
     void *zip_file_data;
-    size_t zip_file_pos;
     size_t zip_file_size;
+    int zip_file_map;                   /* Data is from fs_map               */
+
+    struct zip_stream *zip_stream;
 
     enum fs_path_type path_type;
 };
@@ -96,6 +122,279 @@ static char *fs_dir_write;
 static List  fs_path;
 static int   fs_logging = 1;
 
+static void map_quit(void);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Path index.  Finding a path otherwise takes a walk of the mounts,
+ * with a call per directory and, for an archive, a search of its entry
+ * names.  The index maps each virtual path to where it is found first
+ * instead.  Directories are listed into it as paths in them are asked
+ * about, and archives whole, the first time.
+ *
+ * Mounting and unmounting start the index over, and so do writes.  A
+ * write may come from another thread, so it only raises a flag, and the
+ * index itself is used from the main thread alone.
+ *
+ * Like the archive reader, the index takes archive entry names without
+ * regard to case.
+ */
+
+struct index_entry
+{
+    struct index_entry *next;
+
+    struct fs_path_item *mount;         /* NULL marks a listed directory     */
+    int rank;                           /* Position of the mount, 0 first    */
+    int entry;                          /* Archive entry, or -1              */
+    int size;                           /* -1 until asked for                */
+    long mtime;
+
+    unsigned int hash;
+    char path[];
+};
+
+static struct index_entry **index_v;
+static unsigned int         index_n;    /* Buckets, a power of two           */
+static unsigned int         index_c;    /* Entries                           */
+static int                  index_zips; /* Archives are in                   */
+
+static volatile sig_atomic_t index_stale;
+
+static int lower(int c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static unsigned int index_hash(const char *path)
+{
+    unsigned int h = 2166136261u;
+
+    while (*path)
+        h = (h ^ (unsigned char) lower(*path++)) * 16777619u;
+
+    return h;
+}
+
+static int index_match(const struct index_entry *e, const char *path)
+{
+    const char *p = e->path;
+
+    if (e->entry < 0)
+        return strcmp(p, path) == 0;
+
+    while (*p && lower(*p) == lower(*path))
+        p++, path++;
+
+    return *p == *path;
+}
+
+static void index_clear(void)
+{
+    struct index_entry *e;
+    unsigned int i;
+
+    for (i = 0; i < index_n; i++)
+        while ((e = index_v[i]))
+        {
+            index_v[i] = e->next;
+            free(e);
+        }
+
+    index_c     = 0;
+    index_zips  = 0;
+    index_stale = 0;
+}
+
+static void index_grow(void)
+{
+    struct index_entry **v, *e;
+    unsigned int i, n = index_n ? index_n * 2 : 1024;
+
+    if ((v = calloc(n, sizeof (*v))))
+    {
+        for (i = 0; i < index_n; i++)
+            while ((e = index_v[i]))
+            {
+                index_v[i] = e->next;
+                e->next = v[e->hash & (n - 1)];
+                v[e->hash & (n - 1)] = e;
+            }
+
+        free(index_v);
+
+        index_v = v;
+        index_n = n;
+    }
+}
+
+/*
+ * Add DIR/NAME to the index.
+ */
+static struct index_entry *index_add(const char *dir, const char *name,
+                                     struct fs_path_item *mount, int rank,
+                                     int entry, int size)
+{
+    struct index_entry *e;
+    size_t d = strlen(dir), n = strlen(name);
+
+    if (index_c >= index_n)
+        index_grow();
+
+    if (!index_n || !(e = malloc(sizeof (*e) + d + n + 2)))
+        return NULL;
+
+    memcpy(e->path, dir, d);
+
+    if (d)
+        e->path[d++] = '/';
+
+    memcpy(e->path + d, name, n + 1);
+
+    e->mount = mount;
+    e->rank  = rank;
+    e->entry = entry;
+    e->size  = size;
+    e->mtime = 0;
+    e->hash  = index_hash(e->path);
+
+    e->next = index_v[e->hash & (index_n - 1)];
+    index_v[e->hash & (index_n - 1)] = e;
+
+    index_c++;
+
+    return e;
+}
+
+static void index_zip_all(void)
+{
+    mz_zip_archive_file_stat st;
+    unsigned int i, n;
+    int rank;
+    List p;
+
+    for (rank = 0, p = fs_path; p; p = p->next, rank++)
+    {
+        struct fs_path_item *path_item = p->data;
+
+        if (path_item->type == FS_PATH_ZIP)
+        {
+            mz_zip_archive *zip = path_item->data;
+
+            n = mz_zip_reader_get_num_files(zip);
+
+            for (i = 0; i < n; i++)
+                if (mz_zip_reader_file_stat(zip, i, &st) && !st.m_is_directory)
+                    index_add("", st.m_filename, path_item, rank,
+                              (int) i, (int) st.m_uncomp_size);
+        }
+    }
+    index_zips = 1;
+}
+
+static void index_list(const char *dir)
+{
+    List files, l, p;
+    int rank;
+
+    for (rank = 0, p = fs_path; p; p = p->next, rank++)
+    {
+        struct fs_path_item *path_item = p->data;
+
+        if (path_item->type == FS_PATH_DIRECTORY)
+        {
+            char *real = path_join(path_item->path, dir);
+
+            if (real)
+            {
+                files = dir_list_files(real);
+
+                for (l = files; l; l = l->next)
+                    index_add(dir, l->data, path_item, rank, -1, -1);
+
+                dir_list_free(files);
+                free(real);
+            }
+        }
+    }
+
+    /* Remember that it has been. */
+
+    index_add("", dir, NULL, 0, -1, -1);
+}
+
+/*
+ * Find where a path is found first, if it is found at all.
+ */
+static struct index_entry *index_get(const char *path)
+{
+    struct index_entry *e, *best = NULL;
+    const char *sep;
+    char dir[MAXSTR];
+    unsigned int h;
+
+    if (index_stale)
+        index_clear();
+
+    if (!index_zips)
+        index_zip_all();
+
+    /* List the directory of the path, if not yet. */
+
+    if ((sep = path_last_sep(path)))
+    {
+        size_t n = MIN((size_t) (sep - path), sizeof (dir) - 1);
+
+        memcpy(dir, path, n);
+        dir[n] = 0;
+    }
+    else dir[0] = 0;
+
+    h = index_hash(dir);
+
+    for (e = index_n ? index_v[h & (index_n - 1)] : NULL; e; e = e->next)
+        if (!e->mount && e->hash == h && strcmp(e->path, dir) == 0)
+            break;
+
+    if (!e)
+        index_list(dir);
+
+    /* Find the path in the first mount that has it. */
+
+    h = index_hash(path);
+
+    for (e = index_n ? index_v[h & (index_n - 1)] : NULL; e; e = e->next)
+        if (e->mount && e->hash == h && index_match(e, path))
+            if (!best || e->rank < best->rank)
+                best = e;
+
+    return best;
+}
+
+/*
+ * Stat a path from a directory, once.
+ */
+static void index_stat(struct index_entry *e)
+{
+    char *real;
+
+    if (e->size < 0 && (real = path_join(e->mount->path, e->path)))
+    {
+        e->size  = file_size(real);
+        e->mtime = file_mtime(real);
+        free(real);
+    }
+}
+
+/*
+ * Note a write, from any thread.
+ */
+void fs_index_dirty(void)
+{
+    index_stale = 1;
+}
+
 int fs_init(const char *argv0)
 {
     fs_dir_base  = strdup(argv0 && *argv0 ? dir_name(argv0) : ".");
@@ -138,6 +437,13 @@ int fs_quit(void)
         fs_path = list_rest(fs_path);
     }
 
+    map_quit();
+    index_clear();
+
+    free(index_v);
+    index_v = NULL;
+    index_n = 0;
+
     fs_cache_quit();
 
     return 1;
@@ -187,6 +493,7 @@ int fs_add_path(const char *path)
         path_item->data = NULL;
 
         fs_path = list_cons(path_item, fs_path);
+        index_clear();
 
         return 1;
     }
@@ -208,6 +515,7 @@ int fs_add_path(const char *path)
                 path_item->data = zip;
 
                 fs_path = list_cons(path_item, fs_path);
+                index_clear();
 
                 return 1;
             }
@@ -247,16 +555,15 @@ void fs_remove_path(const char *path)
             path_item = NULL;
             l->data = NULL;
 
+            /* Paths are unique, see fs_add_path. */
+
             if (p)
-            {
                 p->next = list_rest(l);
-                l = p;
-            }
             else
-            {
                 fs_path = list_rest(l);
-                l = fs_path;
-            }
+
+            index_clear();
+            break;
         }
     }
 }
@@ -342,39 +649,73 @@ static void zip_list_free(List files)
  *
  * String data is assumed to be heap-allocated.
  */
-static void insert_strings_into_list(List *items, List strings)
+
+static int cmp_cells(const void *A, const void *B)
 {
-    List str;
+    const List *a = A, *b = B;
+    return strcmp((*a)->data, (*b)->data);
+}
+
+/*
+ * Insert a string at or after P, unless it is there already.  Returns
+ * where to look for the next, greater, string.
+ */
+static List *insert_string(List *p, List str)
+{
+    List l;
+    int cmp = 1;
+
+    /* "Inspired" by PhysicsFS file enumeration code. */
+
+    while (*p && (cmp = strcmp((*p)->data, str->data)) < 0)
+        p = &(*p)->next;
 
-    for (str = strings; str; str = str->next)
+    if (*p && cmp == 0)
+        return p;
+
+    if ((l = list_cons(str->data, *p)))
     {
-        int skip = 0;
-        List p, l;
+        *p = l;
+        p  = &l->next;
 
-        /* "Inspired" by PhysicsFS file enumeration code. */
+        /* We will free the string data ourselves. */
 
-        for (p = NULL, l = *items; l; p = l, l = l->next)
-        {
-            int cmp;
+        str->data = NULL;
+    }
+    return p;
+}
 
-            if ((cmp = strcmp(l->data, str->data)) >= 0)
-            {
-                skip = (cmp == 0);
-                break;
-            }
-        }
+static void insert_strings_into_list(List *items, List strings)
+{
+    List str, *v, *p;
+    int i, n;
 
-        if (!skip)
-        {
-            if (p)
-                p->next = list_cons(str->data, p->next);
-            else
-                *items = list_cons(str->data, *items);
+    for (n = 0, str = strings; str; str = str->next)
+        n++;
 
-            /* We will free the string data ourselves. */
+    if (n == 0)
+        return;
 
-            str->data = NULL;
-        }
+    /* Sorted first, the strings merge in a single pass. */
+
+    if ((v = malloc(n * sizeof (*v))))
+    {
+        for (i = 0, str = strings; str; str = str->next)
+            v[i++] = str;
+
+        qsort(v, n, sizeof (*v), cmp_cells);
+
+        for (p = items, i = 0; i < n; i++)
+            p = insert_string(p, v[i]);
+
+        free(v);
+    }
+    else
+    {
+        /* Otherwise, each is looked for from the top. */
+
+        for (str = strings; str; str = str->next)
+            insert_string(items, str);
     }
 }
 
@@ -436,6 +777,10 @@ static void free_files(List files)
  */
 Array fs_dir_scan(const char *path, int (*filter)(struct dir_item *))
 {
+    /* A scan is where files put there from outside show up. */
+
+    index_clear();
+
     return dir_scan(path, filter, list_files, free_files);
 }
 
@@ -449,91 +794,609 @@ void fs_dir_free(Array items)
 
 /*---------------------------------------------------------------------------*/
 
-fs_file fs_open_read(const char *path)
-{
-    fs_file fh;
+/*
+ * Zip entries larger than this are inflated a window at a time instead
+ * of whole, so that a long song costs no more memory than a short one.
+ */
+#define ZIP_WHOLE_MAX (64 * 1024)
 
-    if ((fh = calloc(1, sizeof (*fh))))
-    {
-        int opened = 0;
-        List p;
+/*
+ * Bytes inflated between checkpoints.  A checkpoint is a copy of the
+ * inflator taken on the way through an entry, from which a seek back
+ * starts over instead of from the top of the entry.
+ */
+#define ZIP_CHECK_STEP (256 * 1024)
 
-        for (p = fs_path; p && !opened; p = p->next)
-        {
-            struct fs_path_item *path_item = p->data;
+struct zip_check
+{
+    mz_zip_reader_extract_iter_state state;
 
-            if (path_item->type == FS_PATH_DIRECTORY)
-            {
-                char *real = path_join(path_item->path, path);
+    unsigned char *dict;                /* The inflator's window             */
+    unsigned char *in;                  /* Input read but not yet inflated   */
+};
 
-                if ((fh->handle = fopen(real, "rb")))
-                {
-                    fh->path_type = FS_PATH_DIRECTORY;
-                    opened = 1;
-                }
+/*
+ * Archives are read from files, see fs_add_path, so the extractor has
+ * buffers of its own for both input and output.  Stored entries are
+ * taken as they are, which makes any seek in them a jump.
+ *
+ * A stream may be read off the main thread, as music is by the audio
+ * callback, while the main thread extracts from the same archive.  So
+ * each stream opens the archive anew, with a FILE of its own.
+ */
+struct zip_stream
+{
+    mz_zip_archive zip;
+    mz_uint index;
+    int stored;
 
-                free(real);
-            }
-            else if (path_item->type == FS_PATH_ZIP)
-            {
-                mz_zip_archive *zip = path_item->data;
+    mz_zip_reader_extract_iter_state *iter;
 
-                fh->zip_file_data = mz_zip_reader_extract_file_to_heap(zip, path, &fh->zip_file_size, 0);
+    mz_uint64 data_ofs;                 /* Archive offset of the entry data  */
+    long pos;                           /* Bytes taken from the extractor    */
+    long size;
 
-                if (fh->zip_file_data)
-                {
-                    fh->zip_file_pos = 0;
-                    fh->path_type = FS_PATH_ZIP;
-                    opened = 1;
-                }
-            }
-        }
+    struct zip_check *check;
+    long check_next;                    /* Where to take the next one        */
 
-        if (!opened)
-        {
-            free(fh);
-            fh = NULL;
-        }
-    }
-    return fh;
+    unsigned char win[FS_BUF_SIZE];
+};
+
+static mz_zip_reader_extract_iter_state *zip_iter_new(struct zip_stream *zs)
+{
+    return mz_zip_reader_extract_iter_new(&zs->zip, zs->index, zs->stored ?
+                                          MZ_ZIP_FLAG_COMPRESSED_DATA : 0);
 }
 
-static fs_file fs_open_write_flags(const char *path, int append)
+static struct zip_stream *zip_stream_open(const char *archive,
+                                          const mz_zip_archive_file_stat *st)
 {
-    fs_file fh = NULL;
+    struct zip_stream *zs;
 
-    if (fs_dir_write && path && *path)
+    if ((zs = calloc(1, sizeof (*zs))))
     {
-        if ((fh = calloc(1, sizeof (*fh))))
+        mz_zip_zero_struct(&zs->zip);
+
+        /* Entries are found by index, the same as in the shared one. */
+
+        if (!mz_zip_reader_init_file(&zs->zip, archive,
+                                     MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY))
         {
-            char *real;
+            free(zs);
+            return NULL;
+        }
 
-            if ((real = path_join(fs_dir_write, path)))
-            {
-                fh->handle = fopen(real, append ? "ab" : "wb");
-                fh->path_type = FS_PATH_DIRECTORY;
-                free(real);
-            }
+        zs->index  = st->m_file_index;
+        zs->stored = (st->m_method == 0);
+        zs->size   = (long) st->m_uncomp_size;
 
-            if (!fh->handle)
-            {
-                free(fh);
-                fh = NULL;
-            }
+        zs->check_next = ZIP_CHECK_STEP;
+
+        if ((zs->iter = zip_iter_new(zs)))
+        {
+            zs->data_ofs = zs->iter->cur_file_ofs;
+            return zs;
         }
+        mz_zip_reader_end(&zs->zip);
+        free(zs);
     }
-    return fh;
+    return NULL;
 }
 
-fs_file fs_open_write(const char *path)
+static void zip_stream_close(struct zip_stream *zs)
 {
-    return fs_open_write_flags(path, 0);
+    if (zs->iter)
+        mz_zip_reader_extract_iter_free(zs->iter);
+
+    if (zs->check)
+    {
+        free(zs->check->dict);
+        free(zs->check->in);
+        free(zs->check);
+    }
+    mz_zip_reader_end(&zs->zip);
+    free(zs);
 }
 
-fs_file fs_open_append(const char *path)
+static void zip_check_save(struct zip_stream *zs)
 {
-    return fs_open_write_flags(path, 1);
-}
+    mz_zip_reader_extract_iter_state *it = zs->iter;
+    struct zip_check *cp;
+
+    if (!(cp = zs->check))
+    {
+        if (!(cp = calloc(1, sizeof (*cp))))
+            return;
+
+        cp->dict = malloc(TINFL_LZ_DICT_SIZE);
+        cp->in   = malloc((size_t) it->read_buf_size);
+
+        if (!cp->dict || !cp->in)
+        {
+            free(cp->dict);
+            free(cp->in);
+            free(cp);
+            return;
+        }
+        zs->check = cp;
+    }
+
+    cp->state = *it;
+
+    memcpy(cp->dict, it->pWrite_buf, TINFL_LZ_DICT_SIZE);
+    memcpy(cp->in, (unsigned char *) it->pRead_buf + it->read_buf_ofs,
+           (size_t) it->read_buf_avail);
+}
+
+static void zip_check_load(struct zip_stream *zs)
+{
+    mz_zip_reader_extract_iter_state *it = zs->iter;
+
+    void *in   = it->pRead_buf;
+    void *dict = it->pWrite_buf;
+
+    *it = zs->check->state;
+
+    it->pRead_buf    = in;
+    it->pWrite_buf   = dict;
+    it->read_buf_ofs = 0;
+
+    memcpy(dict, zs->check->dict, TINFL_LZ_DICT_SIZE);
+    memcpy(in,   zs->check->in,   (size_t) it->read_buf_avail);
+
+    zs->pos        = (long) it->out_buf_ofs;
+    zs->check_next = zs->pos + ZIP_CHECK_STEP;
+}
+
+/*
+ * Inflate up to N bytes of the entry into DST.
+ */
+static int zip_stream_read(struct zip_stream *zs, unsigned char *dst, int n)
+{
+    int got;
+
+    if (!zs->iter || n <= 0)
+        return 0;
+
+    got = (int) mz_zip_reader_extract_iter_read(zs->iter, dst, n);
+
+    zs->pos += got;
+
+    if (!zs->stored && zs->pos >= zs->check_next && zs->pos < zs->size)
+    {
+        zip_check_save(zs);
+        zs->check_next = zs->pos + ZIP_CHECK_STEP;
+    }
+    return got;
+}
+
+/*
+ * Go back to, or to just before, entry offset TO.
+ */
+static int zip_stream_rewind(struct zip_stream *zs, long to)
+{
+    mz_zip_reader_extract_iter_state *it = zs->iter;
+
+    if (zs->stored && it)
+    {
+        it->cur_file_ofs   = zs->data_ofs + to;
+        it->out_buf_ofs    = to;
+        it->comp_remaining = it->file_stat.m_comp_size - to;
+
+        zs->pos = to;
+        return 1;
+    }
+
+    if (it && zs->check && (long) zs->check->state.out_buf_ofs <= to)
+    {
+        zip_check_load(zs);
+        return 1;
+    }
+
+    /* Start over. */
+
+    if (it)
+        mz_zip_reader_extract_iter_free(it);
+
+    zs->iter       = zip_iter_new(zs);
+    zs->pos        = 0;
+    zs->check_next = ZIP_CHECK_STEP;
+
+    return zs->iter != NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+fs_file fs_open_read(const char *path)
+{
+    fs_file fh;
+
+    if ((fh = calloc(1, sizeof (*fh))))
+    {
+        int opened = 0;
+        List p;
+
+        for (p = fs_path; p && !opened; p = p->next)
+        {
+            struct fs_path_item *path_item = p->data;
+
+            if (path_item->type == FS_PATH_DIRECTORY)
+            {
+                char *real = path_join(path_item->path, path);
+
+                if ((fh->handle = fopen(real, "rb")))
+                {
+                    /* Without a buffer, reads go straight to stdio. */
+
+                    if ((fh->handle_buf = malloc(FS_BUF_SIZE)))
+                    {
+                        fh->buf.rp = fh->handle_buf;
+                        fh->buf.re = fh->handle_buf;
+                    }
+
+                    fh->path_type = FS_PATH_DIRECTORY;
+                    opened = 1;
+                }
+
+                free(real);
+            }
+            else if (path_item->type == FS_PATH_ZIP)
+            {
+                mz_zip_archive *zip = path_item->data;
+                mz_zip_archive_file_stat st;
+                int i;
+
+                if ((i = mz_zip_reader_locate_file(zip, path, NULL, 0)) < 0 ||
+                    !mz_zip_reader_file_stat(zip, i, &st))
+                    continue;
+
+                if (st.m_uncomp_size > ZIP_WHOLE_MAX)
+                {
+                    if ((fh->zip_stream = zip_stream_open(path_item->path, &st)))
+                    {
+                        fh->buf.rp = fh->zip_stream->win;
+                        fh->buf.re = fh->zip_stream->win;
+                        fh->path_type = FS_PATH_ZIP;
+                        opened = 1;
+                    }
+                }
+                else if ((fh->zip_file_data = mz_zip_reader_extract_to_heap(zip, i, &fh->zip_file_size, 0)))
+                {
+                    fh->buf.rp = fh->zip_file_data;
+                    fh->buf.re = fh->buf.rp + fh->zip_file_size;
+                    fh->path_type = FS_PATH_ZIP;
+                    opened = 1;
+                }
+            }
+        }
+
+        if (!opened)
+        {
+            free(fh);
+            fh = NULL;
+        }
+    }
+    return fh;
+}
+
+/*
+ * Read from a malloc'd buffer as from a file, which frees it on close.
+ */
+fs_file fs_open_mem(void *data, int size)
+{
+    fs_file fh;
+
+    if (data && (fh = calloc(1, sizeof (*fh))))
+    {
+        fh->zip_file_data = data;
+        fh->zip_file_size = size;
+
+        fh->buf.rp = data;
+        fh->buf.re = fh->buf.rp + size;
+
+        fh->path_type = FS_PATH_ZIP;
+
+        return fh;
+    }
+    return NULL;
+}
+
+/*
+ * Map a file from a directory into memory.
+ */
+static int map_file(const char *real, void **data, size_t *size)
+{
+#ifdef FS_MMAP
+    struct stat st;
+    void *p = MAP_FAILED;
+    int fd;
+
+    if ((fd = open(real, O_RDONLY)) >= 0)
+    {
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        close(fd);
+
+        if (p != MAP_FAILED)
+        {
+            *data = p;
+            *size = (size_t) st.st_size;
+            return 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+static void unmap_file(void *data, size_t size)
+{
+#ifdef FS_MMAP
+    munmap(data, size);
+#endif
+}
+
+/*
+ * Mappings handed out by fs_map, and how each is to be let go of.
+ */
+enum
+{
+    MAP_MMAP,                           /* Mapped from a directory           */
+    MAP_CACHE,                          /* Inflated into the file cache      */
+    MAP_HEAP                            /* Read into memory                  */
+};
+
+struct fs_map_item
+{
+    const void *data;
+    size_t size;
+    int kind;
+};
+
+static List fs_maps;
+
+static const void *map_add(void *data, size_t size, int kind, int *out)
+{
+    struct fs_map_item *mi;
+    List l;
+
+    if ((mi = malloc(sizeof (*mi))))
+    {
+        mi->data = data;
+        mi->size = size;
+        mi->kind = kind;
+
+        if ((l = list_cons(mi, fs_maps)))
+        {
+            fs_maps = l;
+
+            if (out)
+                *out = (int) size;
+
+            return data;
+        }
+        free(mi);
+    }
+
+    if      (kind == MAP_MMAP)  unmap_file(data, size);
+    else if (kind == MAP_CACHE) fs_cache_release(data);
+    else                        free(data);
+
+    return NULL;
+}
+
+/*
+ * Return the whole of a file, read-only, without copying it where that
+ * can be helped.  A file from a directory is mapped, so that its pages
+ * are read in as they are touched and shared with any other process
+ * that maps it.  A zip entry is inflated into the file cache once and
+ * handed out from there.  Anything else is read into memory.
+ */
+const void *fs_map(const char *path, int *size)
+{
+    void *data;
+    size_t n;
+    int len;
+    List p;
+
+    for (p = fs_path; p; p = p->next)
+    {
+        struct fs_path_item *path_item = p->data;
+
+        if (path_item->type == FS_PATH_DIRECTORY)
+        {
+            char *real = path_join(path_item->path, path);
+            int found = 0;
+
+            if (real)
+            {
+                if (map_file(real, &data, &n))
+                {
+                    free(real);
+                    return map_add(data, n, MAP_MMAP, size);
+                }
+                found = file_exists(real);
+                free(real);
+            }
+
+            /* Empty or unmappable: read it. */
+
+            if (found)
+                break;
+        }
+        else if (path_item->type == FS_PATH_ZIP)
+        {
+            mz_zip_archive *zip = path_item->data;
+
+            if (mz_zip_reader_locate_file(zip, path, NULL, 0) >= 0)
+            {
+                if ((data = fs_load_cache(path, &len)))
+                    return map_add(data, len, MAP_CACHE, size);
+                return NULL;
+            }
+        }
+    }
+
+    if ((data = fs_load(path, &len)))
+        return map_add(data, len, MAP_HEAP, size);
+
+    return NULL;
+}
+
+void fs_unmap(const void *data)
+{
+    struct fs_map_item *mi;
+    List l, p;
+
+    for (p = NULL, l = fs_maps; l; p = l, l = l->next)
+    {
+        mi = l->data;
+
+        if (mi->data == data)
+        {
+            if      (mi->kind == MAP_MMAP)  unmap_file((void *) data, mi->size);
+            else if (mi->kind == MAP_CACHE) fs_cache_release(data);
+            else                            free((void *) data);
+
+            free(mi);
+
+            if (p)
+                p->next = list_rest(l);
+            else
+                fs_maps = list_rest(l);
+
+            break;
+        }
+    }
+}
+
+static void map_quit(void)
+{
+    while (fs_maps)
+        fs_unmap(((struct fs_map_item *) fs_maps->data)->data);
+}
+
+/*
+ * Open a file to be read through whole, such as a replay or a level,
+ * from where fs_map puts it.  Reads are then served with no calls at
+ * all.  Where the file can not be had whole, it is opened as by
+ * fs_open_read.
+ */
+fs_file fs_open_map(const char *path)
+{
+    const void *data;
+    fs_file fh;
+    int size;
+
+    if ((data = fs_map(path, &size)))
+    {
+        if ((fh = calloc(1, sizeof (*fh))))
+        {
+            fh->zip_file_data = (void *) data;
+            fh->zip_file_size = size;
+            fh->zip_file_map  = 1;
+
+            fh->buf.rp = (unsigned char *) data;
+            fh->buf.re = fh->buf.rp + size;
+
+            fh->path_type = FS_PATH_ZIP;
+
+            return fh;
+        }
+        fs_unmap(data);
+        return NULL;
+    }
+    return fs_open_read(path);
+}
+
+/*
+ * Write to a buffer in memory that grows as needed.  fs_mem_data gives
+ * what has been written, up to the write position.
+ */
+fs_file fs_open_mem_write(int size)
+{
+    fs_file fh;
+
+    if ((fh = calloc(1, sizeof (*fh))))
+    {
+        size = MAX(size, 256);
+
+        if ((fh->zip_file_data = malloc(size)))
+        {
+            fh->zip_file_size = size;
+
+            fh->buf.rp = fh->zip_file_data;
+            fh->buf.re = fh->zip_file_data;
+            fh->buf.wp = fh->zip_file_data;
+            fh->buf.we = fh->buf.wp + size;
+
+            fh->path_type = FS_PATH_ZIP;
+
+            return fh;
+        }
+        free(fh);
+    }
+    return NULL;
+}
+
+void *fs_mem_data(fs_file fh, int *size)
+{
+    struct fs_buf *bp = &fh->buf;
+
+    if (fh->handle || !fh->zip_file_data)
+        return NULL;
+
+    *size = (int) ((bp->we ? bp->wp : bp->re) - (unsigned char *) fh->zip_file_data);
+
+    return fh->zip_file_data;
+}
+
+static fs_file fs_open_write_flags(const char *path, int append)
+{
+    fs_file fh = NULL;
+
+    if (fs_dir_write && path && *path)
+    {
+        if ((fh = calloc(1, sizeof (*fh))))
+        {
+            char *real;
+
+            if ((real = path_join(fs_dir_write, path)))
+            {
+                fh->handle = fopen(real, append ? "ab" : "wb");
+                fh->handle_write = 1;
+                fh->path_type = FS_PATH_DIRECTORY;
+                free(real);
+            }
+
+            if (fh->handle && (fh->handle_buf = malloc(FS_BUF_SIZE)))
+            {
+                fh->buf.wp = fh->handle_buf;
+                fh->buf.we = fh->handle_buf + FS_BUF_SIZE;
+            }
+
+            if (!fh->handle)
+            {
+                free(fh);
+                fh = NULL;
+            }
+            else fs_index_dirty();
+        }
+    }
+    return fh;
+}
+
+fs_file fs_open_write(const char *path)
+{
+    return fs_open_write_flags(path, 0);
+}
+
+fs_file fs_open_append(const char *path)
+{
+    return fs_open_write_flags(path, 1);
+}
+
+static int fs_drain(fs_file);
 
 int fs_close(fs_file fh)
 {
@@ -543,21 +1406,43 @@ int fs_close(fs_file fh)
     {
         if (fh->handle)
         {
-            if (fclose(fh->handle))
+            /* Closed means all that was written is in the file. */
+
+            int drained = fs_drain(fh);
+
+            if (fclose(fh->handle) == 0 && drained)
                 closed = 1;
+
+            /* Size and time are known only now. */
+
+            if (fh->handle_write)
+                fs_index_dirty();
+
+            free(fh->handle_buf);
+            fh->handle_buf = NULL;
         }
 
         if (fh->zip_file_data)
         {
-            free(fh->zip_file_data);
+            if (fh->zip_file_map)
+                fs_unmap(fh->zip_file_data);
+            else
+                free(fh->zip_file_data);
 
             fh->zip_file_data = NULL;
-            fh->zip_file_pos = 0;
             fh->zip_file_size = 0;
 
             closed = 1;
         }
 
+        if (fh->zip_stream)
+        {
+            zip_stream_close(fh->zip_stream);
+            fh->zip_stream = NULL;
+
+            closed = 1;
+        }
+
         free(fh);
     }
 
@@ -578,6 +1463,9 @@ int fs_mkdir(const char *path)
         char *real = path_join(fs_dir_write, path);
         success = dir_make(real) == 0;
         free((void *) real);
+
+        if (success)
+            fs_index_dirty();
     }
 
     return success;
@@ -585,14 +1473,7 @@ int fs_mkdir(const char *path)
 
 int fs_exists(const char *path)
 {
-    fs_file fh;
-
-    if ((fh = fs_open_read(path)))
-    {
-        fs_close(fh);
-        return 1;
-    }
-    return 0;
+    return index_get(path) != NULL;
 }
 
 int fs_remove(const char *path)
@@ -604,6 +1485,9 @@ int fs_remove(const char *path)
         char *real = path_join(fs_dir_write, path);
         success = (remove(real) == 0);
         free(real);
+
+        if (success)
+            fs_index_dirty();
     }
 
     return success;
@@ -611,30 +1495,189 @@ int fs_remove(const char *path)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Write out what the buffer holds.
+ */
+static int fs_drain(fs_file fh)
+{
+    struct fs_buf *bp = &fh->buf;
+    size_t n;
+
+    if (!bp->we || bp->wp == fh->handle_buf)
+        return 1;
+
+    n = bp->wp - fh->handle_buf;
+
+    bp->wp = fh->handle_buf;
+
+    return fwrite(fh->handle_buf, 1, n, fh->handle) == n;
+}
+
 int fs_read(void *data, int bytes, fs_file fh)
 {
-    if (fh->handle)
-        return fread(data, 1, bytes, fh->handle);
+    struct fs_buf *bp = &fh->buf;
+    unsigned char *dst = data;
+    int n, got;
 
-    if (fh->zip_file_data)
+    /* Take what is buffered first. */
+
+    got = MIN(bytes, (int) (bp->re - bp->rp));
+
+    if (got > 0)
     {
-        size_t left = fh->zip_file_size - fh->zip_file_pos;
-        size_t read = MIN(left, bytes);
+        memcpy(dst, bp->rp, got);
+        bp->rp += got;
+    }
 
-        memcpy(data, ((unsigned char *) fh->zip_file_data) + fh->zip_file_pos, read);
+    if (got < bytes && fh->handle)
+    {
+        /* Large reads skip the buffer. */
 
-        fh->zip_file_pos += read;
+        if (!fh->handle_buf || bytes - got >= FS_BUF_SIZE)
+            got += fread(dst + got, 1, bytes - got, fh->handle);
+
+        else if ((n = fread(fh->handle_buf, 1, FS_BUF_SIZE, fh->handle)) > 0)
+        {
+            bp->rp = fh->handle_buf;
+            bp->re = fh->handle_buf + n;
+
+            n = MIN(bytes - got, n);
+
+            memcpy(dst + got, bp->rp, n);
+            bp->rp += n;
+            got    += n;
+        }
 
-        return read;
     }
+    else if (got < bytes && fh->zip_stream)
+    {
+        struct zip_stream *zs = fh->zip_stream;
 
-    return 0;
+        /* Same for an entry being inflated. */
+
+        if (bytes - got >= FS_BUF_SIZE)
+            got += zip_stream_read(zs, dst + got, bytes - got);
+
+        else if ((n = zip_stream_read(zs, zs->win, FS_BUF_SIZE)) > 0)
+        {
+            bp->rp = zs->win;
+            bp->re = zs->win + n;
+
+            n = MIN(bytes - got, n);
+
+            memcpy(dst + got, bp->rp, n);
+            bp->rp += n;
+            got    += n;
+        }
+    }
+
+    if (got < bytes)
+        fh->handle_eof = 1;
+
+    return got;
+}
+
+/*
+ * Refill an empty read buffer.  Returns how many bytes it then holds.
+ */
+static int fs_fill(fs_file fh)
+{
+    struct fs_buf *bp = &fh->buf;
+    int n = 0;
+
+    if (bp->rp < bp->re)
+        return (int) (bp->re - bp->rp);
+
+    if (fh->handle && fh->handle_buf && !bp->we)
+    {
+        if ((n = fread(fh->handle_buf, 1, FS_BUF_SIZE, fh->handle)) > 0)
+        {
+            bp->rp = fh->handle_buf;
+            bp->re = fh->handle_buf + n;
+        }
+    }
+    else if (fh->zip_stream)
+    {
+        struct zip_stream *zs = fh->zip_stream;
+
+        if ((n = zip_stream_read(zs, zs->win, FS_BUF_SIZE)) > 0)
+        {
+            bp->rp = zs->win;
+            bp->re = zs->win + n;
+        }
+    }
+    return MAX(n, 0);
+}
+
+/*
+ * Return the next byte without taking it.  Unless the file is at its
+ * end, the byte is then in the buffer, or the handle has no buffer.
+ */
+int fs_peek(fs_file fh)
+{
+    int c;
+
+    if (fs_fill(fh) > 0)
+        return *fh->buf.rp;
+
+    if (fh->handle && !fh->handle_buf && (c = getc(fh->handle)) != EOF)
+        return ungetc(c, fh->handle);
+
+    fh->handle_eof = 1;
+
+    return -1;
 }
 
 int fs_write(const void *data, int bytes, fs_file fh)
 {
+    struct fs_buf *bp = &fh->buf;
+
     if (fh->handle)
+    {
+        if (bp->we)
+        {
+            if (bytes > bp->we - bp->wp && !fs_drain(fh))
+                return 0;
+
+            if (bytes <= bp->we - bp->wp)
+            {
+                memcpy(bp->wp, data, bytes);
+                bp->wp += bytes;
+                return bytes;
+            }
+        }
         return fwrite(data, 1, bytes, fh->handle);
+    }
+
+    if (fh->zip_file_data && bp->we)
+    {
+        unsigned char *old = fh->zip_file_data, *p;
+
+        size_t pos = bp->wp - old;
+        size_t max = fh->zip_file_size;
+
+        if (bytes > bp->we - bp->wp)
+        {
+            while (max < pos + bytes)
+                max *= 2;
+
+            if (!(p = realloc(old, max)))
+                return 0;
+
+            fh->zip_file_data = p;
+            fh->zip_file_size = max;
+
+            bp->rp = p;
+            bp->re = p;
+            bp->wp = p + pos;
+            bp->we = p + max;
+        }
+
+        memcpy(bp->wp, data, bytes);
+        bp->wp += bytes;
+
+        return bytes;
+    }
 
     /* ZIP writing is not available. */
 
@@ -644,7 +1687,7 @@ int fs_write(const void *data, int bytes, fs_file fh)
 int fs_flush(fs_file fh)
 {
     if (fh->handle)
-        return fflush(fh->handle);
+        return fs_drain(fh) ? fflush(fh->handle) : EOF;
 
     /* ZIP writing is not available. */
 
@@ -653,26 +1696,75 @@ int fs_flush(fs_file fh)
 
 long fs_tell(fs_file fh)
 {
+    struct fs_buf *bp = &fh->buf;
+
     if (fh->handle)
-        return ftell(fh->handle);
+    {
+        long pos = ftell(fh->handle);
+
+        if (pos >= 0 && bp->we)
+            pos += bp->wp - fh->handle_buf;
+        else if (pos >= 0)
+            pos -= bp->re - bp->rp;
+
+        return pos;
+    }
 
     if (fh->zip_file_data)
-        return fh->zip_file_pos;
+        return (bp->we ? bp->wp : bp->rp) - (unsigned char *) fh->zip_file_data;
+
+    if (fh->zip_stream)
+        return fh->zip_stream->pos - (bp->re - bp->rp);
 
     return -1;
 }
 
 int fs_seek(fs_file fh, long offset, int whence)
 {
+    struct fs_buf *bp = &fh->buf;
+
     if (fh->handle)
+    {
+        /* The handle is ahead of a reader by what is buffered. */
+
+        if (whence == SEEK_CUR)
+            offset -= (bp->re - bp->rp);
+
+        if (!fs_drain(fh))
+            return -1;
+
+        bp->rp = bp->re;
+        fh->handle_eof = 0;
+
         return fseek(fh->handle, offset, whence);
+    }
+
+    if (fh->zip_file_data && bp->we)
+    {
+        /* A file in memory ends where it is being written. */
+
+        unsigned char *data = fh->zip_file_data;
+
+        long pos = bp->wp - data;
+
+        if (whence == SEEK_SET)
+            pos = offset;
+        else
+            pos = pos + offset;
+
+        bp->wp = data + CLAMP(0, pos, (long) fh->zip_file_size);
+
+        return 0;
+    }
 
     if (fh->zip_file_data)
     {
-        size_t pos = fh->zip_file_pos;
+        unsigned char *data = fh->zip_file_data;
+
+        size_t pos = bp->rp - data;
 
         if (whence == SEEK_CUR) {
-            pos = fh->zip_file_pos + offset;
+            pos = pos + offset;
         } else if (whence == SEEK_SET) {
             pos = offset;
         } else if (whence == SEEK_END) {
@@ -681,11 +1773,61 @@ int fs_seek(fs_file fh, long offset, int whence)
 
         pos = CLAMP(0, pos, fh->zip_file_size);
 
-        fh->zip_file_pos = pos;
+        bp->rp = data + pos;
+        fh->handle_eof = 0;
 
         return 0;
     }
 
+    if (fh->zip_stream)
+    {
+        /*
+         * Within the window, only the read position moves.  Otherwise,
+         * the entry is inflated up to the new position, from where it
+         * is or from where it can be restarted.
+         */
+
+        struct zip_stream *zs = fh->zip_stream;
+
+        long pos = zs->pos - (bp->re - bp->rp);
+        int n;
+
+        if (whence == SEEK_CUR) {
+            pos = pos + offset;
+        } else if (whence == SEEK_SET) {
+            pos = offset;
+        } else if (whence == SEEK_END) {
+            pos = zs->size + offset;
+        }
+
+        pos = CLAMP(0, pos, zs->size);
+
+        fh->handle_eof = 0;
+
+        if (pos <= zs->pos && pos >= zs->pos - (bp->re - zs->win))
+        {
+            bp->rp = bp->re - (zs->pos - pos);
+            return 0;
+        }
+
+        bp->rp = zs->win;
+        bp->re = zs->win;
+
+        if (pos < zs->pos && !zip_stream_rewind(zs, pos))
+            return -1;
+
+        if (zs->stored && pos > zs->pos)
+            zip_stream_rewind(zs, pos);
+
+        while (zs->pos < pos && (n = zip_stream_read(zs, zs->win, FS_BUF_SIZE)) > 0)
+        {
+            bp->re = zs->win + n;
+            bp->rp = bp->re - MAX(zs->pos - pos, 0);
+        }
+
+        return zs->pos >= pos ? 0 : -1;
+    }
+
     return -1;
 }
 
@@ -695,60 +1837,77 @@ int fs_eof(fs_file fh)
      * Unlike PhysicsFS, stdio does not register EOF unless we have
      * actually attempted to read past the end of the file.  Nothing
      * is done to mitigate this: instead, code that relies on
-     * PhysicsFS behavior should be fixed not to.
+     * PhysicsFS behavior should be fixed not to.  Zip entries and
+     * files in memory follow stdio.
      */
     if (fh->handle)
-        return feof(fh->handle);
+        return fh->buf.rp == fh->buf.re && fh->handle_eof;
 
-
-    if (fh->zip_file_data)
-        return fh->zip_file_pos >= fh->zip_file_size;
+    if (fh->zip_file_data || fh->zip_stream)
+        return fh->buf.rp >= fh->buf.re && fh->handle_eof;
 
     return 1;
 }
 
 int fs_size(const char *path)
 {
-    List p;
+    struct index_entry *e;
 
-    for (p = fs_path; p; p = p->next)
+    if ((e = index_get(path)))
     {
-        struct fs_path_item *path_item = p->data;
+        if (e->entry < 0)
+            index_stat(e);
 
-        if (path_item->type == FS_PATH_DIRECTORY)
-        {
-            char *real = path_join(path_item->path, path);
+        return MAX(e->size, 0);
+    }
+    return 0;
+}
 
-            if (real)
-            {
-                if (file_exists(real))
-                {
-                    int s = file_size(real);
-                    free(real);
-                    real = NULL;
-                    return s;
-                }
+/*
+ * Return the modification time of a file, or 0 if it is not known.
+ * Zip entries carry none.
+ */
+long fs_mtime(const char *path)
+{
+    struct index_entry *e;
 
-                free(real);
-                real = NULL;
-            }
-        }
-        else if (path_item->type == FS_PATH_ZIP)
-        {
-            mz_zip_archive *zip = path_item->data;
-            int file_index = mz_zip_reader_locate_file(zip, path, NULL, 0);
+    if ((e = index_get(path)) && e->entry < 0)
+    {
+        index_stat(e);
+        return e->mtime;
+    }
+    return 0;
+}
 
-            if (file_index >= 0)
-            {
-                mz_zip_archive_file_stat file_stat;
+/*
+ * Return the length of a file open for reading.  Unlike fs_size, this
+ * is safe off the main thread.
+ */
+long fs_length(fs_file fh)
+{
+    struct fs_buf *bp = &fh->buf;
 
-                if (mz_zip_reader_file_stat(zip, file_index, &file_stat))
-                    return file_stat.m_uncomp_size;
-            }
+    if (fh->handle)
+    {
+        long pos = ftell(fh->handle), len = -1;
+
+        if (pos >= 0 && !bp->we && fseek(fh->handle, 0, SEEK_END) == 0)
+        {
+            len = ftell(fh->handle);
+
+            if (fseek(fh->handle, pos, SEEK_SET) != 0)
+                len = -1;
         }
+        return len;
     }
 
-    return 0;
+    if (fh->zip_file_data)
+        return (bp->we ? bp->wp : bp->re) - (unsigned char *) fh->zip_file_data;
+
+    if (fh->zip_stream)
+        return fh->zip_stream->size;
+
+    return -1;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*
+ * Text reading benchmark.  Reads the lists and maps of a data directory
+ * line by line, the way the game's text parsers do, and splits lines
+ * into tokens.  Each file is read once with fs_gets and once a byte at
+ * a time with fs_getc, as fs_gets used to, and the two are checked to
+ * see the same text.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "array.h"
+#include "common.h"
+#include "dir.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+static int opt_passes = 20;
+
+static const char *opt_data = CONFIG_DATA;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Read a line a byte at a time.  This is fs_gets as it was.
+ */
+static char *gets_bytes(char *dst, int count, fs_file fh)
+{
+    char *s = dst;
+    int c;
+
+    if (fs_eof(fh))
+        return NULL;
+
+    while (count > 1)
+        if ((c = fs_getc(fh)) >= 0)
+        {
+            count--;
+
+            *s = c;
+
+            if (*s == '\n')
+            {
+                s++;
+                break;
+            }
+
+            if (*s == '\r')
+            {
+                count++;
+                s--;
+            }
+
+            s++;
+        }
+        else if (s == dst)
+            return NULL;
+        else
+            break;
+
+    *s = '\0';
+
+    return dst;
+}
+
+/*
+ * What a parse of a file sees, to check one reader against the other.
+ */
+struct sum
+{
+    int lines;
+    int tokens;
+    unsigned int hash;
+};
+
+static void parse(const char *path, struct sum *sp,
+                  char *(*gets)(char *, int, fs_file))
+{
+    char line[MAXSTR], *p;
+    fs_file fp;
+
+    if ((fp = fs_open_read(path)))
+    {
+        while (gets(line, sizeof (line), fp))
+        {
+            sp->lines++;
+
+            for (p = line; *p; p++)
+                sp->hash = (sp->hash ^ (unsigned char) *p) * 16777619u;
+
+            for (p = strtok(line, " \t\n"); p; p = strtok(NULL, " \t\n"))
+                sp->tokens++;
+        }
+        fs_close(fp);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int is_text(struct dir_item *item)
+{
+    return (str_ends_with(item->path, ".txt") ||
+            str_ends_with(item->path, ".map"));
+}
+
+static int cmp_items(const void *A, const void *B)
+{
+    const struct dir_item *a = A, *b = B;
+    return strcmp(a->path, b->path);
+}
+
+/*
+ * List the text files of the data: the lists at the top, and the maps
+ * one directory down.
+ */
+static void list_files(Array paths, const char *dir)
+{
+    Array items;
+    int i;
+
+    if ((items = fs_dir_scan(dir, is_text)))
+    {
+        array_sort(items, cmp_items);
+
+        for (i = 0; i < array_len(items); i++)
+        {
+            char **pp;
+
+            if ((pp = array_add(paths)))
+                *pp = strdup(DIR_ITEM_GET(items, i)->path);
+        }
+        fs_dir_free(items);
+    }
+}
+
+static int is_dir(struct dir_item *item)
+{
+    return str_starts_with(item->path, "map-");
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    Array paths, dirs;
+
+    struct sum a, b;
+    double ta, tb, da, db, t0;
+    long bytes = 0;
+    int argi, i, j, fail = 0;
+
+    if (!fs_init(argc > 0 ? argv[0] : NULL))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n", fs_error());
+        return 1;
+    }
+
+    fs_set_logging(0);
+
+    for (argi = 1; argi < argc; ++argi)
+    {
+        if      (strcmp(argv[argi], "--data")   == 0 && argi + 1 < argc)
+            opt_data = argv[++argi];
+        else if (strcmp(argv[argi], "--passes") == 0 && argi + 1 < argc)
+        {
+            opt_passes = atoi(argv[++argi]);
+            opt_passes = MAX(1, opt_passes);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--data <dir>] [--passes <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    fs_add_path_with_archives(opt_data);
+
+    if (!(paths = array_new(sizeof (char *))))
+        return 1;
+
+    list_files(paths, "");
+
+    if ((dirs = fs_dir_scan("", is_dir)))
+    {
+        array_sort(dirs, cmp_items);
+
+        for (i = 0; i < array_len(dirs); i++)
+            list_files(paths, DIR_ITEM_GET(dirs, i)->path);
+
+        fs_dir_free(dirs);
+    }
+
+    printf("file\tlines\ttokens\tbytes_ms\tgets_ms\n");
+
+    ta = tb = 0.0;
+
+    for (i = 0; i < array_len(paths); i++)
+    {
+        const char *path = *(char **) array_get(paths, i);
+
+        memset(&a, 0, sizeof (a));
+        memset(&b, 0, sizeof (b));
+
+        t0 = now();
+        for (j = 0; j < opt_passes; j++)
+            parse(path, &a, gets_bytes);
+        da = now() - t0;
+
+        t0 = now();
+        for (j = 0; j < opt_passes; j++)
+            parse(path, &b, fs_gets);
+        db = now() - t0;
+
+        ta += da;
+        tb += db;
+
+        if (a.lines != b.lines || a.tokens != b.tokens || a.hash != b.hash)
+        {
+            fprintf(stderr, "%s: readers disagree\n", path);
+            fail++;
+        }
+
+        printf("%s\t%d\t%d\t%.3f\t%.3f\n", path,
+               b.lines / opt_passes, b.tokens / opt_passes,
+               1000.0 * da / opt_passes, 1000.0 * db / opt_passes);
+
+        bytes += fs_size(path);
+    }
+
+    fprintf(stderr, "%d files, %ld bytes, %d passes: "
+            "a byte at a time %.1f MB/s, by line %.1f MB/s, %.2fx\n",
+            array_len(paths), bytes, opt_passes,
+            ta > 0.0 ? bytes * opt_passes / ta / 1.0e6 : 0.0,
+            tb > 0.0 ? bytes * opt_passes / tb / 1.0e6 : 0.0,
+            tb > 0.0 ? ta / tb : 0.0);
+
+    for (i = 0; i < array_len(paths); i++)
+        free(*(char **) array_get(paths, i));
+
+    array_free(paths);
+    fs_quit();
+
+    return fail ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -2886,6 +2886,66 @@ static int test_lump_side(const struct s_base *fp,
     return 0;
 }
 
+/*
+ * Grow bounding sphere A to enclose bounding sphere B.  A negative
+ * radius denotes an empty sphere.
+ */
+static void sphere_merge(float a[4], const float b[4])
+{
+    float d[3], l, r;
+
+    if (b[3] < 0)
+        return;
+
+    v_sub(d, b, a);
+    l = v_len(d);
+
+    if (a[3] < 0 || l + a[3] <= b[3])
+    {
+        a[0] = b[0];
+        a[1] = b[1];
+        a[2] = b[2];
+        a[3] = b[3];
+    }
+    else if (l + b[3] > a[3])
+    {
+        r = (l + a[3] + b[3]) / 2;
+
+        v_mad(a, a, d, (r - a[3]) / l);
+        a[3] = r;
+    }
+}
+
+/*
+ * Compute the bounding sphere of a node from its own lumps and those
+ * of its children.
+ */
+static void node_bounds(struct s_base *fp, struct b_node *np, float bsphere[][4])
+{
+    float s[4] = { 0.0f, 0.0f, 0.0f, -1.0f };
+    int i;
+
+    for (i = 0; i < np->lc; i++)
+        sphere_merge(s, bsphere[np->l0 + i]);
+
+    if (np->ni >= 0)
+    {
+        struct b_node *nq = fp->nv + np->ni;
+        float t[4] = { nq->c[0], nq->c[1], nq->c[2], nq->r };
+        sphere_merge(s, t);
+    }
+
+    if (np->nj >= 0)
+    {
+        struct b_node *nq = fp->nv + np->nj;
+        float t[4] = { nq->c[0], nq->c[1], nq->c[2], nq->r };
+        sphere_merge(s, t);
+    }
+
+    v_cpy(np->c, s);
+    np->r = s[3];
+}
+
 static int node_node(struct mapc_context *ctx, int l0, int lc, float bsphere[][4])
 {
     struct s_base *fp = &ctx->file;
@@ -2900,6 +2960,8 @@ static int node_node(struct mapc_context *ctx, int l0, int lc, float bsphere[][4
         fp->nv[fp->nc].l0 = l0;
         fp->nv[fp->nc].lc = lc;
 
+        node_bounds(fp, fp->nv + fp->nc, bsphere);
+
         return incn(ctx);
     }
     else
@@ -3014,6 +3076,8 @@ static int node_node(struct mapc_context *ctx, int l0, int lc, float bsphere[][4
         fp->nv[i].l0 = lj;
         fp->nv[i].lc = ljc;
 
+        node_bounds(fp, fp->nv + i, bsphere);
+
         return i;
     }
 }
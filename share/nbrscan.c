@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*
+ * Decode-only replay reader.  Runs each given replay as fast as it
+ * decodes and reports the outcome the client would show at the end,
+ * with command counts.  No SDL, no GL, no level data.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "array.h"
+#include "common.h"
+#include "dir.h"
+#include "fs.h"
+
+#include "demo_scan.h"
+
+/*---------------------------------------------------------------------------*/
+
+static int opt_counts = 0;
+
+static int fail;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void scan_file(const char *path)
+{
+    char dir[MAXSTR];
+    char name[PATHMAX];
+
+    struct demo_head head;
+    struct demo_sum  sum;
+
+    fs_file fp;
+    double t0, t1;
+    int i;
+
+    SAFECPY(dir,  dir_name(path));
+    SAFECPY(name, base_name(path));
+
+    fs_add_path(dir);
+
+    if ((fp = fs_open_map(name)))
+    {
+        t0 = now();
+
+        if (demo_scan_head(fp, &head) &&
+            (fp = demo_scan_body(fp, head.flags)) &&
+            demo_scan(fp, head.version, &sum))
+        {
+            t1 = now();
+
+            printf("%s\t%s\t%d\t%.2f\t%d\t%d\t%d\t%d\t%.0f",
+                   name, head.file, sum.updates,
+                   sum.ups > 0 ? (double) sum.updates / sum.ups : 0.0,
+                   sum.status, sum.coins, sum.timer, sum.cmds,
+                   (t1 - t0) * 1.0e+6);
+
+            if (opt_counts)
+            {
+                char sep = '\t';
+
+                for (i = 0; i < CMD_MAX; i++)
+                    if (sum.count[i])
+                    {
+                        printf("%c%d:%d", sep, i, sum.count[i]);
+                        sep = ',';
+                    }
+            }
+            printf("\n");
+        }
+        else
+        {
+            fprintf(stderr, "%s: unreadable replay\n", path);
+            fail++;
+        }
+
+        if (fp)
+            fs_close(fp);
+    }
+    else
+    {
+        fprintf(stderr, "%s: %s\n", path, fs_error());
+        fail++;
+    }
+
+    fs_remove_path(dir);
+}
+
+static int is_replay(struct dir_item *item)
+{
+    return str_ends_with(item->path, ".nbr");
+}
+
+static int cmp_items(const void *A, const void *B)
+{
+    const struct dir_item *a = A, *b = B;
+    return strcmp(a->path, b->path);
+}
+
+static void scan_path(const char *path)
+{
+    int i;
+
+    if (dir_exists(path))
+    {
+        Array items;
+
+        if ((items = dir_scan(path, is_replay, NULL, NULL)))
+        {
+            array_sort(items, cmp_items);
+
+            for (i = 0; i < array_len(items); i++)
+                scan_path(DIR_ITEM_GET(items, i)->path);
+
+            dir_free(items);
+        }
+        return;
+    }
+    scan_file(path);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int argi;
+
+    if (!fs_init(argc > 0 ? argv[0] : NULL))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n", fs_error());
+        return 1;
+    }
+
+    fs_set_logging(0);
+
+    for (argi = 1; argi < argc; ++argi)
+    {
+        if (strcmp(argv[argi], "--counts") == 0)
+            opt_counts = 1;
+        else if (argv[argi][0] == '-')
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+            return 1;
+        }
+        else break;
+    }
+
+    if (argi == argc)
+    {
+        fprintf(stderr, "Usage: %s [--counts] <replay|dir>...\n", argv[0]);
+        return 1;
+    }
+
+    printf("replay\tlevel\tupdates\tseconds\tstatus\tcoins\ttimer\t"
+           "commands\tdecode_us%s\n", opt_counts ? "\tcounts" : "");
+
+    for (; argi < argc; argi++)
+        scan_path(argv[argi]);
+
+    fs_quit();
+
+    return fail ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*
+ * Replay verifier.  Re-simulates each given replay from its recorded
+ * tilt alone, with the game rules of the server, and checks the outcome
+ * against the header.  The header is also checked against the recorded
+ * command stream, which is what the client would show.  No SDL, no GL.
+ *
+ * Replays are read and their worlds made on the main thread, a batch
+ * at a time, and only the stepping is spread across a pool of workers.
+ *
+ * Verdicts:
+ *
+ *   ok          the simulation ends as the header says
+ *   header      the header does not match the recorded commands
+ *   drift       the simulation does not end as the header says
+ *   unreadable  the replay or its level cannot be loaded
+ *
+ * The simulation is that of this build.  Replays recorded by builds
+ * with other physics or other floating point code drift without having
+ * been touched, so drift is reported but does not fail the run.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vec3.h"
+#include "array.h"
+#include "list.h"
+#include "common.h"
+#include "dir.h"
+#include "fs.h"
+
+#include "solid_base.h"
+#include "solid_pack.h"
+#include "solid_world.h"
+#include "pool.h"
+#include "demo_scan.h"
+
+/*---------------------------------------------------------------------------*/
+
+static int opt_threads = 0;
+
+static const char *opt_data = CONFIG_DATA;
+
+static struct pool *pool;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Levels, loaded once for all the replays of a run, with their packed
+ * geometry.  Worlds only read these, so one serves any number of them
+ * at once.
+ */
+struct level
+{
+    char file[PATHMAX];
+    struct s_base base;
+    struct s_pack pack;
+    int ok;
+    int packed;
+};
+
+static List levels;
+
+static struct level *level_get(const char *file)
+{
+    struct level *lp;
+    List l;
+
+    for (l = levels; l; l = l->next)
+    {
+        lp = l->data;
+
+        if (strcmp(lp->file, file) == 0)
+            return lp->ok ? lp : NULL;
+    }
+
+    if ((lp = calloc(1, sizeof (*lp))))
+    {
+        SAFECPY(lp->file, file);
+
+        if ((lp->ok = sol_load_base(&lp->base, file)))
+            lp->packed = sol_load_pack(&lp->pack, &lp->base);
+
+        levels = list_cons(lp, levels);
+
+        return lp->ok ? lp : NULL;
+    }
+    return NULL;
+}
+
+static void level_free(void)
+{
+    struct level *lp;
+
+    while (levels)
+    {
+        lp = levels->data;
+
+        if (lp->packed)
+            sol_free_pack(&lp->pack);
+        if (lp->ok)
+            sol_free_base(&lp->base);
+
+        free(lp);
+
+        levels = list_rest(levels);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The header and the simulation keep the time taken, while the recorded
+ * commands keep the clock, which counts down on timed levels.  All are
+ * compared as time taken.
+ */
+struct outcome
+{
+    int status;
+    int coins;
+    int timer;                          /* Time taken, centiseconds          */
+};
+
+enum
+{
+    VERDICT_OK,
+    VERDICT_HEADER,
+    VERDICT_DRIFT,
+    VERDICT_UNREADABLE,
+
+    VERDICT_MAX
+};
+
+static const char *verdicts[VERDICT_MAX] = {
+    "ok",
+    "header",
+    "drift",
+    "unreadable"
+};
+
+struct job
+{
+    char path[MAXSTR];
+    char file[PATHMAX];
+
+    struct level   *level;
+    struct w_script script;
+    struct s_world  world;
+
+    struct outcome head;                /* Outcome in the header             */
+    struct outcome scan;                /* Outcome of the recorded commands  */
+    struct outcome sim;                 /* Outcome as re-simulated           */
+
+    int verdict;
+};
+
+/*
+ * Compare outcomes.  Times are truncated from different clocks and may
+ * be a centisecond apart.
+ */
+static int outcome_cmp(const struct outcome *a, const struct outcome *b)
+{
+    return (a->status != b->status ||
+            a->coins  != b->coins  ||
+            abs(a->timer - b->timer) > 1);
+}
+
+/*
+ * Read a replay and its level and make its world.  This is done on the
+ * main thread, as the file system is not to be used from more than one
+ * and the worlds of a batch are better made and freed in one place.
+ */
+static int job_load(struct job *jp)
+{
+    char dir[MAXSTR];
+    char name[PATHMAX];
+
+    struct demo_head head;
+    struct demo_sum  sum;
+
+    fs_file fp;
+    long pos;
+    int rc = 0;
+
+    SAFECPY(dir,  dir_name(jp->path));
+    SAFECPY(name, base_name(jp->path));
+
+    fs_add_path(dir);
+
+    if ((fp = fs_open_map(name)))
+    {
+        if (demo_scan_head(fp, &head) &&
+            (fp = demo_scan_body(fp, head.flags)) &&
+            (pos = fs_tell(fp)) >= 0 &&
+            demo_scan(fp, head.version, &sum) &&
+            fs_seek(fp, pos, SEEK_SET) == 0 &&
+            (jp->level = level_get(head.file)) &&
+            world_script_read(&jp->script, fp, head.version) &&
+            world_init(&jp->world, &jp->level->base,
+                       jp->level->packed ? &jp->level->pack : NULL, NULL,
+                       head.time / 100.0f, jp->script.goal_e))
+        {
+            SAFECPY(jp->file, head.file);
+
+            jp->head.status = head.status;
+            jp->head.coins  = head.coins;
+            jp->head.timer  = head.timer;
+
+            jp->scan.status = sum.status;
+            jp->scan.coins  = sum.coins;
+            jp->scan.timer  = head.time ? head.time - sum.timer : sum.timer;
+
+            rc = 1;
+        }
+
+        if (fp)
+            fs_close(fp);
+    }
+
+    fs_remove_path(dir);
+
+    return rc;
+}
+
+/*
+ * Run a replay through its world.  This is what the workers do.
+ */
+static void job_run(void *data, int i)
+{
+    struct job     *jp = (struct job *) data + i;
+    struct s_world *wp = &jp->world;
+    int j;
+
+    if (jp->verdict == VERDICT_UNREADABLE)
+        return;
+
+    for (j = 0; j < jp->script.ic; j++)
+    {
+        if (jp->script.iv[j].goal)
+            world_goal(wp);
+
+        world_step(wp, &jp->script.iv[j].tilt, jp->script.dt);
+    }
+
+    jp->sim.status = wp->status;
+    jp->sim.coins  = wp->coins;
+    jp->sim.timer  = world_timer(wp);
+
+    if (outcome_cmp(&jp->head, &jp->scan))
+        jp->verdict = VERDICT_HEADER;
+    else if (outcome_cmp(&jp->head, &jp->sim))
+        jp->verdict = VERDICT_DRIFT;
+    else
+        jp->verdict = VERDICT_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int is_replay(struct dir_item *item)
+{
+    return str_ends_with(item->path, ".nbr");
+}
+
+static int cmp_items(const void *A, const void *B)
+{
+    const struct dir_item *a = A, *b = B;
+    return strcmp(a->path, b->path);
+}
+
+/*
+ * List the replays to verify, in directories recursively.
+ */
+static void list_path(Array paths, const char *path)
+{
+    char *p;
+    int i;
+
+    if (dir_exists(path))
+    {
+        Array items;
+
+        if ((items = dir_scan(path, is_replay, NULL, NULL)))
+        {
+            array_sort(items, cmp_items);
+
+            for (i = 0; i < array_len(items); i++)
+                list_path(paths, DIR_ITEM_GET(items, i)->path);
+
+            dir_free(items);
+        }
+        return;
+    }
+
+    if ((p = strdup(path)))
+    {
+        char **pp;
+
+        if ((pp = array_add(paths)))
+            *pp = p;
+        else
+            free(p);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int    count[VERDICT_MAX];
+static double steps;
+static double seconds;                  /* Replay time simulated             */
+
+static void job_out(const struct job *jp)
+{
+    printf("%s\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%s\n",
+           base_name(jp->path), jp->file,
+           jp->head.status, jp->head.coins, jp->head.timer,
+           jp->sim.status,  jp->sim.coins,  jp->sim.timer,
+           verdicts[jp->verdict]);
+
+    count[jp->verdict]++;
+
+    if (jp->verdict != VERDICT_UNREADABLE)
+    {
+        steps   += jp->script.ic;
+        seconds += jp->script.ic * jp->script.dt;
+    }
+}
+
+/*
+ * Verify the replays in PATHS, a batch of them at a time, so that only
+ * the inputs of a batch are held at once.
+ */
+static void verify(Array paths)
+{
+    const int batch = pool_size(pool) * 8;
+
+    struct job *jv;
+    int i, j, n;
+
+    if (!(jv = calloc(batch, sizeof (*jv))))
+        return;
+
+    for (i = 0; i < array_len(paths); i += n)
+    {
+        n = MIN(batch, array_len(paths) - i);
+
+        for (j = 0; j < n; j++)
+        {
+            memset(jv + j, 0, sizeof (*jv));
+
+            SAFECPY(jv[j].path, *(char **) array_get(paths, i + j));
+
+            if (!job_load(jv + j))
+            {
+                fprintf(stderr, "%s: unreadable replay or level\n", jv[j].path);
+                jv[j].verdict = VERDICT_UNREADABLE;
+            }
+        }
+
+        pool_run(pool, n, job_run, jv);
+
+        for (j = 0; j < n; j++)
+        {
+            job_out(jv + j);
+
+            if (jv[j].verdict != VERDICT_UNREADABLE)
+                world_free(&jv[j].world);
+
+            world_script_free(&jv[j].script);
+        }
+        fflush(stdout);
+    }
+
+    free(jv);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    Array paths;
+    double t0, t1;
+    int argi, i;
+
+    if (!fs_init(argc > 0 ? argv[0] : NULL))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n", fs_error());
+        return 1;
+    }
+
+    fs_set_logging(0);
+
+    for (argi = 1; argi < argc; ++argi)
+    {
+        if      (strcmp(argv[argi], "--data")    == 0 && argi + 1 < argc)
+            opt_data = argv[++argi];
+        else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc)
+        {
+            opt_threads = atoi(argv[++argi]);
+            opt_threads = MAX(0, opt_threads);
+        }
+        else if (argv[argi][0] == '-')
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+            return 1;
+        }
+        else break;
+    }
+
+    if (argi == argc)
+    {
+        fprintf(stderr, "Usage: %s [--data <dir>] [--threads <n>] "
+                "<replay|dir>...\n", argv[0]);
+        return 1;
+    }
+
+    fs_add_path_with_archives(opt_data);
+
+    if (!(pool = pool_create(opt_threads)) ||
+        !(paths = array_new(sizeof (char *))))
+    {
+        fprintf(stderr, "Failure to start worker threads\n");
+        return 1;
+    }
+
+    for (; argi < argc; argi++)
+        list_path(paths, argv[argi]);
+
+    printf("replay\tlevel\tstatus\tcoins\ttimer\t"
+           "sim_status\tsim_coins\tsim_timer\tverdict\n");
+
+    t0 = now();
+    verify(paths);
+    t1 = now();
+
+    fprintf(stderr, "%d replays on %d threads in %.3f s: "
+            "%.1f replays, %.0f steps, %.0f replay seconds per second\n",
+            array_len(paths), pool_size(pool), t1 - t0,
+            t1 > t0 ? array_len(paths) / (t1 - t0) : 0.0,
+            t1 > t0 ? steps   / (t1 - t0) : 0.0,
+            t1 > t0 ? seconds / (t1 - t0) : 0.0);
+
+    for (i = 0; i < VERDICT_MAX; i++)
+        fprintf(stderr, "%s%s %d", i ? ", " : "", verdicts[i], count[i]);
+    fprintf(stderr, "\n");
+
+    for (i = 0; i < array_len(paths); i++)
+        free(*(char **) array_get(paths, i));
+
+    array_free(paths);
+    pool_destroy(pool);
+    level_free();
+    fs_quit();
+
+    return count[VERDICT_HEADER] || count[VERDICT_UNREADABLE] ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The part of the batch a worker has yet to start.  The owner takes
+ * items off the bottom, thieves take halves off the top.
+ */
+struct p_range
+{
+    pthread_mutex_t lock;
+    int lo;
+    int hi;
+};
+
+struct p_worker
+{
+    struct pool *pool;
+    int          id;
+};
+
+struct pool
+{
+    int              n;
+    pthread_t       *tv;
+    struct p_worker *wv;
+    struct p_range  *rv;
+
+    pthread_mutex_t  lock;
+    pthread_cond_t   wake;                     /* a batch is ready           */
+    pthread_cond_t   idle;                     /* the batch is done          */
+
+    unsigned int     gen;                      /* batch counter              */
+    int              busy;                     /* workers still on the batch */
+    int              quit;
+
+    pool_fn          fn;
+    void            *data;
+};
+
+/*---------------------------------------------------------------------------*/
+
+static int range_take(struct p_range *rp)
+{
+    int i = -1;
+
+    pthread_mutex_lock(&rp->lock);
+
+    if (rp->lo < rp->hi)
+        i = rp->lo++;
+
+    pthread_mutex_unlock(&rp->lock);
+
+    return i;
+}
+
+static int range_size(struct p_range *rp)
+{
+    int k;
+
+    pthread_mutex_lock(&rp->lock);
+    k = rp->hi - rp->lo;
+    pthread_mutex_unlock(&rp->lock);
+
+    return k;
+}
+
+/*
+ * Move the top half of the largest other range into worker ID's own,
+ * which is empty.  Returns 0 once there is nothing left to steal.
+ */
+static int range_steal(struct pool *pool, int id)
+{
+    for (;;)
+    {
+        struct p_range *vp = NULL;
+        int i, k, m = 0;
+
+        for (i = 0; i < pool->n; i++)
+            if (i != id && (k = range_size(pool->rv + i)) > m)
+            {
+                vp = pool->rv + i;
+                m  = k;
+            }
+
+        if (vp == NULL)
+            return 0;
+
+        pthread_mutex_lock(&vp->lock);
+
+        if ((k = vp->hi - vp->lo) > 0)
+        {
+            struct p_range *rp = pool->rv + id;
+
+            int hi = vp->hi;
+            int lo = vp->hi - (k + 1) / 2;
+
+            vp->hi = lo;
+
+            pthread_mutex_unlock(&vp->lock);
+
+            pthread_mutex_lock(&rp->lock);
+            rp->lo = lo;
+            rp->hi = hi;
+            pthread_mutex_unlock(&rp->lock);
+
+            return 1;
+        }
+
+        /* The victim finished in the meantime.  Look again. */
+
+        pthread_mutex_unlock(&vp->lock);
+    }
+}
+
+static void pool_work(struct pool *pool, int id)
+{
+    int i;
+
+    for (;;)
+    {
+        if ((i = range_take(pool->rv + id)) >= 0)
+            pool->fn(pool->data, i);
+        else if (!range_steal(pool, id))
+            break;
+    }
+}
+
+static void *pool_main(void *arg)
+{
+    struct p_worker *wp   = arg;
+    struct pool     *pool = wp->pool;
+
+    unsigned int gen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;)
+    {
+        while (pool->gen == gen && !pool->quit)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+
+        if (pool->quit)
+            break;
+
+        gen = pool->gen;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool_work(pool, wp->id);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->idle);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int cpu_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (int) n : 1;
+#else
+    return 1;
+#endif
+}
+
+/*
+ * Start N workers, or one per processor if N is zero.
+ */
+struct pool *pool_create(int n)
+{
+    struct pool *pool;
+    int i;
+
+    if (n <= 0)
+        n = cpu_count();
+
+    if (!(pool = calloc(1, sizeof (*pool))))
+        return NULL;
+
+    pool->tv = calloc(n, sizeof (*pool->tv));
+    pool->wv = calloc(n, sizeof (*pool->wv));
+    pool->rv = calloc(n, sizeof (*pool->rv));
+
+    if (!pool->tv || !pool->wv || !pool->rv)
+    {
+        free(pool->tv);
+        free(pool->wv);
+        free(pool->rv);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init (&pool->wake, NULL);
+    pthread_cond_init (&pool->idle, NULL);
+
+    for (i = 0; i < n; i++)
+        pthread_mutex_init(&pool->rv[i].lock, NULL);
+
+    /* Make do with however many threads we get. */
+
+    for (i = 0; i < n; i++)
+    {
+        pool->wv[i].pool = pool;
+        pool->wv[i].id   = i;
+
+        if (pthread_create(pool->tv + i, NULL, pool_main, pool->wv + i))
+            break;
+
+        pool->n = i + 1;
+    }
+
+    if (pool->n == 0)
+    {
+        pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void pool_destroy(struct pool *pool)
+{
+    int i;
+
+    if (pool)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->quit = 1;
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (i = 0; i < pool->n; i++)
+            pthread_join(pool->tv[i], NULL);
+
+        for (i = 0; i < pool->n; i++)
+            pthread_mutex_destroy(&pool->rv[i].lock);
+
+        pthread_cond_destroy (&pool->idle);
+        pthread_cond_destroy (&pool->wake);
+        pthread_mutex_destroy(&pool->lock);
+
+        free(pool->tv);
+        free(pool->wv);
+        free(pool->rv);
+        free(pool);
+    }
+}
+
+int pool_size(const struct pool *pool)
+{
+    return pool ? pool->n : 1;
+}
+
+void pool_run(struct pool *pool, int n, pool_fn fn, void *data)
+{
+    int i;
+
+    if (pool == NULL || pool->n == 1 || n == 1)
+    {
+        for (i = 0; i < n; i++)
+            fn(data, i);
+        return;
+    }
+
+    if (n <= 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->fn   = fn;
+    pool->data = data;
+
+    /* Deal out the batch in equal shares. */
+
+    for (i = 0; i < pool->n; i++)
+    {
+        pool->rv[i].lo = (int) ((long) n *  i      / pool->n);
+        pool->rv[i].hi = (int) ((long) n * (i + 1) / pool->n);
+    }
+
+    pool->busy = pool->n;
+    pool->gen++;
+
+    pthread_cond_broadcast(&pool->wake);
+
+    while (pool->busy)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * A fixed set of worker threads for batch jobs.
+ *
+ * pool_run calls FN once for each index in [0, N) and returns when all
+ * calls have.  Each worker starts on an equal share of the range and,
+ * when its share runs dry, steals half of what remains of the largest
+ * other share, so uneven items still keep every worker busy.
+ *
+ * A NULL pool runs the batch on the calling thread.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+struct pool;
+
+typedef void (*pool_fn)(void *data, int i);
+
+struct pool *pool_create(int n);
+void         pool_destroy(struct pool *);
+
+int  pool_size(const struct pool *);
+void pool_run(struct pool *, int n, pool_fn, void *data);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
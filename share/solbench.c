@@ -0,0 +1,1129 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+/*
+ * Headless physics benchmark.  Loads the level of each given replay,
+ * feeds the recorded tilt to sol_step and reports how much work the
+ * collision code did.  No SDL, no GL.
+ *
+ * Without --track, the replay is re-simulated with the game rules for
+ * items, jumps, goals, time-out and fall-out, and the outcome is
+ * reported.  --check compares outcomes against an earlier report, so
+ * that builds with different math or kernels can be checked against
+ * each other.  It also checks, once per second of each replay, that a
+ * snapshot of the world restores to a state that steps the same way as
+ * the world itself.  --snap-drop leaves a field out of the restore, so
+ * that the check can be seen to fail.
+ *
+ * --worlds runs the replay on that many identical worlds at once, on a
+ * pool of --threads workers, and fails if any of them diverge.  The
+ * time is then wall time for the whole batch.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "vec3.h"
+#include "array.h"
+#include "cmd.h"
+#include "binary.h"
+#include "common.h"
+#include "dir.h"
+#include "fs.h"
+
+#include "solid_base.h"
+#include "solid_vary.h"
+#include "solid_sim.h"
+#include "solid_pack.h"
+#include "solid_all.h"
+#include "solid_world.h"
+#include "pool.h"
+#include "demo_scan.h"
+
+/*---------------------------------------------------------------------------*/
+
+static int opt_track  = 0;
+static int opt_repeat = 1;
+static int opt_kernel = SOL_KERNEL_SIMD;
+static int opt_worlds  = 0;
+static int opt_threads = 0;
+
+static const char *opt_data  = CONFIG_DATA;
+static const char *opt_out   = NULL;
+static const char *opt_check = NULL;
+
+/* Fields that --snap-drop leaves out of a restore. */
+
+enum
+{
+    DROP_NONE = 0,
+    DROP_ACCUM,
+    DROP_MOVE
+};
+
+static int opt_drop = DROP_NONE;
+
+static struct pool *pool;
+static int          batch_fail;
+static int          snap_fail;
+
+/*---------------------------------------------------------------------------*/
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Step latencies, in seconds.
+ */
+struct lat
+{
+    double *v;
+    int     c;
+    int     n;
+};
+
+static void lat_add(struct lat *lp, double t)
+{
+    if (lp->c == lp->n)
+    {
+        int     n = lp->n ? lp->n * 2 : 4096;
+        double *v;
+
+        if (!(v = realloc(lp->v, n * sizeof (*v))))
+            return;
+
+        lp->v = v;
+        lp->n = n;
+    }
+    lp->v[lp->c++] = t;
+}
+
+static int cmp_lat(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Return the P-th percentile.  The array is sorted in place.
+ */
+static double lat_get(struct lat *lp, double p)
+{
+    if (lp->c == 0)
+        return 0.0;
+
+    qsort(lp->v, lp->c, sizeof (*lp->v), cmp_lat);
+
+    return lp->v[CLAMP(0, (int) (p * (lp->c - 1) + 0.5), lp->c - 1)];
+}
+
+static void lat_free(struct lat *lp)
+{
+    free(lp->v);
+    memset(lp, 0, sizeof (*lp));
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * FNV-1a over the bytes of a block of memory.
+ */
+static unsigned int hash_add(unsigned int h, const void *p, size_t n)
+{
+    const unsigned char *c = p;
+
+    while (n--)
+        h = (h ^ *c++) * 16777619u;
+
+    return h;
+}
+
+/*---------------------------------------------------------------------------*/
+
+struct outcome
+{
+    int status;
+    int coins;
+    int timer;                          /* Time taken, centiseconds          */
+};
+
+struct result
+{
+    char name[PATHMAX];
+    char file[PATHMAX];
+
+    int version;                        /* Replay version and flags          */
+    int flags;
+
+    int time_limit;                     /* Centiseconds, 0 if untimed        */
+
+    struct outcome rec;                 /* Outcome as recorded               */
+    struct outcome sim;                 /* Outcome as re-simulated           */
+
+    double time;                        /* Time spent stepping               */
+
+    unsigned int hash;                  /* Digest of the simulated ball      */
+
+    struct sol_stats stats;
+    struct lat       lat;
+};
+
+static void result_out(FILE *fp, struct result *rp)
+{
+    const double k = rp->stats.step ? 1.0 / rp->stats.step : 0.0;
+
+    double p50 = lat_get(&rp->lat, 0.50);
+    double p99 = lat_get(&rp->lat, 0.99);
+
+    fprintf(fp, "%s\t%s\t%lu\t%.6f\t%.0f\t"
+            "%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t"
+            "%.3f\t%.3f\t%.1f\t%08x\t"
+            "%d\t%d\t%d\n",
+            rp->name,
+            rp->file,
+            rp->stats.step,
+            rp->time,
+            rp->time > 0.0 ? rp->stats.step / rp->time : 0.0,
+            rp->stats.iter * k,
+            rp->stats.body * k,
+            rp->stats.node * k,
+            rp->stats.cull * k,
+            rp->stats.seed * k,
+            rp->stats.lump * k,
+            rp->stats.test * k,
+            p50 * 1.0e+6,
+            p99 * 1.0e+6,
+            rp->stats.xfrm ? 100.0 - 100.0 * rp->stats.xmiss / rp->stats.xfrm : 0.0,
+            rp->hash,
+            rp->sim.status,
+            rp->sim.coins,
+            rp->sim.timer);
+}
+
+static void result_hdr(FILE *fp)
+{
+    fprintf(fp, "replay\tlevel\tsteps\tseconds\tsteps_per_sec\t"
+            "iters_per_step\tbodies_per_step\tnodes_per_step\t"
+            "culls_per_step\tseeds_per_step\tlumps_per_step\ttests_per_step\tp50_us\tp99_us\txfrm_hit_pct\tdigest\t"
+            "status\tcoins\ttimer\n");
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Read the header fields we care about.  This mirrors demo_header_read.
+ */
+static int read_head(fs_file fp, struct result *rp)
+{
+    struct demo_head head;
+
+    if (!demo_scan_head(fp, &head))
+        return 0;
+
+    rp->version = head.version;
+    rp->flags   = head.flags;
+
+    rp->rec.timer  = head.timer;
+    rp->rec.coins  = head.coins;
+    rp->rec.status = head.status;
+
+    SAFECPY(rp->file, head.file);
+
+    rp->time_limit = head.time;
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Recorded state of the most recent update.
+ */
+struct track
+{
+    struct game_tilt tilt;
+    float view_e[3][3];
+
+    float p[3];                         /* Current recorded position         */
+    float q[3];                         /* Previous recorded position        */
+    float r;
+
+    int got_tilt_axes;
+    int got_p;
+    int got_r;
+
+    int status;
+    int jump;
+    int goal;
+};
+
+/*
+ * Bring the simulation in line with the recorded update.
+ */
+static void track_sync(struct s_vary *vary, struct track *tp, float dt)
+{
+    struct v_ball *up = vary->uv;
+
+    if (tp->got_r)
+        up->r = tp->r;
+
+    if (tp->got_p)
+    {
+        /* Derive the velocity from the last two recorded positions. */
+
+        v_sub(up->v, tp->p, tp->q);
+        v_scl(up->v, up->v, 1.0f / dt);
+        v_cpy(up->p, tp->p);
+        v_cpy(tp->q, tp->p);
+    }
+
+    tp->got_p = 0;
+    tp->got_r = 0;
+
+    /* Movers may have been moved to their recorded state. */
+
+    sol_init_sched(vary);
+}
+
+static void track_cmd(struct s_vary *vary, struct track *tp,
+                      const union cmd *cmd)
+{
+    int idx;
+
+    switch (cmd->type)
+    {
+    case CMD_TILT_AXES:
+        tp->got_tilt_axes = 1;
+        v_cpy(tp->tilt.x, cmd->tiltaxes.x);
+        v_cpy(tp->tilt.z, cmd->tiltaxes.z);
+        break;
+
+    case CMD_TILT_ANGLES:
+        if (!tp->got_tilt_axes)
+        {
+            /* Neverball <= 1.5.1 tilts around the view vectors. */
+
+            v_cpy(tp->tilt.x, tp->view_e[0]);
+            v_cpy(tp->tilt.z, tp->view_e[2]);
+        }
+        tp->tilt.rx = cmd->tiltangles.x;
+        tp->tilt.rz = cmd->tiltangles.z;
+        break;
+
+    case CMD_VIEW_BASIS:
+        v_cpy(tp->view_e[0], cmd->viewbasis.e[0]);
+        v_cpy(tp->view_e[1], cmd->viewbasis.e[1]);
+        v_crs(tp->view_e[2], tp->view_e[0], tp->view_e[1]);
+        break;
+
+    case CMD_STATUS:
+        tp->status = cmd->status.t;
+        break;
+
+    case CMD_GOAL_OPEN:
+        tp->goal = 1;
+        break;
+
+    case CMD_JUMP_ENTER:
+        tp->jump = 1;
+        break;
+
+    case CMD_JUMP_EXIT:
+        tp->jump = 0;
+        break;
+
+    case CMD_BALL_POSITION:
+        tp->got_p = 1;
+        v_cpy(tp->p, cmd->ballpos.p);
+        break;
+
+    case CMD_BALL_RADIUS:
+        tp->got_r = 1;
+        tp->r = cmd->ballradius.r;
+        break;
+
+    case CMD_PATH_FLAG:
+        if (opt_track && (idx = cmd->pathflag.pi) >= 0 && idx < vary->pc)
+            vary->pv[idx].f = cmd->pathflag.f;
+        break;
+
+    case CMD_MOVE_PATH:
+        if (opt_track && (idx = cmd->movepath.mi) >= 0 && idx < vary->mc &&
+            cmd->movepath.pi >= 0 && cmd->movepath.pi < vary->pc)
+        {
+            vary->mv[idx].pi = cmd->movepath.pi;
+            set_move_dirty(vary, idx, 1u);
+        }
+        break;
+
+    case CMD_MOVE_TIME:
+        if (opt_track && (idx = cmd->movetime.mi) >= 0 && idx < vary->mc)
+        {
+            vary->mv[idx].t  = cmd->movetime.t;
+            vary->mv[idx].tm = TIME_TO_MS(cmd->movetime.t);
+            set_move_dirty(vary, idx, 1u);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void track_init(struct track *tp)
+{
+    memset(tp, 0, sizeof (*tp));
+
+    game_tilt_init(&tp->tilt);
+
+    tp->view_e[0][0] = 1.0f;
+    tp->view_e[1][1] = 1.0f;
+    tp->view_e[2][2] = 1.0f;
+}
+
+/*
+ * Take the input to the next step from the recorded update.
+ */
+static void track_input(struct track *tp, struct w_input *in)
+{
+    in->tilt = tp->tilt;
+    in->goal = tp->goal;
+
+    tp->goal = 0;
+}
+
+/*
+ * Place the ball as of the first update, which is the initial state,
+ * not a step.
+ */
+static void track_start(struct s_vary *vary, struct track *tp)
+{
+    if (tp->got_p)
+    {
+        v_cpy(vary->uv->p, tp->p);
+        v_cpy(tp->q, tp->p);
+    }
+    if (tp->got_r)
+        vary->uv->r = tp->r;
+
+    tp->got_p = 0;
+    tp->got_r = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void stats_add(struct sol_stats *dst, const struct sol_stats *src)
+{
+    dst->step  += src->step;
+    dst->iter  += src->iter;
+    dst->body  += src->body;
+    dst->node  += src->node;
+    dst->cull  += src->cull;
+    dst->seed  += src->seed;
+    dst->xfrm  += src->xfrm;
+    dst->xmiss += src->xmiss;
+    dst->lump  += src->lump;
+    dst->test  += src->test;
+}
+
+static void world_outcome(const struct s_world *w, struct outcome *op)
+{
+    op->status = w->status;
+    op->coins  = w->coins;
+    op->timer  = world_timer(w);
+}
+
+/*
+ * Scratch space of the snapshot check.
+ */
+struct snap_check
+{
+    struct s_world world;               /* World to restore into             */
+    struct s_snap  a, b, c;
+};
+
+/*
+ * Restore a snapshot of the varying data of WP into the scratch world,
+ * with the game rules as they stand.  With --snap-drop, one field is
+ * left as the level loaded it, as if the snapshot had missed it.
+ */
+static int snap_take(struct snap_check *sc, const struct s_world *wp)
+{
+    struct s_world *w = &sc->world;
+    struct s_vary vary = w->vary;
+    int i;
+
+    if (!sol_vary_snapshot(&sc->a, &wp->vary))
+        return 0;
+
+    *w = *wp;
+    w->vary = vary;
+
+    if (!sol_vary_restore(&w->vary, &sc->a))
+        return 0;
+
+    if (opt_drop == DROP_ACCUM)
+        w->vary.ms_accum = 0.0f;
+
+    if (opt_drop == DROP_MOVE)
+        for (i = 0; i < w->vary.mc; i++)
+        {
+            w->vary.mv[i].t  = 0.0f;
+            w->vary.mv[i].tm = 0;
+        }
+
+    return 1;
+}
+
+/*
+ * Step the scratch world as WP was just stepped.  Both must come out
+ * the same.
+ */
+static int snap_check(struct snap_check *sc, const struct s_world *wp,
+                      const struct game_tilt *tilt, float dt)
+{
+    struct s_world *w = &sc->world;
+
+    world_step(w, tilt, dt);
+
+    if (!sol_vary_snapshot(&sc->b, &wp->vary) ||
+        !sol_vary_snapshot(&sc->c, &w->vary))
+        return 0;
+
+    return (w->status == wp->status &&
+            w->coins  == wp->coins  &&
+            w->hash   == wp->hash   &&
+            sc->b.size == sc->c.size &&
+            memcmp(sc->b.data, sc->c.data, sc->b.size) == 0);
+}
+
+/*
+ * Play back one replay, stepping the simulation once per update.
+ */
+static int bench_run(fs_file fp, struct s_base *base,
+                     const struct s_pack *pack, struct result *rp)
+{
+    struct track   track;
+    struct s_world world;
+    struct s_vary *vary = &world.vary;
+    struct sol_stats stats;
+    union cmd cmd;
+
+    static struct cmd_stream cs;
+
+    struct snap_check sc;
+
+    float dt = 1.0f / 90.0f;
+    int first = 1;
+    int snaps = 0;
+    int check = 0;
+    int n = 0;
+
+    if (!world_init(&world, base, pack, NULL, rp->time_limit / 100.0f, 0))
+        return 0;
+
+    memset(&sc, 0, sizeof (sc));
+
+    if (opt_check && !opt_track)
+        check = snaps = world_init(&sc.world, base, pack, NULL, 0.0f, 0);
+
+    track_init(&track);
+
+    cmd_stream_init(&cs, rp->version);
+
+    while (cmd_get_stream(fp, &cs, &cmd))
+    {
+        if (cmd.type == CMD_UPDATES_PER_SECOND && cmd.ups.n > 0)
+            dt = 1.0f / cmd.ups.n;
+
+        if (cmd.type == CMD_END_OF_UPDATE)
+        {
+            struct w_input in;
+            double t0, t1;
+
+            track_input(&track, &in);
+
+            if (in.goal)
+                world_goal(&world);
+
+            if (first)
+            {
+                if (opt_track)
+                    track_start(vary, &track);
+
+                first = 0;
+                continue;
+            }
+
+            if (opt_track)
+            {
+                /* The server holds the ball while it jumps. */
+
+                if (!track.jump)
+                {
+                    float h[3];
+
+                    game_tilt_grav(h, (track.status == GAME_GOAL ?
+                                       GRAVITY_UP : GRAVITY_DN), &in.tilt);
+
+                    t0 = now();
+                    sol_step(vary, NULL, h, dt, 0, NULL);
+                    t1 = now();
+
+                    rp->time += t1 - t0;
+                    lat_add(&rp->lat, t1 - t0);
+
+                    rp->hash = hash_add(rp->hash, vary->uv->p, sizeof (vary->uv->p));
+                    rp->hash = hash_add(rp->hash, vary->uv->v, sizeof (vary->uv->v));
+                }
+
+                track_sync(vary, &track, dt);
+            }
+            else
+            {
+                int snap = 0;
+
+                if (check && n++ % 90 == 0)
+                    snap = snap_take(&sc, &world) ? 1 : -1;
+
+                t0 = now();
+                world_step(&world, &in.tilt, dt);
+                t1 = now();
+
+                rp->time += t1 - t0;
+                lat_add(&rp->lat, t1 - t0);
+
+                if (snap && (snap < 0 || !snap_check(&sc, &world, &in.tilt, dt)))
+                {
+                    fprintf(stderr, "%s: snapshot of update %d does not restore\n",
+                            rp->name, n);
+                    snap_fail++;
+                    check = 0;
+                }
+            }
+        }
+        else track_cmd(vary, &track, &cmd);
+
+        cmd_clear(&cmd);
+    }
+
+    sol_stats_get(vary, &stats);
+    stats_add(&rp->stats, &stats);
+
+    if (opt_track)
+        rp->sim = rp->rec;
+    else
+    {
+        rp->hash = world.hash;
+        world_outcome(&world, &rp->sim);
+    }
+
+    if (snaps)
+    {
+        sol_free_snap(&sc.a);
+        sol_free_snap(&sc.b);
+        sol_free_snap(&sc.c);
+
+        world_free(&sc.world);
+    }
+
+    world_free(&world);
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+struct batch
+{
+    struct s_world       *wv;
+    const struct w_input *iv;
+    int                   ic;
+    float                 dt;
+};
+
+static void batch_one(void *data, int i)
+{
+    const struct batch *bp = data;
+    struct s_world     *wp = bp->wv + i;
+    int j;
+
+    for (j = 0; j < bp->ic; j++)
+    {
+        if (bp->iv[j].goal)
+            world_goal(wp);
+
+        world_step(wp, &bp->iv[j].tilt, bp->dt);
+    }
+}
+
+/*
+ * Play back one replay on many identical worlds at once.  All of them
+ * must come out the same.  The worlds are made and freed here, on the
+ * main thread, and only stepped on the pool.
+ */
+static int bench_batch(fs_file fp, struct s_base *base,
+                       const struct s_pack *pack, struct result *rp)
+{
+    struct s_world *wv;
+    struct w_script script;
+    struct sol_stats stats;
+    struct batch batch;
+
+    double t0, t1;
+    int i, n = 0, bad = 0;
+
+    if (!world_script_read(&script, fp, rp->version))
+        return 0;
+
+    if (!(wv = calloc(opt_worlds, sizeof (*wv))))
+    {
+        world_script_free(&script);
+        return 0;
+    }
+
+    for (n = 0; n < opt_worlds; n++)
+        if (!world_init(wv + n, base, pack, NULL, rp->time_limit / 100.0f,
+                        script.goal_e))
+            break;
+
+    batch.wv = wv;
+    batch.iv = script.iv;
+    batch.ic = script.ic;
+    batch.dt = script.dt;
+
+    t0 = now();
+    pool_run(pool, n, batch_one, &batch);
+    t1 = now();
+
+    rp->time += t1 - t0;
+
+    for (i = 0; i < n; i++)
+    {
+        sol_stats_get(&wv[i].vary, &stats);
+        stats_add(&rp->stats, &stats);
+
+        if (wv[i].hash != wv[0].hash)
+            bad++;
+    }
+
+    if (n)
+    {
+        rp->hash = wv[0].hash;
+        world_outcome(wv, &rp->sim);
+    }
+
+    if (bad)
+    {
+        fprintf(stderr, "%s: %d of %d worlds diverged\n", rp->name, bad, n);
+        batch_fail++;
+    }
+
+    for (i = 0; i < n; i++)
+        world_free(wv + i);
+
+    free(wv);
+    world_script_free(&script);
+
+    return n > 0;
+}
+
+/*
+ * Benchmark a single replay file, given by system path.
+ */
+static int bench_file(const char *path, struct result *rp)
+{
+    char dir[MAXSTR];
+
+    struct s_base base;
+    struct s_pack pack;
+
+    fs_file fp;
+    int n, rc = 0;
+
+    memset(rp, 0, sizeof (*rp));
+
+    rp->hash = 2166136261u;
+
+    SAFECPY(dir,      dir_name(path));
+    SAFECPY(rp->name, base_name(path));
+
+    /* Mount the replay directory for the duration. */
+
+    fs_add_path(dir);
+
+    if ((fp = fs_open_map(rp->name)))
+    {
+        if (read_head(fp, rp) && (fp = demo_scan_body(fp, rp->flags)) &&
+            sol_load_base(&base, rp->file))
+        {
+            long pos = fs_tell(fp);
+
+            /* Worlds share the packed geometry, which is built here. */
+
+            const struct s_pack *pp = sol_load_pack(&pack, &base) ? &pack : NULL;
+
+            for (n = 0; n < opt_repeat; n++)
+            {
+                fs_seek(fp, pos, SEEK_SET);
+
+                if (opt_worlds)
+                    bench_batch(fp, &base, pp, rp);
+                else
+                    bench_run(fp, &base, pp, rp);
+            }
+
+            if (pp)
+                sol_free_pack(&pack);
+
+            sol_free_base(&base);
+
+            rc = 1;
+        }
+        else fprintf(stderr, "%s: unreadable replay or level\n", path);
+
+        if (fp)
+            fs_close(fp);
+    }
+    else fprintf(stderr, "%s: %s\n", path, fs_error());
+
+    fs_remove_path(dir);
+
+    return rc;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int is_replay(struct dir_item *item)
+{
+    return str_ends_with(item->path, ".nbr");
+}
+
+static int cmp_items(const void *A, const void *B)
+{
+    const struct dir_item *a = A, *b = B;
+    return strcmp(a->path, b->path);
+}
+
+static struct result total;
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Outcomes of an earlier run, read back from its --out report.
+ */
+struct check
+{
+    char name[PATHMAX];
+    struct outcome o;
+};
+
+static Array checks;
+static int   check_miss;
+static int   check_fail;
+
+static int check_load(const char *path)
+{
+    char line[MAXSTR * 2];
+    FILE *fp;
+
+    if (!(fp = fopen(path, "r")))
+        return 0;
+
+    checks = array_new(sizeof (struct check));
+
+    while (fgets(line, sizeof (line), fp))
+    {
+        struct check *cp;
+        char *tab, *end;
+        int n = 0;
+
+        /* Name is the first column, the outcome the last three. */
+
+        if (!(tab = strchr(line, '\t')) || strncmp(line, "replay\t", 7) == 0)
+            continue;
+
+        for (end = line + strlen(line); end > tab; end--)
+            if (end[-1] == '\t' && ++n == 3)
+                break;
+
+        *tab = 0;
+
+        if (n == 3 && (cp = array_add(checks)))
+        {
+            SAFECPY(cp->name, line);
+
+            if (sscanf(end, "%d %d %d", &cp->o.status,
+                                        &cp->o.coins,
+                                        &cp->o.timer) != 3)
+                array_del(checks);
+        }
+    }
+    fclose(fp);
+
+    return 1;
+}
+
+static void check_result(const struct result *rp)
+{
+    int i;
+
+    for (i = 0; i < array_len(checks); i++)
+    {
+        const struct check *cp = array_get(checks, i);
+
+        if (strcmp(cp->name, rp->name) == 0)
+        {
+            if (cp->o.status != rp->sim.status ||
+                cp->o.coins  != rp->sim.coins  ||
+                cp->o.timer  != rp->sim.timer)
+            {
+                fprintf(stderr, "%s: outcome %d/%d/%d, expected %d/%d/%d\n",
+                        rp->name,
+                        rp->sim.status, rp->sim.coins, rp->sim.timer,
+                        cp->o.status,   cp->o.coins,   cp->o.timer);
+                check_fail++;
+            }
+            return;
+        }
+    }
+
+    fprintf(stderr, "%s: not in %s\n", rp->name, opt_check);
+    check_miss++;
+}
+
+static void bench_path(const char *path, FILE *out)
+{
+    struct result res;
+    int i;
+
+    if (dir_exists(path))
+    {
+        Array items;
+
+        if ((items = dir_scan(path, is_replay, NULL, NULL)))
+        {
+            array_sort(items, cmp_items);
+
+            for (i = 0; i < array_len(items); i++)
+                bench_path(DIR_ITEM_GET(items, i)->path, out);
+
+            dir_free(items);
+        }
+        return;
+    }
+
+    if (bench_file(path, &res))
+    {
+        stats_add(&total.stats, &res.stats);
+
+        total.time += res.time;
+        total.hash  = hash_add(total.hash, &res.hash, sizeof (res.hash));
+
+        for (i = 0; i < res.lat.c; i++)
+            lat_add(&total.lat, res.lat.v[i]);
+
+        result_out(stdout, &res);
+
+        if (out)
+            result_out(out, &res);
+        if (checks)
+            check_result(&res);
+    }
+    lat_free(&res.lat);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int bench_opts(int argc, char *argv[])
+{
+    int argi;
+
+    for (argi = 1; argi < argc; ++argi)
+    {
+        if      (strcmp(argv[argi], "--track")  == 0)
+            opt_track = 1;
+        else if (strcmp(argv[argi], "--data")   == 0 && argi + 1 < argc)
+            opt_data = argv[++argi];
+        else if (strcmp(argv[argi], "--out")    == 0 && argi + 1 < argc)
+            opt_out = argv[++argi];
+        else if (strcmp(argv[argi], "--check")  == 0 && argi + 1 < argc)
+            opt_check = argv[++argi];
+        else if (strcmp(argv[argi], "--kernel") == 0 && argi + 1 < argc)
+        {
+            const char *k = argv[++argi];
+
+            if      (strcmp(k, "scalar") == 0) opt_kernel = SOL_KERNEL_SCALAR;
+            else if (strcmp(k, "packed") == 0) opt_kernel = SOL_KERNEL_PACKED;
+            else if (strcmp(k, "simd")   == 0) opt_kernel = SOL_KERNEL_SIMD;
+            else
+            {
+                fprintf(stderr, "Unknown kernel: %s\n", k);
+                return 0;
+            }
+        }
+        else if (strcmp(argv[argi], "--snap-drop") == 0 && argi + 1 < argc)
+        {
+            const char *f = argv[++argi];
+
+            if      (strcmp(f, "accum")  == 0) opt_drop = DROP_ACCUM;
+            else if (strcmp(f, "move")   == 0) opt_drop = DROP_MOVE;
+            else
+            {
+                fprintf(stderr, "Unknown field: %s\n", f);
+                return 0;
+            }
+        }
+        else if (strcmp(argv[argi], "--worlds")  == 0 && argi + 1 < argc)
+        {
+            opt_worlds = atoi(argv[++argi]);
+            opt_worlds = MAX(0, opt_worlds);
+        }
+        else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc)
+        {
+            opt_threads = atoi(argv[++argi]);
+            opt_threads = MAX(0, opt_threads);
+        }
+        else if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc)
+        {
+            opt_repeat = atoi(argv[++argi]);
+            opt_repeat = MAX(1, opt_repeat);
+        }
+        else if (argv[argi][0] == '-')
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+            return 0;
+        }
+        else break;
+    }
+
+    if (argi == argc || (opt_worlds && opt_track))
+    {
+        fprintf(stderr, "Usage: %s [--data <dir>] [--out <file>] "
+                "[--check <file> [--snap-drop accum|move]] "
+                "[--repeat <n>] "
+                "[--kernel scalar|packed|simd] "
+                "[--track | --worlds <n> [--threads <n>]] "
+                "<replay|dir>...\n", argv[0]);
+        return 0;
+    }
+
+    return argi;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *out = NULL;
+    int argi;
+
+    if (!fs_init(argc > 0 ? argv[0] : NULL))
+    {
+        fprintf(stderr, "Failure to initialize virtual file system: %s\n", fs_error());
+        return 1;
+    }
+
+    fs_set_logging(0);
+
+    if (!(argi = bench_opts(argc, argv)))
+        return 1;
+
+    fs_add_path_with_archives(opt_data);
+
+    sol_set_kernel(opt_kernel);
+
+    if (opt_worlds && !(pool = pool_create(opt_threads)))
+    {
+        fprintf(stderr, "Failure to start worker threads\n");
+        return 1;
+    }
+
+    total.hash = 2166136261u;
+
+    if (opt_check && !check_load(opt_check))
+    {
+        fprintf(stderr, "%s: %s\n", opt_check, strerror(errno));
+        return 1;
+    }
+
+    if (opt_out && !(out = fopen(opt_out, "w")))
+    {
+        fprintf(stderr, "%s: %s\n", opt_out, fs_error());
+        return 1;
+    }
+
+    result_hdr(stdout);
+
+    if (out)
+        result_hdr(out);
+
+    for (; argi < argc; argi++)
+        bench_path(argv[argi], out);
+
+    SAFECPY(total.name, "TOTAL");
+    SAFECPY(total.file, "-");
+
+    result_out(stdout, &total);
+
+    if (out)
+    {
+        result_out(out, &total);
+        fclose(out);
+    }
+
+    lat_free(&total.lat);
+    fs_quit();
+
+    if (pool)
+    {
+        fprintf(stderr, "%d worlds on %d threads: %.0f steps per second\n",
+                opt_worlds, pool_size(pool),
+                total.time > 0.0 ? total.stats.step / total.time : 0.0);
+
+        pool_destroy(pool);
+    }
+
+    if (checks)
+    {
+        fprintf(stderr, "%s: %d mismatched, %d missing\n",
+                opt_check, check_fail, check_miss);
+
+        array_free(checks);
+
+        if (snap_fail)
+            fprintf(stderr, "%s: %d snapshots did not restore\n",
+                    opt_check, snap_fail);
+
+        if (check_fail || check_miss || snap_fail)
+            return 1;
+    }
+
+    return batch_fail ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
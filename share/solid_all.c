@@ -15,6 +15,9 @@
 
 /* Random code used in more than one place. */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "solid_all.h"
 #include "solid_vary.h"
 
@@ -464,6 +467,190 @@ void sol_pendulum(struct v_ball *up,
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Transition scheduler.  While a mover's path is enabled, its timer
+ * runs in step with the scheduler clock, so the millisecond at which
+ * it reaches the end of its path stays put until the path or the flag
+ * changes.  The same goes for a running switch timer.  The code below
+ * re-keys an entry whenever one of those changes.
+ */
+
+static int sched_less(const struct v_sched *sp, int i, int j)
+{
+    return sp->tv[sp->hv[i]] < sp->tv[sp->hv[j]];
+}
+
+static void sched_swap(struct v_sched *sp, int i, int j)
+{
+    int k = sp->hv[i];
+
+    sp->hv[i] = sp->hv[j];
+    sp->hv[j] = k;
+
+    sp->iv[sp->hv[i]] = i;
+    sp->iv[sp->hv[j]] = j;
+}
+
+static void sched_fix(struct v_sched *sp, int i)
+{
+    int j;
+
+    /* Sift up. */
+
+    while (i > 0 && sched_less(sp, i, (i - 1) / 2))
+    {
+        sched_swap(sp, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+
+    /* Sift down. */
+
+    while ((j = 2 * i + 1) < sp->hc)
+    {
+        if (j + 1 < sp->hc && sched_less(sp, j + 1, j))
+            j = j + 1;
+
+        if (!sched_less(sp, j, i))
+            break;
+
+        sched_swap(sp, i, j);
+        i = j;
+    }
+}
+
+/*
+ * Schedule entry K for millisecond T, or unschedule it.
+ */
+static void sched_set(struct v_sched *sp, int k, int on, int t)
+{
+    int i = sp->iv[k];
+
+    if (on)
+    {
+        sp->tv[k] = t;
+
+        if (i < 0)
+        {
+            i = sp->hc++;
+
+            sp->hv[i] = k;
+            sp->iv[k] = i;
+        }
+        sched_fix(sp, i);
+    }
+    else if (i >= 0)
+    {
+        if (i < --sp->hc)
+        {
+            sched_swap(sp, i, sp->hc);
+            sched_fix(sp, i);
+        }
+        sp->iv[k] = -1;
+    }
+}
+
+static void sched_move(struct s_vary *vary, int mi)
+{
+    struct v_sched *sp = &vary->sched;
+
+    if (mi < sp->n)
+    {
+        const struct v_move *mp = vary->mv + mi;
+        const struct v_path *pp = vary->pv + mp->pi;
+
+        sched_set(sp, mi, pp->f, sp->ms + pp->base->tm - mp->tm);
+    }
+}
+
+static void sched_swch(struct s_vary *vary, int xi)
+{
+    struct v_sched *sp = &vary->sched;
+
+    if (vary->mc + xi < sp->n)
+    {
+        const struct v_swch *xp = vary->xv + xi;
+
+        sched_set(sp, vary->mc + xi, xp->tm < xp->base->tm,
+                  sp->ms + xp->base->tm - xp->tm);
+    }
+}
+
+/*
+ * Build the schedule from scratch.  Needed before simulating, and
+ * after mover or switch timers are changed from outside this file.
+ */
+int sol_init_sched(struct s_vary *vary)
+{
+    struct v_sched *sp = &vary->sched;
+    int n = vary->mc + vary->xc;
+    int i;
+
+    if (sp->n != n)
+    {
+        free(sp->hv);
+        free(sp->tv);
+        free(sp->iv);
+
+        memset(sp, 0, sizeof (*sp));
+
+        if (n == 0)
+            return 1;
+
+        if (!(sp->hv = malloc(n * sizeof (*sp->hv))) ||
+            !(sp->tv = malloc(n * sizeof (*sp->tv))) ||
+            !(sp->iv = malloc(n * sizeof (*sp->iv))))
+        {
+            free(sp->hv);
+            free(sp->tv);
+            free(sp->iv);
+
+            memset(sp, 0, sizeof (*sp));
+            return 0;
+        }
+        sp->n = n;
+    }
+
+    sp->hc = 0;
+
+    for (i = 0; i < n; i++)
+        sp->iv[i] = -1;
+
+    for (i = 0; i < vary->mc; i++)
+        sched_move(vary, i);
+    for (i = 0; i < vary->xc; i++)
+        sched_swch(vary, i);
+
+    return 1;
+}
+
+/*
+ * Return the milliseconds until the earliest path or switch transition,
+ * or -1 if none is scheduled.
+ */
+int sol_sched_next(const struct s_vary *vary)
+{
+    const struct v_sched *sp = &vary->sched;
+    int k;
+
+    if (sp->hc == 0)
+        return -1;
+
+    if ((k = sp->hv[0]) < vary->mc)
+    {
+        const struct v_move *mp = vary->mv + k;
+
+        return vary->pv[mp->pi].base->tm - mp->tm;
+    }
+    else
+    {
+        const struct v_swch *xp = vary->xv + k - vary->mc;
+
+        return xp->base->tm - xp->tm;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void sol_path_flag(struct s_vary *vary, cmd_fn cmd_func, int pi, int f)
 {
     int mi;
@@ -486,7 +673,10 @@ static void sol_path_flag(struct s_vary *vary, cmd_fn cmd_func, int pi, int f)
 
     for (mi = 0; mi < vary->mc; ++mi)
         if (vary->mv[mi].pi == pi)
+        {
             set_move_dirty(vary, mi, 1u);
+            sched_move(vary, mi);
+        }
 }
 
 static void sol_path_loop(struct s_vary *vary, cmd_fn cmd_func, int p0, int f)
@@ -553,6 +743,8 @@ void sol_swch_step(struct s_vary *vary, cmd_fn cmd_func, float dt, int ms)
 
                 xp->f = xp->base->f;
 
+                sched_swch(vary, xi);
+
                 if (cmd_func)
                 {
                     union cmd cmd = { CMD_SWCH_TOGGLE };
@@ -571,6 +763,10 @@ void sol_move_step(struct s_vary *vary, cmd_fn cmd_func, float dt, int ms)
 {
     int i;
 
+    /* Switch timers follow in sol_swch_step with the same MS. */
+
+    vary->sched.ms += ms;
+
     for (i = 0; i < vary->mc; i++)
     {
         struct v_move *mp = vary->mv + i;
@@ -590,6 +786,8 @@ void sol_move_step(struct s_vary *vary, cmd_fn cmd_func, float dt, int ms)
                 mp->tm = 0;
                 mp->pi = pp->base->pi;
 
+                sched_move(vary, i);
+
                 if (cmd_func)
                 {
                     union cmd cmd;
@@ -852,6 +1050,8 @@ int sol_swch_test(struct s_vary *vary, cmd_fn cmd_func, int ui)
 
                     xp->t = 0.0f;
                     xp->tm = 0;
+
+                    sched_swch(vary, xi);
                 }
             }
             /* The ball exits. */
@@ -42,6 +42,9 @@ void sol_pendulum(struct v_ball *up,
                   const float a[3],
                   const float g[3], float dt);
 
+int  sol_init_sched(struct s_vary *);
+int  sol_sched_next(const struct s_vary *);
+
 void sol_swch_step(struct s_vary *, cmd_fn, float dt, int ms);
 void sol_move_step(struct s_vary *, cmd_fn, float dt, int ms);
 void sol_ball_step(struct s_vary *, cmd_fn, float dt);
@@ -37,6 +37,13 @@ enum
 
 #define SOL_MAGIC (0xAF | 'S' << 8 | 'O' << 16 | 'L' << 24)
 
+/*
+ * Node bounds follow the index array.  Older readers stop before
+ * them, and files without them simply end there.
+ */
+
+#define SOL_NODE_MAGIC (0xAF | 'N' << 8 | 'B' << 16 | 'S' << 24)
+
 /*---------------------------------------------------------------------------*/
 
 static int sol_version;
@@ -223,6 +230,25 @@ static void sol_load_node(fs_file fin, struct b_node *np)
     np->lc = get_index(fin);
 }
 
+static void sol_load_bnds(fs_file fin, struct s_base *fp)
+{
+    int i;
+
+    /* Mark the bounds unknown unless the file provides them. */
+
+    for (i = 0; i < fp->nc; i++)
+        fp->nv[i].r = -1.0f;
+
+    if (get_index(fin) != SOL_NODE_MAGIC || get_index(fin) != fp->nc)
+        return;
+
+    for (i = 0; i < fp->nc; i++)
+    {
+        get_array(fin, fp->nv[i].c, 3);
+        fp->nv[i].r = get_float(fin);
+    }
+}
+
 static void sol_load_path(fs_file fin, struct b_path *pp)
 {
     get_array(fin, pp->p, 3);
@@ -529,6 +555,8 @@ static int sol_load_file(fs_file fin, struct s_base *fp)
     for (i = 0; i < fp->wc; i++) sol_load_view(fin, fp->wv + i);
     for (i = 0; i < fp->ic; i++) fp->iv[i] = get_index(fin);
 
+    sol_load_bnds(fin, fp);
+
     /* Magically "fix" all of our code. */
 
     if (!fp->uc)
@@ -584,7 +612,7 @@ int sol_load_base(struct s_base *fp, const char *filename)
 
     memset(fp, 0, sizeof (*fp));
 
-    if ((fin = fs_open_read(filename)))
+    if ((fin = fs_open_map(filename)))
     {
         res = sol_load_file(fin, fp);
         fs_close(fin);
@@ -599,7 +627,7 @@ int sol_load_meta(struct s_base *fp, const char *filename)
 
     memset(fp, 0, sizeof (*fp));
 
-    if ((fin = fs_open_read(filename)))
+    if ((fin = fs_open_map(filename)))
     {
         res = sol_load_head(fin, fp);
         fs_close(fin);
@@ -713,6 +741,20 @@ static void sol_stor_node(fs_file fout, struct b_node *np)
     put_index(fout, np->lc);
 }
 
+static void sol_stor_bnds(fs_file fout, struct s_base *fp)
+{
+    int i;
+
+    put_index(fout, SOL_NODE_MAGIC);
+    put_index(fout, fp->nc);
+
+    for (i = 0; i < fp->nc; i++)
+    {
+        put_array(fout, fp->nv[i].c, 3);
+        put_float(fout, fp->nv[i].r);
+    }
+}
+
 static void sol_stor_path(fs_file fout, struct b_path *pp)
 {
     put_array(fout, pp->p, 3);
@@ -870,6 +912,8 @@ static void sol_stor_file(fs_file fout, struct s_base *fp)
     for (i = 0; i < fp->uc; i++) sol_stor_ball(fout, fp->uv + i);
     for (i = 0; i < fp->wc; i++) sol_stor_view(fout, fp->wv + i);
     for (i = 0; i < fp->ic; i++) put_index(fout, fp->iv[i]);
+
+    sol_stor_bnds(fout, fp);
 }
 
 int sol_stor_base(struct s_base *fp, const char *filename)
@@ -190,6 +190,9 @@ struct b_node
     int nj;
     int l0;
     int lc;
+
+    float c[3];                                /* bounding sphere center     */
+    float r;                                   /* bounding sphere radius     */
 };
 
 struct b_path
@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PACK_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PACK_NEON 1
+#endif
+
+#include "solid_pack.h"
+#include "vec3.h"
+#include "common.h"
+
+#define LARGE 1.0e+5f
+
+/*---------------------------------------------------------------------------*/
+
+int sol_load_pack(struct s_pack *pk, const struct s_base *base)
+{
+    int vn = 0, en = 0, sn = 0, sm = 0;
+    int i, j;
+
+    memset(pk, 0, sizeof (*pk));
+
+    pk->base = base;
+
+    /* Count the primitives of every lump, with repetition. */
+
+    for (i = 0; i < base->lc; i++)
+    {
+        vn += base->lv[i].vc;
+        en += base->lv[i].ec;
+        sn += base->lv[i].sc;
+        sm  = MAX(sm, base->lv[i].sc);
+    }
+
+    pk->lv = calloc(MAX(base->lc, 1), sizeof (*pk->lv));
+
+    pk->vx = calloc(MAX(vn, 1) * 3, sizeof (float));
+    pk->qx = calloc(MAX(en, 1) * 7, sizeof (float));
+    pk->nx = calloc(MAX(sn, 1) * 4, sizeof (float));
+    pk->sm = sm;
+
+    if (!pk->lv || !pk->vx || !pk->qx || !pk->nx)
+    {
+        sol_free_pack(pk);
+        return 0;
+    }
+
+    pk->vy = pk->vx + vn;
+    pk->vz = pk->vy + vn;
+
+    pk->qy = pk->qx + en;
+    pk->qz = pk->qy + en;
+    pk->ux = pk->qz + en;
+    pk->uy = pk->ux + en;
+    pk->uz = pk->uy + en;
+    pk->uu = pk->uz + en;
+
+    pk->ny = pk->nx + sn;
+    pk->nz = pk->ny + sn;
+    pk->nd = pk->nz + sn;
+
+    /* Gather. */
+
+    vn = en = sn = 0;
+
+    for (i = 0; i < base->lc; i++)
+    {
+        const struct b_lump *lp = base->lv + i;
+
+        pk->lv[i].v0 = vn;
+        pk->lv[i].e0 = en;
+        pk->lv[i].s0 = sn;
+
+        for (j = 0; j < lp->vc; j++, vn++)
+        {
+            const float *p = base->vv[base->iv[lp->v0 + j]].p;
+
+            pk->vx[vn] = p[0];
+            pk->vy[vn] = p[1];
+            pk->vz[vn] = p[2];
+        }
+
+        for (j = 0; j < lp->ec; j++, en++)
+        {
+            const struct b_edge *ep = base->ev + base->iv[lp->e0 + j];
+
+            float u[3];
+
+            v_sub(u, base->vv[ep->vj].p, base->vv[ep->vi].p);
+
+            pk->qx[en] = base->vv[ep->vi].p[0];
+            pk->qy[en] = base->vv[ep->vi].p[1];
+            pk->qz[en] = base->vv[ep->vi].p[2];
+            pk->ux[en] = u[0];
+            pk->uy[en] = u[1];
+            pk->uz[en] = u[2];
+            pk->uu[en] = v_dot(u, u);
+        }
+
+        for (j = 0; j < lp->sc; j++, sn++)
+        {
+            const struct b_side *sp = base->sv + base->iv[lp->s0 + j];
+
+            pk->nx[sn] = sp->n[0];
+            pk->ny[sn] = sp->n[1];
+            pk->nz[sn] = sp->n[2];
+            pk->nd[sn] = sp->d;
+        }
+    }
+
+    return 1;
+}
+
+void sol_free_pack(struct s_pack *pk)
+{
+    free(pk->lv);
+    free(pk->vx);
+    free(pk->qx);
+    free(pk->nx);
+
+    memset(pk, 0, sizeof (*pk));
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Scalar lanes.  These follow v_sol, v_vert, v_edge and v_side in
+ * solid_sim_sol.c operation for operation.
+ */
+
+static float lane_sol(float px, float py, float pz,
+                      float vx, float vy, float vz, float r)
+{
+    float a = vx * vx + vy * vy + vz * vz;
+    float b = (vx * px + vy * py + vz * pz) * 2.0f;
+    float c = (px * px + py * py + pz * pz) - r * r;
+    float d = b * b - 4.0f * a * c;
+
+    if (a == 0.0f) return LARGE;
+
+    if      (d < 0.0f) return LARGE;
+    else if (d > 0.0f)
+    {
+        float t0 = 0.5f * (-b - fsqrtf(d)) / a;
+        float t1 = 0.5f * (-b + fsqrtf(d)) / a;
+        float t  = (t0 < t1) ? t0 : t1;
+
+        return (t < 0.0f) ? LARGE : t;
+    }
+    else return -b * 0.5f / a;
+}
+
+static float lane_vert(const struct s_pack *pk, int i,
+                       const float o[3], const float V[3],
+                       const float p[3], float r)
+{
+    float Px = p[0] - (o[0] + pk->vx[i]);
+    float Py = p[1] - (o[1] + pk->vy[i]);
+    float Pz = p[2] - (o[2] + pk->vz[i]);
+
+    if (Px * V[0] + Py * V[1] + Pz * V[2] < 0.0f)
+        return lane_sol(Px, Py, Pz, V[0], V[1], V[2], r);
+
+    return LARGE;
+}
+
+static float lane_edge(const struct s_pack *pk, int i,
+                       const float o[3], const float e[3],
+                       const float p[3], float r)
+{
+    float dx = (p[0] - o[0]) - pk->qx[i];
+    float dy = (p[1] - o[1]) - pk->qy[i];
+    float dz = (p[2] - o[2]) - pk->qz[i];
+
+    float ux = pk->ux[i];
+    float uy = pk->uy[i];
+    float uz = pk->uz[i];
+    float uu = pk->uu[i];
+
+    float du = dx * ux + dy * uy + dz * uz;
+    float eu = e[0] * ux + e[1] * uy + e[2] * uz;
+    float k  = -du / uu;
+
+    float Px = dx + ux * k;
+    float Py = dy + uy * k;
+    float Pz = dz + uz * k;
+
+    float s, t;
+
+    if (Px * Px + Py * Py + Pz * Pz < r * r)
+    {
+        if (du < 0 || du > uu)
+            return LARGE;
+
+        if (Px * e[0] + Py * e[1] + Pz * e[2] >= 0)
+            return LARGE;
+
+        return 0;
+    }
+
+    k = -eu / uu;
+
+    t = lane_sol(Px, Py, Pz, e[0] + ux * k, e[1] + uy * k, e[2] + uz * k, r);
+    s = (du + eu * t) / uu;
+
+    if (0.0f <= t && t < LARGE && 0.0f < s && s < 1.0f)
+        return t;
+
+    return LARGE;
+}
+
+static float lane_side(const struct s_pack *pk, int i,
+                       const float o[3], const float w[3],
+                       const float p[3], const float v[3], float r)
+{
+    float nx = pk->nx[i];
+    float ny = pk->ny[i];
+    float nz = pk->nz[i];
+
+    float vn = v[0] * nx + v[1] * ny + v[2] * nz;
+    float wn = w[0] * nx + w[1] * ny + w[2] * nz;
+
+    if (vn - wn < 0.0f)
+    {
+        float on = o[0] * nx + o[1] * ny + o[2] * nz;
+        float pn = p[0] * nx + p[1] * ny + p[2] * nz;
+
+        float u = (r + pk->nd[i] + on - pn) / (vn - wn);
+        float a = (    pk->nd[i] + on - pn) / (vn - wn);
+
+        if      (0.0f <= u) return u;
+        else if (0.0f <= a) return 0;
+    }
+    return LARGE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#if defined(PACK_SSE2) || defined(PACK_NEON)
+
+/*
+ * Four-wide vector lanes.  The same kernels are written once against
+ * these and compiled for either instruction set.
+ */
+
+#if defined(PACK_SSE2)
+
+typedef __m128 f4;
+typedef __m128 m4;
+
+#define f4_set(a)       _mm_set1_ps(a)
+#define f4_load(p)      _mm_loadu_ps(p)
+#define f4_store(p, a)  _mm_storeu_ps((p), (a))
+#define f4_add(a, b)    _mm_add_ps((a), (b))
+#define f4_sub(a, b)    _mm_sub_ps((a), (b))
+#define f4_mul(a, b)    _mm_mul_ps((a), (b))
+#define f4_div(a, b)    _mm_div_ps((a), (b))
+#define f4_sqrt(a)      _mm_sqrt_ps(a)
+#define f4_neg(a)       _mm_xor_ps((a), _mm_set1_ps(-0.0f))
+#define f4_lt(a, b)     _mm_cmplt_ps((a), (b))
+#define f4_le(a, b)     _mm_cmple_ps((a), (b))
+#define f4_gt(a, b)     _mm_cmpgt_ps((a), (b))
+#define f4_ge(a, b)     _mm_cmpge_ps((a), (b))
+#define f4_eq(a, b)     _mm_cmpeq_ps((a), (b))
+#define m4_and(a, b)    _mm_and_ps((a), (b))
+#define m4_or(a, b)     _mm_or_ps((a), (b))
+#define f4_sel(m, a, b) _mm_or_ps(_mm_and_ps((m), (a)), _mm_andnot_ps((m), (b)))
+
+#else
+
+typedef float32x4_t f4;
+typedef uint32x4_t  m4;
+
+#define f4_set(a)       vdupq_n_f32(a)
+#define f4_load(p)      vld1q_f32(p)
+#define f4_store(p, a)  vst1q_f32((p), (a))
+#define f4_add(a, b)    vaddq_f32((a), (b))
+#define f4_sub(a, b)    vsubq_f32((a), (b))
+#define f4_mul(a, b)    vmulq_f32((a), (b))
+#define f4_div(a, b)    vdivq_f32((a), (b))
+#define f4_sqrt(a)      vsqrtq_f32(a)
+#define f4_neg(a)       vnegq_f32(a)
+#define f4_lt(a, b)     vcltq_f32((a), (b))
+#define f4_le(a, b)     vcleq_f32((a), (b))
+#define f4_gt(a, b)     vcgtq_f32((a), (b))
+#define f4_ge(a, b)     vcgeq_f32((a), (b))
+#define f4_eq(a, b)     vceqq_f32((a), (b))
+#define m4_and(a, b)    vandq_u32((a), (b))
+#define m4_or(a, b)     vorrq_u32((a), (b))
+#define f4_sel(m, a, b) vbslq_f32((m), (a), (b))
+
+#endif
+
+#define f4_dot(ax, ay, az, bx, by, bz) \
+    f4_add(f4_add(f4_mul(ax, bx), f4_mul(ay, by)), f4_mul(az, bz))
+
+static f4 vec_sol(f4 px, f4 py, f4 pz, f4 vx, f4 vy, f4 vz, f4 r)
+{
+    const f4 zero  = f4_set(0.0f);
+    const f4 large = f4_set(LARGE);
+    const f4 half  = f4_set(0.5f);
+
+    f4 a = f4_dot(vx, vy, vz, vx, vy, vz);
+    f4 b = f4_mul(f4_dot(vx, vy, vz, px, py, pz), f4_set(2.0f));
+    f4 c = f4_sub(f4_dot(px, py, pz, px, py, pz), f4_mul(r, r));
+    f4 d = f4_sub(f4_mul(b, b), f4_mul(f4_mul(f4_set(4.0f), a), c));
+
+    f4 s  = f4_sqrt(d);
+    f4 nb = f4_neg(b);
+    f4 t0 = f4_div(f4_mul(half, f4_sub(nb, s)), a);
+    f4 t1 = f4_div(f4_mul(half, f4_add(nb, s)), a);
+    f4 t  = f4_sel(f4_lt(t0, t1), t0, t1);
+    f4 tz = f4_div(f4_mul(nb, half), a);
+
+    t = f4_sel(f4_lt(t, zero), large, t);
+    t = f4_sel(f4_gt(d, zero), t, tz);
+    t = f4_sel(m4_or(f4_eq(a, zero), f4_lt(d, zero)), large, t);
+
+    return t;
+}
+
+static f4 vec_vert(const struct s_pack *pk, int i,
+                   const float o[3], const float V[3],
+                   const float p[3], float r)
+{
+    f4 Vx = f4_set(V[0]);
+    f4 Vy = f4_set(V[1]);
+    f4 Vz = f4_set(V[2]);
+
+    f4 Px = f4_sub(f4_set(p[0]), f4_add(f4_set(o[0]), f4_load(pk->vx + i)));
+    f4 Py = f4_sub(f4_set(p[1]), f4_add(f4_set(o[1]), f4_load(pk->vy + i)));
+    f4 Pz = f4_sub(f4_set(p[2]), f4_add(f4_set(o[2]), f4_load(pk->vz + i)));
+
+    m4 m = f4_lt(f4_dot(Px, Py, Pz, Vx, Vy, Vz), f4_set(0.0f));
+
+    return f4_sel(m, vec_sol(Px, Py, Pz, Vx, Vy, Vz, f4_set(r)),
+                  f4_set(LARGE));
+}
+
+static f4 vec_edge(const struct s_pack *pk, int i,
+                   const float o[3], const float e[3],
+                   const float p[3], float r)
+{
+    const f4 zero  = f4_set(0.0f);
+    const f4 large = f4_set(LARGE);
+
+    f4 ex = f4_set(e[0]);
+    f4 ey = f4_set(e[1]);
+    f4 ez = f4_set(e[2]);
+    f4 rr = f4_set(r);
+
+    f4 dx = f4_sub(f4_set(p[0] - o[0]), f4_load(pk->qx + i));
+    f4 dy = f4_sub(f4_set(p[1] - o[1]), f4_load(pk->qy + i));
+    f4 dz = f4_sub(f4_set(p[2] - o[2]), f4_load(pk->qz + i));
+
+    f4 ux = f4_load(pk->ux + i);
+    f4 uy = f4_load(pk->uy + i);
+    f4 uz = f4_load(pk->uz + i);
+    f4 uu = f4_load(pk->uu + i);
+
+    f4 du = f4_dot(dx, dy, dz, ux, uy, uz);
+    f4 eu = f4_dot(ex, ey, ez, ux, uy, uz);
+    f4 k  = f4_div(f4_neg(du), uu);
+
+    f4 Px = f4_add(dx, f4_mul(ux, k));
+    f4 Py = f4_add(dy, f4_mul(uy, k));
+    f4 Pz = f4_add(dz, f4_mul(uz, k));
+
+    f4 t, s, ti;
+    m4 mi, mo;
+
+    /* The sphere already intersects the line of the edge. */
+
+    mi = f4_lt(f4_dot(Px, Py, Pz, Px, Py, Pz), f4_mul(rr, rr));
+    mo = m4_or(m4_or(f4_lt(du, zero), f4_gt(du, uu)),
+               f4_ge(f4_dot(Px, Py, Pz, ex, ey, ez), zero));
+    ti = f4_sel(mo, large, zero);
+
+    /* Otherwise, the sphere moves toward it. */
+
+    k = f4_div(f4_neg(eu), uu);
+
+    t = vec_sol(Px, Py, Pz,
+                f4_add(ex, f4_mul(ux, k)),
+                f4_add(ey, f4_mul(uy, k)),
+                f4_add(ez, f4_mul(uz, k)), rr);
+    s = f4_div(f4_add(du, f4_mul(eu, t)), uu);
+
+    t = f4_sel(m4_and(m4_and(f4_le(zero, t), f4_lt(t, large)),
+                      m4_and(f4_lt(zero, s), f4_lt(s, f4_set(1.0f)))),
+               t, large);
+
+    return f4_sel(mi, ti, t);
+}
+
+static f4 vec_side(const struct s_pack *pk, int i,
+                   const float o[3], const float w[3],
+                   const float p[3], const float v[3], float r)
+{
+    const f4 zero  = f4_set(0.0f);
+    const f4 large = f4_set(LARGE);
+
+    f4 nx = f4_load(pk->nx + i);
+    f4 ny = f4_load(pk->ny + i);
+    f4 nz = f4_load(pk->nz + i);
+    f4 nd = f4_load(pk->nd + i);
+
+    f4 vn = f4_dot(f4_set(v[0]), f4_set(v[1]), f4_set(v[2]), nx, ny, nz);
+    f4 wn = f4_dot(f4_set(w[0]), f4_set(w[1]), f4_set(w[2]), nx, ny, nz);
+    f4 on = f4_dot(f4_set(o[0]), f4_set(o[1]), f4_set(o[2]), nx, ny, nz);
+    f4 pn = f4_dot(f4_set(p[0]), f4_set(p[1]), f4_set(p[2]), nx, ny, nz);
+
+    f4 vw = f4_sub(vn, wn);
+
+    f4 u = f4_div(f4_sub(f4_add(f4_add(f4_set(r), nd), on), pn), vw);
+    f4 a = f4_div(f4_sub(f4_add(nd, on), pn), vw);
+
+    f4 t = f4_sel(f4_le(zero, a), zero, large);
+
+    t = f4_sel(f4_le(zero, u), u, t);
+
+    return f4_sel(f4_lt(vw, zero), t, large);
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+const char *pack_simd(void)
+{
+#if defined(PACK_SSE2)
+    return "sse2";
+#elif defined(PACK_NEON)
+    return "neon";
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * Keep the first of the earliest times.
+ */
+static void pack_min(float u, int k, float *t, int *j)
+{
+    if (*j < 0 || u < *t)
+    {
+        *t = u;
+        *j = k;
+    }
+}
+
+int pack_vert(const struct s_pack *pk, int simd, int i, int n,
+              const float o[3], const float w[3],
+              const float p[3], const float v[3], float r, float *t)
+{
+    float V[3];
+    int j = -1, k = 0;
+
+    v_sub(V, v, w);
+
+#if defined(PACK_SSE2) || defined(PACK_NEON)
+    if (simd)
+        for (; k + 4 <= n; k += 4)
+        {
+            float u[4];
+            int l;
+
+            f4_store(u, vec_vert(pk, i + k, o, V, p, r));
+
+            for (l = 0; l < 4; l++)
+                pack_min(u[l], k + l, t, &j);
+        }
+#endif
+
+    for (; k < n; k++)
+        pack_min(lane_vert(pk, i + k, o, V, p, r), k, t, &j);
+    return j;
+}
+
+int pack_edge(const struct s_pack *pk, int simd, int i, int n,
+              const float o[3], const float w[3],
+              const float p[3], const float v[3], float r, float *t)
+{
+    float e[3];
+    int j = -1, k = 0;
+
+    v_sub(e, v, w);
+
+#if defined(PACK_SSE2) || defined(PACK_NEON)
+    if (simd)
+        for (; k + 4 <= n; k += 4)
+        {
+            float u[4];
+            int l;
+
+            f4_store(u, vec_edge(pk, i + k, o, e, p, r));
+
+            for (l = 0; l < 4; l++)
+                pack_min(u[l], k + l, t, &j);
+        }
+#endif
+
+    for (; k < n; k++)
+        pack_min(lane_edge(pk, i + k, o, e, p, r), k, t, &j);
+    return j;
+}
+
+void pack_side(const struct s_pack *pk, int simd, int i, int n,
+               const float o[3], const float w[3],
+               const float p[3], const float v[3], float r, float *t)
+{
+    int k = 0;
+
+#if defined(PACK_SSE2) || defined(PACK_NEON)
+    if (simd)
+        for (; k + 4 <= n; k += 4)
+            f4_store(t + k, vec_side(pk, i + k, o, w, p, v, r));
+#endif
+
+    for (; k < n; k++)
+        t[k] = lane_side(pk, i + k, o, w, p, v, r);
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef SOLID_PACK_H
+#define SOLID_PACK_H
+
+#include "solid_base.h"
+
+/*
+ * Packed lump geometry for the collision kernels.
+ *
+ * The vertices, edges and sides of every lump are gathered out of the
+ * index array into  contiguous structure-of-arrays storage, so  that a
+ * lump's primitives can be tested several at a time.  Lump L owns the
+ * elements starting at lv[L].v0, lv[L].e0 and lv[L].s0; the counts are
+ * those of the b_lump.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+struct p_lump
+{
+    int v0;
+    int e0;
+    int s0;
+};
+
+struct s_pack
+{
+    const struct s_base *base;
+
+    struct p_lump *lv;
+
+    float *vx, *vy, *vz;                       /* vertex positions           */
+    float *qx, *qy, *qz;                       /* edge start points          */
+    float *ux, *uy, *uz;                       /* edge vectors               */
+    float *uu;                                 /* edge squared lengths       */
+    float *nx, *ny, *nz;                       /* side normals               */
+    float *nd;                                 /* side distances             */
+
+    int sm;                                    /* most sides in any lump     */
+};
+
+int  sol_load_pack(struct s_pack *, const struct s_base *);
+void sol_free_pack(struct s_pack *);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Each kernel tests N consecutive primitives starting at I against a
+ * sphere of radius R moving along V from P.  The primitives move along
+ * W in a coordinate system based at O.
+ *
+ * pack_vert and pack_edge return the index of the first primitive with
+ * the earliest time of impact, storing that time in T, or -1 if N is
+ * zero.  pack_side stores all N times in T, which must have room for
+ * SM of them.  The pack itself is never written, so any number of
+ * simulations may share one.
+ *
+ * With SIMD set, the kernels process four primitives per instruction
+ * where the build supports it.  The arithmetic is the same as in the
+ * scalar code, in the same order, so the times agree bit for bit.  The
+ * build compiles both with -ffp-contract=off to keep it that way.
+ */
+
+const char *pack_simd(void);
+
+int  pack_vert(const struct s_pack *, int simd, int i, int n,
+               const float o[3], const float w[3],
+               const float p[3], const float v[3], float r, float *t);
+int  pack_edge(const struct s_pack *, int simd, int i, int n,
+               const float o[3], const float w[3],
+               const float p[3], const float v[3], float r, float *t);
+void pack_side(const struct s_pack *, int simd, int i, int n,
+               const float o[3], const float w[3],
+               const float p[3], const float v[3], float r, float *t);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
@@ -20,12 +20,68 @@
 
 /*---------------------------------------------------------------------------*/
 
-void sol_init_sim(struct s_vary *);
-void sol_quit_sim(void);
+/*
+ * sol_init_sim sets up the simulation state of an s_vary, which
+ * sol_quit_sim releases.  PACK is the packed geometry of the s_base,
+ * built by the caller and left alone until sol_quit_sim, or NULL to
+ * have the simulation pack its own.  Nothing else is shared, so any
+ * thread may init, step and quit its own s_vary while others do the
+ * same with theirs, as long as they only read the s_base and PACK.
+ */
+
+struct s_pack;
+
+int  sol_init_sim(struct s_vary *, const struct s_pack *);
+void sol_quit_sim(struct s_vary *);
 
 void  sol_move(struct s_vary *, cmd_fn, float);
 float sol_step(struct s_vary *, cmd_fn, const float *, float, int, int *);
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Collision counters of an s_vary, accumulated across its sol_step
+ * calls.
+ */
+
+struct sol_stats
+{
+    unsigned long step;                 /* sol_step calls                    */
+    unsigned long iter;                 /* Collision iterations              */
+    unsigned long body;                 /* Body tests                        */
+    unsigned long node;                 /* BSP node visits                   */
+    unsigned long cull;                 /* BSP subtrees outside bounds       */
+    unsigned long seed;                 /* Searches seeded by last contact   */
+    unsigned long xfrm;                 /* Mover transform lookups           */
+    unsigned long xmiss;                /* Mover transform cache misses      */
+    unsigned long lump;                 /* Solid lump tests                  */
+    unsigned long test;                 /* Vertex, edge and side tests       */
+};
+
+void sol_stats_get(const struct s_vary *, struct sol_stats *);
+void sol_stats_clr(struct s_vary *);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Lump test implementation, for all simulations.  The packed kernels
+ * test primitives out of contiguous arrays built by sol_init_sim and
+ * shared by all s_varys of an s_base; SIMD additionally processes
+ * four at a time where SSE2 or NEON is available.  All three give the
+ * same results, which solbench can confirm by replay.
+ */
+
+enum
+{
+    SOL_KERNEL_SCALAR = 0,
+    SOL_KERNEL_PACKED,
+    SOL_KERNEL_SIMD
+};
+
+void        sol_set_kernel(int);
+int         sol_get_kernel(void);
+const char *sol_kernel_name(void);
+
+/*---------------------------------------------------------------------------*/
+
 #endif
@@ -12,7 +12,9 @@
  * General Public License for more details.
  */
 
+#include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "vec3.h"
 #include "common.h"
@@ -20,10 +22,214 @@
 #include "solid_vary.h"
 #include "solid_sim.h"
 #include "solid_all.h"
+#include "solid_pack.h"
 
 #define LARGE 1.0e+5f
 #define SMALL 1.0e-3f
 
+enum
+{
+    HIT_VERT = 0,
+    HIT_EDGE,
+    HIT_SIDE
+};
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Mover transforms for the collision tests.  Movers stand still while
+ * a substep is being tested, so the position, orientation and rotation
+ * flag of each are computed once and shared by every query.  Velocity
+ * and final orientation depend on the length of the tested interval
+ * and are kept for the last interval asked for.  Moving time forward
+ * starts a new generation, which invalidates the whole table.
+ */
+
+struct m_xfrm
+{
+    unsigned int gen;                          /* generation of the entry    */
+
+    float p[3];                                /* position                   */
+    float e[4];                                /* orientation                */
+    int   w;                                   /* rotation flag              */
+
+    float vt;                                  /* interval of V              */
+    float v[3];                                /* linear velocity            */
+    float ft;                                  /* interval of F              */
+    float f[4];                                /* orientation after FT       */
+};
+
+/*
+ * Simulation state of one s_vary.  Everything that changes while
+ * stepping lives here or in the s_vary, so that separate simulations
+ * may be stepped on separate threads.
+ */
+
+struct s_sim
+{
+    struct sol_stats stats;
+
+    const struct s_pack *pack;                 /* packed geometry            */
+    struct s_pack  *own;                       /* ... if not the caller's    */
+    float          *tv;                        /* side time scratch          */
+
+    struct m_xfrm  *xv;                        /* mover transforms           */
+    int             xc;
+    unsigned int    xgen;
+};
+
+static int kernel = SOL_KERNEL_SIMD;
+
+static const struct m_xfrm xfrm_none = {
+    0, { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 0.0f }, 0
+};
+
+void sol_stats_get(const struct s_vary *vary, struct sol_stats *dst)
+{
+    if (vary->sim)
+        *dst = vary->sim->stats;
+    else
+        memset(dst, 0, sizeof (*dst));
+}
+
+void sol_stats_clr(struct s_vary *vary)
+{
+    if (vary->sim)
+        memset(&vary->sim->stats, 0, sizeof (vary->sim->stats));
+}
+
+/*---------------------------------------------------------------------------*/
+
+void sol_set_kernel(int k)
+{
+    kernel = k;
+}
+
+int sol_get_kernel(void)
+{
+    return kernel;
+}
+
+const char *sol_kernel_name(void)
+{
+    switch (kernel)
+    {
+    case SOL_KERNEL_SCALAR: return "scalar";
+    case SOL_KERNEL_PACKED: return "packed";
+    case SOL_KERNEL_SIMD:   return pack_simd() ? pack_simd() : "packed";
+    }
+    return "unknown";
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void sol_xfrm_next(struct s_sim *sim)
+{
+    if (++sim->xgen == 0)
+    {
+        if (sim->xv)
+            memset(sim->xv, 0, sim->xc * sizeof (*sim->xv));
+        sim->xgen = 1;
+    }
+}
+
+/*
+ * Bring the entry of mover MI up to date.  Returns 1 if it was stale.
+ */
+static int sol_xfrm_load(const struct s_vary *vary, int mi)
+{
+    struct s_sim  *sim = vary->sim;
+    struct m_xfrm *xp  = sim->xv + mi;
+
+    if (xp->gen == sim->xgen)
+        return 0;
+
+    sol_body_p(xp->p, vary, mi, 0.0f);
+    sol_body_e(xp->e, vary, mi, 0.0f);
+
+    xp->w   = sol_body_w(vary, mi);
+    xp->vt  = -1.0f;
+    xp->ft  = -1.0f;
+    xp->gen = sim->xgen;
+
+    return 1;
+}
+
+static const struct m_xfrm *sol_xfrm(const struct s_vary *vary, int mi)
+{
+    struct s_sim *sim = vary->sim;
+
+    if (mi < 0 || mi >= sim->xc)
+        return &xfrm_none;
+
+    sim->stats.xfrm++;
+
+    if (sol_xfrm_load(vary, mi))
+        sim->stats.xmiss++;
+
+    return sim->xv + mi;
+}
+
+static void sol_xfrm_v(float v[3], const struct s_vary *vary, int mi, float dt)
+{
+    struct s_sim  *sim = vary->sim;
+    struct m_xfrm *xp;
+    int miss;
+
+    if (mi < 0 || mi >= sim->xc)
+    {
+        sol_body_v(v, vary, mi, dt);
+        return;
+    }
+
+    xp = sim->xv + mi;
+
+    sim->stats.xfrm++;
+
+    miss = sol_xfrm_load(vary, mi);
+
+    if (xp->vt != dt)
+    {
+        sol_body_v(xp->v, vary, mi, dt);
+        xp->vt = dt;
+        miss = 1;
+    }
+    if (miss)
+        sim->stats.xmiss++;
+
+    v_cpy(v, xp->v);
+}
+
+static void sol_xfrm_f(float e[4], const struct s_vary *vary, int mi, float dt)
+{
+    struct s_sim  *sim = vary->sim;
+    struct m_xfrm *xp;
+    int miss;
+
+    if (mi < 0 || mi >= sim->xc)
+    {
+        sol_body_e(e, vary, mi, dt);
+        return;
+    }
+
+    xp = sim->xv + mi;
+
+    sim->stats.xfrm++;
+
+    miss = sol_xfrm_load(vary, mi);
+
+    if (xp->ft != dt)
+    {
+        sol_body_e(xp->f, vary, mi, dt);
+        xp->ft = dt;
+        miss = 1;
+    }
+    if (miss)
+        sim->stats.xmiss++;
+
+    q_cpy(e, xp->f);
+}
+
 /*---------------------------------------------------------------------------*/
 /* Solves (p + v * t) . (p + v * t) == r * r for smallest t.                 */
 
@@ -398,8 +604,117 @@ static int sol_test_back(float dt,
 
 /*---------------------------------------------------------------------------*/
 
-static float sol_test_lump(float dt,
-                           float T[3],
+/*
+ * Test the swept ball against a sphere at C moving with velocity W.
+ * Returns 0 if they cannot meet within DT.
+ */
+static int sol_test_sphere(float dt,
+                           const struct v_ball *up,
+                           const float c[3], float r,
+                           const float w[3])
+{
+    float p[3], v[3], t, vv;
+
+    r += up->r + SMALL;
+
+    /* Find the time of closest approach in the sphere's frame. */
+
+    v_sub(p, up->p, c);
+    v_sub(v, up->v, w);
+
+    t  = 0.0f;
+    vv = v_dot(v, v);
+
+    if (vv > 0.0f)
+    {
+        t = -v_dot(p, v) / vv;
+        t = CLAMP(0.0f, t, dt);
+    }
+
+    v_mad(p, p, v, t);
+
+    return (v_dot(p, p) <= r * r);
+}
+
+/*
+ * Test a lump using the packed geometry.  The kernels only find the
+ * candidates; each winner is evaluated again by the code above, so the
+ * result matches the unpacked test exactly.
+ */
+static float sol_test_pack(struct s_sim *sim, float dt,
+                           float T[3], struct v_hit *H,
+                           const struct v_ball *up,
+                           const struct s_base *base,
+                           const struct b_lump *lp,
+                           const float o[3],
+                           const float w[3])
+{
+    const struct s_pack *pack = sim->pack;
+    const struct p_lump *pl = pack->lv + (lp - base->lv);
+    const int simd = (kernel == SOL_KERNEL_SIMD);
+
+    float U[3] = { 0.0f, 0.0f, 0.0f };
+    float u, t = dt;
+    int i;
+
+    if (up->r > 0.0f)
+    {
+        /* Test all verts */
+
+        if ((i = pack_vert(pack, simd, pl->v0, lp->vc,
+                           o, w, up->p, up->v, up->r, &u)) >= 0 && u < t)
+        {
+            const struct b_vert *vp = base->vv + base->iv[lp->v0 + i];
+
+            if ((u = sol_test_vert(t, U, up, vp, o, w)) < t)
+            {
+                v_cpy(T, U);
+                H->k = HIT_VERT;
+                H->i = i;
+                t = u;
+            }
+        }
+
+        /* Test all edges */
+
+        if ((i = pack_edge(pack, simd, pl->e0, lp->ec,
+                           o, w, up->p, up->v, up->r, &u)) >= 0 && u < t)
+        {
+            const struct b_edge *ep = base->ev + base->iv[lp->e0 + i];
+
+            if ((u = sol_test_edge(t, U, up, base, ep, o, w)) < t)
+            {
+                v_cpy(T, U);
+                H->k = HIT_EDGE;
+                H->i = i;
+                t = u;
+            }
+        }
+    }
+
+    /* Test all sides */
+
+    pack_side(pack, simd, pl->s0, lp->sc, o, w, up->p, up->v, up->r, sim->tv);
+
+    for (i = 0; i < lp->sc; i++)
+        if (sim->tv[i] < t)
+        {
+            const struct b_side *sp = base->sv + base->iv[lp->s0 + i];
+
+            if ((u = sol_test_side(t, U, up, base, lp, sp, o, w)) < t)
+            {
+                v_cpy(T, U);
+                H->k = HIT_SIDE;
+                H->i = i;
+                t = u;
+            }
+        }
+
+    return t;
+}
+
+static float sol_test_lump(struct s_sim *sim, float dt,
+                           float T[3], struct v_hit *H,
                            const struct v_ball *up,
                            const struct s_base *base,
                            const struct b_lump *lp,
@@ -414,6 +729,15 @@ static float sol_test_lump(float dt,
 
     if (lp->fl & L_DETAIL) return t;
 
+    sim->stats.lump++;
+    sim->stats.test += lp->sc;
+
+    if (up->r > 0.0f)
+        sim->stats.test += lp->vc + lp->ec;
+
+    if (kernel != SOL_KERNEL_SCALAR && sim->pack && sim->pack->base == base)
+        return sol_test_pack(sim, dt, T, H, up, base, lp, o, w);
+
     /* Test all verts */
 
     if (up->r > 0.0f)
@@ -424,6 +748,8 @@ static float sol_test_lump(float dt,
             if ((u = sol_test_vert(t, U, up, vp, o, w)) < t)
             {
                 v_cpy(T, U);
+                H->k = HIT_VERT;
+                H->i = i;
                 t = u;
             }
         }
@@ -438,6 +764,8 @@ static float sol_test_lump(float dt,
             if ((u = sol_test_edge(t, U, up, base, ep, o, w)) < t)
             {
                 v_cpy(T, U);
+                H->k = HIT_EDGE;
+                H->i = i;
                 t = u;
             }
         }
@@ -451,32 +779,53 @@ static float sol_test_lump(float dt,
         if ((u = sol_test_side(t, U, up, base, lp, sp, o, w)) < t)
         {
             v_cpy(T, U);
+            H->k = HIT_SIDE;
+            H->i = i;
             t = u;
         }
     }
     return t;
 }
 
-static float sol_test_node(float dt,
-                           float T[3],
+static float sol_test_node(struct s_sim *sim, float dt,
+                           float T[3], struct v_hit *H,
                            const struct v_ball *up,
                            const struct s_base *base,
                            const struct b_node *np,
                            const float o[3],
                            const float w[3])
 {
-    float U[3], u, t = dt;
+    float U[3], c[3], u, t = dt;
+    struct v_hit G;
     int i;
 
+    /* Skip the subtree if the ball cannot reach its bounds. */
+
+    if (np->r >= 0.0f)
+    {
+        v_add(c, o, np->c);
+
+        if (!sol_test_sphere(dt, up, c, np->r, w))
+        {
+            sim->stats.cull++;
+            return t;
+        }
+    }
+
+    sim->stats.node++;
+
     /* Test all lumps */
 
     for (i = 0; i < np->lc; i++)
     {
         const struct b_lump *lp = base->lv + np->l0 + i;
 
-        if ((u = sol_test_lump(t, U, up, base, lp, o, w)) < t)
+        if ((u = sol_test_lump(sim, t, U, &G, up, base, lp, o, w)) < t)
         {
             v_cpy(T, U);
+            H->li = np->l0 + i;
+            H->k  = G.k;
+            H->i  = G.i;
             t = u;
         }
     }
@@ -487,9 +836,10 @@ static float sol_test_node(float dt,
     {
         const struct b_node *nq = base->nv + np->ni;
 
-        if ((u = sol_test_node(t, U, up, base, nq, o, w)) < t)
+        if ((u = sol_test_node(sim, t, U, &G, up, base, nq, o, w)) < t)
         {
             v_cpy(T, U);
+            *H = G;
             t = u;
         }
     }
@@ -500,9 +850,10 @@ static float sol_test_node(float dt,
     {
         const struct b_node *nq = base->nv + np->nj;
 
-        if ((u = sol_test_node(t, U, up, base, nq, o, w)) < t)
+        if ((u = sol_test_node(sim, t, U, &G, up, base, nq, o, w)) < t)
         {
             v_cpy(T, U);
+            *H = G;
             t = u;
         }
     }
@@ -510,19 +861,45 @@ static float sol_test_node(float dt,
     return t;
 }
 
+/*
+ * Test the swept ball against the swept bounding sphere of a body at
+ * O moving with velocity W.
+ */
+static int sol_test_bound(float dt,
+                          const struct v_ball *up,
+                          const struct v_body *bp,
+                          const float O[3],
+                          const float W[3])
+{
+    float c[3];
+
+    if (bp->r < 0.0f)
+        return 0;
+
+    /* A rotating body sweeps a sphere about its origin. */
+
+    if (bp->mj >= 0)
+        return sol_test_sphere(dt, up, O, v_len(bp->c) + bp->r, W);
+
+    v_add(c, O, bp->c);
+
+    return sol_test_sphere(dt, up, c, bp->r, W);
+}
+
 static float sol_test_body(float dt,
-                           float T[3], float V[3],
+                           float T[3], float V[3], struct v_hit *H,
                            const struct v_ball *up,
                            const struct s_vary *vary,
-                           const struct v_body *bp)
+                           const struct v_body *bp,
+                           const float O[3],
+                           const float W[3])
 {
-    float U[3], O[3], E[4], W[3], u;
+    float U[3], u;
 
     const struct b_node *np = vary->base->nv + bp->base->ni;
+    const struct m_xfrm *xp = sol_xfrm(vary, bp->mj);
 
-    sol_body_p(O, vary, bp->mi, 0.0f);
-    sol_body_v(W, vary, bp->mi, dt);
-    sol_body_e(E, vary, bp->mj, 0.0f);
+    vary->sim->stats.body++;
 
     /*
      * For rotating bodies, rather than rotate every normal and vertex
@@ -535,7 +912,7 @@ static float sol_test_body(float dt,
      * v = w x p
      */
 
-    if (E[0] != 1.0f || sol_body_w(vary, bp->mj))
+    if (xp->e[0] != 1.0f || xp->w)
     {
         /* The body has a non-identity orientation or it is rotating. */
 
@@ -547,12 +924,12 @@ static float sol_test_body(float dt,
 
         v_sub(p0, up->p, O);
         v_cpy(p1, p0);
-        q_conj(e, E);
+        q_conj(e, xp->e);
         q_rot(p0, e, p0);
 
         v_mad(p1, p1, up->v, dt);
         v_mad(p1, p1, W, -dt);
-        sol_body_e(e, vary, bp->mj, dt);
+        sol_xfrm_f(e, vary, bp->mj, dt);
         q_conj(e, e);
         q_rot(p1, e, p1);
 
@@ -567,7 +944,7 @@ static float sol_test_body(float dt,
         v_sub(ball.v, p1, p0);
         v_scl(ball.v, ball.v, 1.0f / dt);
 
-        if ((u = sol_test_node(dt, U, &ball, vary->base, np, z, z)) < dt)
+        if ((u = sol_test_node(vary->sim, dt, U, H, &ball, vary->base, np, z, z)) < dt)
         {
             /* Compute the final orientation. */
 
@@ -592,7 +969,7 @@ static float sol_test_body(float dt,
     }
     else
     {
-        if ((u = sol_test_node(dt, U, up, vary->base, np, O, W)) < dt)
+        if ((u = sol_test_node(vary->sim, dt, U, H, up, vary->base, np, O, W)) < dt)
         {
             v_cpy(T, U);
             v_cpy(V, W);
@@ -602,25 +979,132 @@ static float sol_test_body(float dt,
     return dt;
 }
 
-static float sol_test_file(float dt,
+/*
+ * Find the path and enable flag that currently move a body.
+ */
+static void sol_hit_path(int *pi, int *f,
+                         const struct s_vary *vary,
+                         const struct v_body *bp)
+{
+    *pi = -1;
+    *f  =  0;
+
+    if (bp->mi >= 0 && (*pi = vary->mv[bp->mi].pi) >= 0)
+        *f = vary->pv[*pi].f;
+}
+
+/*
+ * Test the ball's last contact on its own.  A hit there bounds the
+ * search of the whole file, so that the BSP tests cull more of it.
+ * Contacts with rotating bodies are not used.
+ */
+static float sol_test_seed(float dt,
                            float T[3], float V[3],
                            const struct v_ball *up,
                            const struct s_vary *vary)
 {
-    float U[3], W[3], u, t = dt;
-    int i;
+    const struct v_hit  *hp = &up->hit;
+    const struct v_body *bp;
+    const struct b_lump *lp;
+    const struct s_base *base = vary->base;
+
+    const struct m_xfrm *xp;
+
+    float O[3], W[3], U[3], u = dt;
+    int pi, f;
+
+    if (hp->bi < 0 || hp->bi >= vary->bc)
+        return dt;
+
+    bp = vary->bv + hp->bi;
+    lp = base->lv + hp->li;
+
+    /* The body's path has changed since. */
+
+    sol_hit_path(&pi, &f, vary, bp);
+
+    if (pi != hp->pi || f != hp->f)
+        return dt;
+
+    xp = sol_xfrm(vary, bp->mj);
+
+    if (xp->e[0] != 1.0f || xp->w)
+        return dt;
+
+    v_cpy(O, sol_xfrm(vary, bp->mi)->p);
+    sol_xfrm_v(W, vary, bp->mi, dt);
+
+    switch (hp->k)
+    {
+    case HIT_VERT:
+        if (up->r > 0.0f)
+            u = sol_test_vert(dt, U, up, base->vv + base->iv[lp->v0 + hp->i],
+                              O, W);
+        break;
+
+    case HIT_EDGE:
+        if (up->r > 0.0f)
+            u = sol_test_edge(dt, U, up, base,
+                              base->ev + base->iv[lp->e0 + hp->i], O, W);
+        break;
+
+    case HIT_SIDE:
+        u = sol_test_side(dt, U, up, base, lp,
+                          base->sv + base->iv[lp->s0 + hp->i], O, W);
+        break;
+    }
+
+    if (u < dt)
+    {
+        vary->sim->stats.seed++;
+
+        v_cpy(T, U);
+        v_cpy(V, W);
+        return u;
+    }
+    return dt;
+}
+
+static float sol_test_file(float dt,
+                           float T[3], float V[3],
+                           struct v_ball *up,
+                           const struct s_vary *vary)
+{
+    float U[3], W[3], O[3], B[3], u, t;
+    struct v_hit H;
+    int i, hi = -1;
+
+    t = sol_test_seed(dt, T, V, up, vary);
 
     for (i = 0; i < vary->bc; i++)
     {
         const struct v_body *bp = vary->bv + i;
 
-        if ((u = sol_test_body(t, U, W, up, vary, bp)) < t)
+        v_cpy(O, sol_xfrm(vary, bp->mi)->p);
+        sol_xfrm_v(B, vary, bp->mi, t);
+
+        if (!sol_test_bound(t, up, bp, O, B))
+            continue;
+
+        if ((u = sol_test_body(t, U, W, &H, up, vary, bp, O, B)) < t)
         {
             v_cpy(T, U);
             v_cpy(V, W);
+            up->hit.li = H.li;
+            up->hit.k  = H.k;
+            up->hit.i  = H.i;
+            hi = i;
             t = u;
         }
     }
+
+    /* Remember the contact for the next search. */
+
+    if (hi >= 0)
+    {
+        up->hit.bi = hi;
+        sol_hit_path(&up->hit.pi, &up->hit.f, vary, vary->bv + hi);
+    }
     return t;
 }
 
@@ -664,30 +1148,10 @@ static int ms_peek(float *accum, float dt)
  */
 static float sol_path_time(struct s_vary *vary, float dt)
 {
-    int mi, xi;
+    int ms = sol_sched_next(vary);
 
-    for (mi = 0; mi < vary->mc; mi++)
-    {
-        struct v_move *mp = vary->mv + mi;
-        struct v_path *pp = vary->pv + mp->pi;
-
-        if (!pp->f)
-            continue;
-
-        if (mp->tm + ms_peek(&vary->ms_accum, dt) > pp->base->tm)
-            dt = MS_TO_TIME(pp->base->tm - mp->tm);
-    }
-
-    for (xi = 0; xi < vary->xc; xi++)
-    {
-        struct v_swch *xp = vary->xv + xi;
-
-        if (xp->tm >= xp->base->tm)
-            continue;
-
-        if (xp->tm + ms_peek(&vary->ms_accum, dt) > xp->base->tm)
-            dt = MS_TO_TIME(xp->base->tm - xp->tm);
-    }
+    if (ms >= 0 && ms < ms_peek(&vary->ms_accum, dt))
+        return MS_TO_TIME(ms);
 
     return dt;
 }
@@ -711,6 +1175,9 @@ static void sol_move_once(struct s_vary *vary, cmd_fn cmd_func, float dt)
     sol_move_step(vary, cmd_func, dt, ms);
     sol_swch_step(vary, cmd_func, dt, ms);
     sol_ball_step(vary, cmd_func, dt);
+
+    if (vary->sim)
+        sol_xfrm_next(vary->sim);
 }
 
 /*
@@ -720,6 +1187,11 @@ void sol_move(struct s_vary *vary, cmd_fn cmd_func, float dt)
 {
     if (vary && vary->base)
     {
+        /* Bodies that are only drawn get their schedule here. */
+
+        if (vary->sched.n != vary->mc + vary->xc)
+            sol_init_sched(vary);
+
         while (dt > 0.0f)
         {
             float pt = sol_path_time(vary, dt);
@@ -743,10 +1215,24 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
     float P[3], V[3], v[3], r[3], a[3], d, nt, b = 0.0f, tt = dt;
     int c;
 
-    if (ui < vary->uc)
+    if (ui < vary->uc && vary->sim)
     {
         struct v_ball *up = vary->uv + ui;
 
+        vary->sim->stats.step++;
+
+        /* Movers may have been changed since the last step. */
+
+        sol_xfrm_next(vary->sim);
+
+        /* Forget the last contact if the ball was moved or resized. */
+
+        if (up->r    != up->hit.r    ||
+            up->p[0] != up->hit.p[0] ||
+            up->p[1] != up->hit.p[1] ||
+            up->p[2] != up->hit.p[2])
+            up->hit.bi = -1;
+
         /* If the ball is in contact with a surface, apply friction. */
 
         v_cpy(a, up->v);
@@ -795,6 +1281,8 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
         {
             float pt;
 
+            vary->sim->stats.iter++;
+
             /* Avoid stepping across path changes. */
 
             pt = sol_path_time(vary, tt);
@@ -818,6 +1306,9 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
         v_sub(a, up->v, a);
 
         sol_pendulum(up, a, g, dt);
+
+        v_cpy(up->hit.p, up->p);
+        up->hit.r = up->r;
     }
 
     return b;
@@ -825,14 +1316,70 @@ float sol_step(struct s_vary *vary, cmd_fn cmd_func,
 
 /*---------------------------------------------------------------------------*/
 
-void sol_init_sim(struct s_vary *vary)
+int sol_init_sim(struct s_vary *vary, const struct s_pack *pack)
 {
+    struct s_sim *sim;
+    int ui;
+
     ms_init(&vary->ms_accum);
+
+    if (!sol_init_sched(vary))
+        return 0;
+
+    for (ui = 0; ui < vary->uc; ui++)
+        vary->uv[ui].hit.bi = -1;
+
+    sol_quit_sim(vary);
+
+    if (!(sim = calloc(1, sizeof (*sim))))
+        return 0;
+
+    /* Without packed geometry, lumps are tested the scalar way. */
+
+    if (pack && pack->base == vary->base)
+        sim->pack = pack;
+    else if ((sim->own = calloc(1, sizeof (*sim->own))))
+    {
+        if (sol_load_pack(sim->own, vary->base))
+            sim->pack = sim->own;
+        else
+        {
+            free(sim->own);
+            sim->own = NULL;
+        }
+    }
+
+    if (sim->pack && !(sim->tv = malloc(MAX(sim->pack->sm, 1) * sizeof (float))))
+        sim->pack = NULL;
+
+    if (vary->mc && (sim->xv = calloc(vary->mc, sizeof (*sim->xv))))
+        sim->xc = vary->mc;
+
+    sim->xgen = 1;
+
+    vary->sim = sim;
+
+    return 1;
 }
 
-void sol_quit_sim(void)
+void sol_quit_sim(struct s_vary *vary)
 {
-    return;
+    struct s_sim *sim = vary->sim;
+
+    if (sim)
+    {
+        if (sim->own)
+        {
+            sol_free_pack(sim->own);
+            free(sim->own);
+        }
+
+        free(sim->tv);
+        free(sim->xv);
+        free(sim);
+
+        vary->sim = NULL;
+    }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -13,6 +13,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "solid_vary.h"
 #include "common.h"
@@ -63,6 +64,80 @@ static void setup_mover(struct alloc *alloc, const struct s_vary *fp, int pi, in
     }
 }
 
+/*
+ * Compute a bounding sphere for the solid lumps of a body, in body
+ * space.  A body without solid lumps gets a negative radius.
+ */
+static void setup_bounds(const struct s_base *base,
+                         const struct b_body *bq,
+                         float c[3], float *r)
+{
+    float bmin[3] = { 0.0f, 0.0f, 0.0f };
+    float bmax[3] = { 0.0f, 0.0f, 0.0f };
+    float d[3];
+    int n = 0, i, j;
+
+    for (i = 0; i < bq->lc; i++)
+    {
+        const struct b_lump *lp = base->lv + bq->l0 + i;
+
+        if (lp->fl & L_DETAIL)
+            continue;
+
+        for (j = 0; j < lp->vc; j++, n++)
+        {
+            const float *p = base->vv[base->iv[lp->v0 + j]].p;
+
+            if (n == 0)
+            {
+                v_cpy(bmin, p);
+                v_cpy(bmax, p);
+            }
+            else
+            {
+                bmin[0] = MIN(bmin[0], p[0]);
+                bmin[1] = MIN(bmin[1], p[1]);
+                bmin[2] = MIN(bmin[2], p[2]);
+                bmax[0] = MAX(bmax[0], p[0]);
+                bmax[1] = MAX(bmax[1], p[1]);
+                bmax[2] = MAX(bmax[2], p[2]);
+            }
+        }
+    }
+
+    c[0] = 0.0f;
+    c[1] = 0.0f;
+    c[2] = 0.0f;
+
+    *r = -1.0f;
+
+    if (n > 0)
+    {
+        v_add(c, bmin, bmax);
+        v_scl(c, c, 0.5f);
+
+        *r = 0.0f;
+
+        for (i = 0; i < bq->lc; i++)
+        {
+            const struct b_lump *lp = base->lv + bq->l0 + i;
+
+            if (lp->fl & L_DETAIL)
+                continue;
+
+            for (j = 0; j < lp->vc; j++)
+            {
+                v_sub(d, base->vv[base->iv[lp->v0 + j]].p, c);
+
+                if (*r < v_dot(d, d))
+                    *r = v_dot(d, d);
+            }
+        }
+
+        *r = fsqrtf(*r);
+    }
+}
+
 int sol_load_vary(struct s_vary *fp, struct s_base *base)
 {
     struct alloc mover_alloc;
@@ -104,6 +179,8 @@ int sol_load_vary(struct s_vary *fp, struct s_base *base)
 
             bp->base = bq;
 
+            setup_bounds(fp->base, bq, bp->c, &bp->r);
+
             setup_mover(&mover_alloc, fp, bq->p0, &bp->mi);
             setup_mover(&mover_alloc, fp, bq->p1, &bp->mj);
         }
@@ -215,6 +292,8 @@ int sol_load_vary(struct s_vary *fp, struct s_base *base)
 
             up->size = 1;
 
+            up->hit.bi = -1;
+
             up->E[0][0] = up->e[0][0] = 1.0f;
             up->E[0][1] = up->e[0][1] = 0.0f;
             up->E[0][2] = up->e[0][2] = 0.0f;
@@ -244,6 +323,10 @@ void sol_free_vary(struct s_vary *fp)
     free(fp->rv);
     free(fp->uv);
 
+    free(fp->sched.hv);
+    free(fp->sched.tv);
+    free(fp->sched.iv);
+
     memset(fp, 0, sizeof (*fp));
 }
 
@@ -282,6 +365,147 @@ void set_move_dirty(const struct s_vary *vary, int mi, unsigned int dirty)
 
 /*---------------------------------------------------------------------------*/
 
+struct snap_head
+{
+    int pc;
+    int mc;
+    int hc;
+    int xc;
+    int uc;
+    int sn;
+
+    float ms_accum;
+
+    int sched_ms;
+    int sched_hc;
+};
+
+static size_t snap_size(const struct s_vary *fp)
+{
+    return (sizeof (struct snap_head) +
+            sizeof (*fp->pv) * fp->pc +
+            sizeof (*fp->mv) * fp->mc +
+            sizeof (*fp->hv) * fp->hc +
+            sizeof (*fp->xv) * fp->xc +
+            sizeof (*fp->uv) * fp->uc +
+            sizeof (int) * fp->sched.n * 3);
+}
+
+static unsigned char *snap_put(unsigned char *p, const void *src, size_t n)
+{
+    if (n)
+        memcpy(p, src, n);
+    return p + n;
+}
+
+static const unsigned char *snap_get(void *dst, const unsigned char *p, size_t n)
+{
+    if (n)
+        memcpy(dst, p, n);
+    return p + n;
+}
+
+/*
+ * Allocate a snapshot buffer large enough for FP, so that taking
+ * snapshots of it never allocates.
+ */
+int sol_load_snap(struct s_snap *sp, const struct s_vary *fp)
+{
+    size_t size = snap_size(fp);
+
+    if (sp->cap < size)
+    {
+        unsigned char *data;
+
+        if (!(data = realloc(sp->data, size)))
+            return 0;
+
+        sp->data = data;
+        sp->cap  = size;
+    }
+    return 1;
+}
+
+void sol_free_snap(struct s_snap *sp)
+{
+    free(sp->data);
+    memset(sp, 0, sizeof (*sp));
+}
+
+int sol_vary_snapshot(struct s_snap *sp, const struct s_vary *fp)
+{
+    struct snap_head head;
+    unsigned char *p;
+
+    if (!sol_load_snap(sp, fp))
+        return 0;
+
+    head.pc = fp->pc;
+    head.mc = fp->mc;
+    head.hc = fp->hc;
+    head.xc = fp->xc;
+    head.uc = fp->uc;
+    head.sn = fp->sched.n;
+
+    head.ms_accum = fp->ms_accum;
+
+    head.sched_ms = fp->sched.ms;
+    head.sched_hc = fp->sched.hc;
+
+    p = sp->data;
+
+    p = snap_put(p, &head, sizeof (head));
+    p = snap_put(p, fp->pv, sizeof (*fp->pv) * fp->pc);
+    p = snap_put(p, fp->mv, sizeof (*fp->mv) * fp->mc);
+    p = snap_put(p, fp->hv, sizeof (*fp->hv) * fp->hc);
+    p = snap_put(p, fp->xv, sizeof (*fp->xv) * fp->xc);
+    p = snap_put(p, fp->uv, sizeof (*fp->uv) * fp->uc);
+    p = snap_put(p, fp->sched.hv, sizeof (int) * fp->sched.n);
+    p = snap_put(p, fp->sched.tv, sizeof (int) * fp->sched.n);
+    p = snap_put(p, fp->sched.iv, sizeof (int) * fp->sched.n);
+
+    sp->size = p - sp->data;
+
+    return 1;
+}
+
+int sol_vary_restore(struct s_vary *fp, const struct s_snap *sp)
+{
+    struct snap_head head;
+    const unsigned char *p;
+
+    if (!sp->data || sp->size != snap_size(fp))
+        return 0;
+
+    p = snap_get(&head, sp->data, sizeof (head));
+
+    if (head.pc != fp->pc ||
+        head.mc != fp->mc ||
+        head.hc != fp->hc ||
+        head.xc != fp->xc ||
+        head.uc != fp->uc ||
+        head.sn != fp->sched.n)
+        return 0;
+
+    p = snap_get(fp->pv, p, sizeof (*fp->pv) * fp->pc);
+    p = snap_get(fp->mv, p, sizeof (*fp->mv) * fp->mc);
+    p = snap_get(fp->hv, p, sizeof (*fp->hv) * fp->hc);
+    p = snap_get(fp->xv, p, sizeof (*fp->xv) * fp->xc);
+    p = snap_get(fp->uv, p, sizeof (*fp->uv) * fp->uc);
+    p = snap_get(fp->sched.hv, p, sizeof (int) * fp->sched.n);
+    p = snap_get(fp->sched.tv, p, sizeof (int) * fp->sched.n);
+    p = snap_get(fp->sched.iv, p, sizeof (int) * fp->sched.n);
+
+    fp->ms_accum = head.ms_accum;
+
+    fp->sched.ms = head.sched_ms;
+    fp->sched.hc = head.sched_hc;
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
 int sol_vary_cmd(struct s_vary *fp, struct cmd_state *cs, const union cmd *cmd)
 {
     struct v_ball *up;
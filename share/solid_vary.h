@@ -27,6 +27,8 @@
 #define GROW_BIG   1.5f                 /* large factor                      */
 #define GROW_SMALL 0.5f                 /* small factor                      */
 
+#define ITEM_RADIUS 0.15f
+
 /*---------------------------------------------------------------------------*/
 
 struct v_path
@@ -43,6 +45,9 @@ struct v_body
 {
     const struct b_body *base;
 
+    float c[3];                                /* bounding sphere center     */
+    float r;                                   /* bounding sphere radius     */
+
     int mi;
     int mj;
 };
@@ -101,6 +106,24 @@ struct v_bill
     int mj;
 };
 
+/*
+ * A ball's last contact, used by the simulation to seed the next
+ * collision search.  The position, radius and path record the state
+ * the contact was found in; a mismatch invalidates it.
+ */
+struct v_hit
+{
+    int   bi;                                  /* body, or -1 if none        */
+    int   li;                                  /* lump                       */
+    int   k;                                   /* vertex, edge or side       */
+    int   i;                                   /* index within the lump      */
+
+    float p[3];                                /* ball position              */
+    float r;                                   /* ball radius                */
+    int   pi;                                  /* path of the body mover     */
+    int   f;                                   /* path enable flag           */
+};
+
 struct v_ball
 {
     float e[3][3];                             /* basis of orientation       */
@@ -113,8 +136,28 @@ struct v_ball
     float r_vel;                               /* radius velocity            */
     float sizes[3];                            /* sizes (small, base, big)   */
     short size;                                /* current size (0, 1, 2)     */
+
+    struct v_hit hit;                          /* last contact               */
+};
+
+/*
+ * Upcoming path and switch transitions, kept as a binary min-heap by
+ * the millisecond at which each is due.  Entry I < MC is mover I and
+ * entry MC + I is switch I.
+ */
+struct v_sched
+{
+    int  ms;                                   /* milliseconds elapsed       */
+    int  n;                                    /* number of entries          */
+
+    int  hc;                                   /* heap size                  */
+    int *hv;                                   /* heap of entries            */
+    int *tv;                                   /* deadline of each entry     */
+    int *iv;                                   /* heap slot of each entry    */
 };
 
+struct s_sim;
+
 struct s_vary
 {
     struct s_base *base;
@@ -142,6 +185,12 @@ struct s_vary
     /* Accumulator for tracking time in integer milliseconds. */
 
     float ms_accum;
+
+    struct v_sched sched;
+
+    /* Simulation state, managed by sol_init_sim and sol_quit_sim. */
+
+    struct s_sim *sim;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -154,6 +203,29 @@ void set_move_dirty(const struct s_vary *vary, int mi, unsigned int dirty);
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Saved copy of the varying SOL data.  Only what changes during play
+ * is kept: paths, movers, items, switches, balls and the timers.  The
+ * base data and the fixed body, goal, jump and billboard records stay
+ * with the s_vary.  A snapshot can be restored into the s_vary it was
+ * taken from, or into another one loaded from the same s_base.
+ */
+
+struct s_snap
+{
+    size_t size;                               /* bytes in use               */
+    size_t cap;                                /* bytes allocated            */
+    unsigned char *data;
+};
+
+int  sol_load_snap(struct s_snap *, const struct s_vary *);
+void sol_free_snap(struct s_snap *);
+
+int  sol_vary_snapshot(struct s_snap *, const struct s_vary *);
+int  sol_vary_restore (struct s_vary *, const struct s_snap *);
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Buffers changes to the varying SOL data for interpolation purposes.
  */
@@ -0,0 +1,559 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vec3.h"
+#include "array.h"
+#include "cmd.h"
+#include "common.h"
+
+#include "solid_world.h"
+#include "solid_sim.h"
+#include "solid_all.h"
+
+/*---------------------------------------------------------------------------*/
+
+const float GRAVITY_UP[] = { 0.0f, +9.8f, 0.0f };
+const float GRAVITY_DN[] = { 0.0f, -9.8f, 0.0f };
+
+void game_tilt_init(struct game_tilt *tilt)
+{
+    tilt->x[0] = 1.0f;
+    tilt->x[1] = 0.0f;
+    tilt->x[2] = 0.0f;
+
+    tilt->rx = 0.0f;
+
+    tilt->z[0] = 0.0f;
+    tilt->z[1] = 0.0f;
+    tilt->z[2] = 1.0f;
+
+    tilt->rz = 0.0f;
+}
+
+void game_tilt_grav(float h[3], const float g[3], const struct game_tilt *tilt)
+{
+    float X[16];
+    float Z[16];
+    float M[16];
+
+    /* Compute the gravity vector from the given world rotations. */
+
+    m_rot (Z, tilt->z, V_RAD(tilt->rz));
+    m_rot (X, tilt->x, V_RAD(tilt->rx));
+    m_mult(M, Z, X);
+    m_vxfm(h, M, g);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int world_init(struct s_world *w, struct s_base *base,
+               const struct s_pack *pack, cmd_fn cmd_func,
+               float time_limit, int goal_e)
+{
+    memset(w, 0, sizeof (*w));
+
+    if (!sol_load_vary(&w->vary, base))
+        return 0;
+
+    if (!sol_init_sim(&w->vary, pack))
+    {
+        sol_free_vary(&w->vary);
+        return 0;
+    }
+
+    w->cmd        = cmd_func;
+    w->status     = GAME_NONE;
+    w->goal_e     = goal_e ? 1 : 0;
+    w->time_limit = time_limit;
+    w->jump_e     = 1;
+    w->jump_b     = 0;
+    w->hash       = 2166136261u;
+
+    return 1;
+}
+
+void world_free(struct s_world *w)
+{
+    sol_quit_sim(&w->vary);
+    sol_free_vary(&w->vary);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void world_cmd(const struct s_world *w, const union cmd *cmd)
+{
+    if (w->cmd)
+        w->cmd(cmd);
+}
+
+static void world_cmd_updball(const struct s_world *w)
+{
+    const struct v_ball *up = w->vary.uv;
+    union cmd cmd;
+
+    cmd.type = CMD_BALL_POSITION;
+    v_cpy(cmd.ballpos.p, up->p);
+    world_cmd(w, &cmd);
+
+    cmd.type = CMD_BALL_BASIS;
+    v_cpy(cmd.ballbasis.e[0], up->e[0]);
+    v_cpy(cmd.ballbasis.e[1], up->e[1]);
+    world_cmd(w, &cmd);
+
+    cmd.type = CMD_BALL_PEND_BASIS;
+    v_cpy(cmd.ballpendbasis.E[0], up->E[0]);
+    v_cpy(cmd.ballpendbasis.E[1], up->E[1]);
+    world_cmd(w, &cmd);
+}
+
+static void world_cmd_ballradius(const struct s_world *w)
+{
+    union cmd cmd;
+
+    cmd.type         = CMD_BALL_RADIUS;
+    cmd.ballradius.r = w->vary.uv->r;
+    world_cmd(w, &cmd);
+}
+
+static void world_cmd_pkitem(const struct s_world *w, int hi)
+{
+    union cmd cmd;
+
+    cmd.type      = CMD_PICK_ITEM;
+    cmd.pkitem.hi = hi;
+    world_cmd(w, &cmd);
+}
+
+static void world_cmd_jump(const struct s_world *w, int e)
+{
+    union cmd cmd;
+
+    cmd.type = e ? CMD_JUMP_ENTER : CMD_JUMP_EXIT;
+    world_cmd(w, &cmd);
+}
+
+static void world_cmd_timer(const struct s_world *w)
+{
+    union cmd cmd;
+
+    cmd.type    = CMD_TIMER;
+    cmd.timer.t = w->timer;
+    world_cmd(w, &cmd);
+}
+
+static void world_cmd_coins(const struct s_world *w)
+{
+    union cmd cmd;
+
+    cmd.type    = CMD_COINS;
+    cmd.coins.n = w->coins;
+    world_cmd(w, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int grow_init(struct s_world *w, int type)
+{
+    struct v_ball *up = w->vary.uv;
+
+    int size = up->size;
+
+    if (type == ITEM_SHRINK)
+        size--;
+    else if (type == ITEM_GROW)
+        size++;
+
+    size = CLAMP(0, size, 2);
+
+    if (size != up->size)
+    {
+        const int old_size = up->size;
+
+        up->r_vel = (up->sizes[size] - up->r) / GROW_TIME;
+        up->size = size;
+
+        if (size < old_size)
+            return -1;
+
+        if (size > old_size)
+            return +1;
+    }
+
+    return 0;
+}
+
+static void grow_step(struct s_world *w, float dt)
+{
+    struct v_ball *up = w->vary.uv;
+
+    if (up->r_vel != 0.0f)
+    {
+        float r, dr;
+
+        /* Calculate new size based on how long since you touched the coin... */
+
+        r = up->r + up->r_vel * dt;
+
+        if ((up->r < up->sizes[up->size] && r >= up->sizes[up->size]) ||
+            (up->r > up->sizes[up->size] && r <= up->sizes[up->size]))
+        {
+            r = up->sizes[up->size];
+            up->r_vel = 0.0f;
+        }
+
+        dr = r - up->r;
+
+        /* No sinking through the floor! Keeps ball's bottom constant. */
+
+        up->p[1] += dr;
+        up->r     = r;
+
+        world_cmd_ballradius(w);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static unsigned int world_hash(unsigned int h, const void *p, size_t n)
+{
+    const unsigned char *c = p;
+
+    while (n--)
+        h = (h ^ *c++) * 16777619u;
+
+    return h;
+}
+
+static void world_move(struct s_world *w, const float g[3],
+                       const struct game_tilt *tilt, float dt)
+{
+    struct v_ball *up = w->vary.uv;
+    float h[3];
+
+    grow_step(w, dt);
+
+    game_tilt_grav(h, g, tilt);
+
+    if (w->jump_b > 0)
+    {
+        w->jump_dt += dt;
+
+        /* Handle a jump. */
+
+        if (w->jump_dt >= 0.5f)
+        {
+            /* Note the exact instant of the jump. */
+
+            if (w->jump_b == 1)
+            {
+                w->events |= WORLD_LEAP;
+                w->jump_b = 2;
+            }
+
+            /* Translate ball and hold it at the destination. */
+
+            v_cpy(up->p, w->jump_p);
+        }
+
+        if (w->jump_dt >= 1.0f)
+            w->jump_b = 0;
+    }
+    else
+    {
+        /* Run the sim. */
+
+        w->bump = sol_step(&w->vary, w->cmd, h, dt, 0, NULL);
+
+        w->hash = world_hash(w->hash, up->p, sizeof (up->p));
+        w->hash = world_hash(w->hash, up->v, sizeof (up->v));
+    }
+
+    world_cmd_updball(w);
+}
+
+static void world_update_time(struct s_world *w, float dt, int b)
+{
+    if (b)
+    {
+        w->time_elapsed += dt;
+
+        if (w->time_limit > 0.0f && w->time_elapsed > w->time_limit)
+            w->time_elapsed = w->time_limit;
+
+        /* Something that works for both timed and untimed levels. */
+
+        w->timer = fabsf(w->time_limit - w->time_elapsed);
+
+        world_cmd_timer(w);
+    }
+}
+
+static int world_update_state(struct s_world *w, int bt)
+{
+    struct s_vary *vary = &w->vary;
+    int hi;
+
+    /* Test for an item. */
+
+    if (bt && (hi = sol_item_test(vary, NULL, ITEM_RADIUS)) != -1)
+    {
+        struct v_item *hp = vary->hv + hi;
+
+        world_cmd_pkitem(w, hi);
+
+        if (hp->t == ITEM_COIN)
+        {
+            w->coins += hp->n;
+            world_cmd_coins(w);
+        }
+        else if (hp->t == ITEM_CLOCK)
+        {
+            const float value = (float) hp->n;
+
+            w->events |= WORLD_CLOCK;
+
+            /* For timed levels, increase the effective time limit. */
+            /* For untimed levels, reduce time elapsed for a better highscore. */
+
+            if (w->time_limit > 0.0f)
+                w->time_limit = w->time_limit + value;
+            else
+                w->time_elapsed = MAX(0.0f, w->time_elapsed - value);
+
+            world_update_time(w, 0.0f, bt);
+        }
+        else if (hp->t == ITEM_GROW || hp->t == ITEM_SHRINK)
+        {
+            switch (grow_init(w, hp->t))
+            {
+                case -1: w->events |= WORLD_SHRINK; break;
+                case +1: w->events |= WORLD_GROW;   break;
+            }
+        }
+
+        w->events |= WORLD_ITEM;
+
+        /* Discard item. */
+
+        hp->t = ITEM_NONE;
+    }
+
+    /* Test for a switch. */
+
+    if (sol_swch_test(vary, w->cmd, 0) == SWCH_INSIDE)
+        w->events |= WORLD_SWITCH;
+
+    /* Test for a jump. */
+
+    if (w->jump_e == 1 && w->jump_b == 0 && (sol_jump_test(vary, w->jump_p, 0) ==
+                                             JUMP_INSIDE))
+    {
+        w->jump_b  = 1;
+        w->jump_e  = 0;
+        w->jump_dt = 0.f;
+
+        w->events |= WORLD_JUMP;
+
+        world_cmd_jump(w, 1);
+    }
+    if (w->jump_e == 0 && w->jump_b == 0 && (sol_jump_test(vary, w->jump_p, 0) ==
+                                             JUMP_OUTSIDE))
+    {
+        w->jump_e = 1;
+        world_cmd_jump(w, 0);
+    }
+
+    /* Test for a goal. */
+
+    if (bt && w->goal_e && sol_goal_test(vary, NULL, 0))
+        return GAME_GOAL;
+
+    /* Test for time-out. */
+
+    if (bt && w->time_limit > 0.0f && w->time_elapsed >= w->time_limit)
+        return GAME_TIME;
+
+    /* Test for fall-out. */
+
+    if (bt && (vary->base->vc == 0 || vary->uv[0].p[1] < vary->base->vv[0].p[1]))
+        return GAME_FALL;
+
+    return GAME_NONE;
+}
+
+/*
+ * Run one update of the world with the given floor rotation.  After
+ * the goal or a fall-out the ball keeps moving, but the rules no
+ * longer change the outcome; after a time-out nothing moves.  Returns
+ * 1 if this update decided the outcome.
+ */
+int world_step(struct s_world *w, const struct game_tilt *tilt, float dt)
+{
+    w->events = 0;
+    w->bump   = 0.0f;
+
+    if (w->vary.uc == 0)
+        return 0;
+
+    switch (w->status)
+    {
+    case GAME_GOAL:
+        world_move(w, GRAVITY_UP, tilt, dt);
+        world_update_state(w, 0);
+        break;
+
+    case GAME_FALL:
+        world_move(w, GRAVITY_DN, tilt, dt);
+        world_update_state(w, 0);
+        break;
+
+    case GAME_NONE:
+        world_move(w, GRAVITY_DN, tilt, dt);
+        world_update_time(w, dt, 1);
+
+        return (w->status = world_update_state(w, 1)) != GAME_NONE;
+    }
+    return 0;
+}
+
+/*
+ * Open the goal.
+ */
+void world_goal(struct s_world *w)
+{
+    union cmd cmd;
+
+    w->goal_e = 1;
+
+    cmd.type = CMD_GOAL_OPEN;
+    world_cmd(w, &cmd);
+}
+
+/*
+ * Return the time taken, in centiseconds, as the replay header and the
+ * level scores keep it.
+ */
+int world_timer(const struct s_world *w)
+{
+    return (int) (w->time_elapsed * 100.0f);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Read the input of a replay from its command stream.  Tilt is taken
+ * as the server takes it, around the recorded tilt axes or, from
+ * Neverball <= 1.5.1, around the view vectors.  The goal is opened
+ * between updates, so it is recorded ahead of the step it applies to.
+ */
+int world_script_read(struct w_script *sp, fs_file fp, int version)
+{
+    struct cmd_stream cs;
+    union cmd cmd;
+
+    float view_x[3] = { 1.0f, 0.0f, 0.0f };
+    float view_z[3] = { 0.0f, 0.0f, 1.0f };
+
+    struct w_input in, *ip;
+    Array inputs;
+
+    int got_axes = 0;
+    int first    = 1;
+
+    memset(sp, 0, sizeof (*sp));
+
+    if (!(inputs = array_new(sizeof (struct w_input))))
+        return 0;
+
+    memset(&in, 0, sizeof (in));
+
+    game_tilt_init(&in.tilt);
+
+    sp->dt = 1.0f / 90.0f;
+
+    cmd_stream_init(&cs, version);
+
+    while (cmd_get_stream(fp, &cs, &cmd))
+    {
+        switch (cmd.type)
+        {
+        case CMD_UPDATES_PER_SECOND:
+            if (cmd.ups.n > 0)
+                sp->dt = 1.0f / cmd.ups.n;
+            break;
+
+        case CMD_TILT_AXES:
+            got_axes = 1;
+            v_cpy(in.tilt.x, cmd.tiltaxes.x);
+            v_cpy(in.tilt.z, cmd.tiltaxes.z);
+            break;
+
+        case CMD_TILT_ANGLES:
+            if (!got_axes)
+            {
+                v_cpy(in.tilt.x, view_x);
+                v_cpy(in.tilt.z, view_z);
+            }
+            in.tilt.rx = cmd.tiltangles.x;
+            in.tilt.rz = cmd.tiltangles.z;
+            break;
+
+        case CMD_VIEW_BASIS:
+            v_cpy(view_x, cmd.viewbasis.e[0]);
+            v_crs(view_z, cmd.viewbasis.e[0], cmd.viewbasis.e[1]);
+            break;
+
+        case CMD_GOAL_OPEN:
+            in.goal = 1;
+            break;
+
+        case CMD_END_OF_UPDATE:
+            if (first)
+            {
+                sp->goal_e = in.goal;
+                first = 0;
+            }
+            else if ((ip = array_add(inputs)))
+                *ip = in;
+
+            in.goal = 0;
+            break;
+
+        default:
+            break;
+        }
+        cmd_clear(&cmd);
+    }
+
+    if ((sp->ic = array_len(inputs)) &&
+        (sp->iv = malloc(sp->ic * sizeof (*sp->iv))))
+        memcpy(sp->iv, array_get(inputs, 0), sp->ic * sizeof (*sp->iv));
+    else
+        sp->ic = 0;
+
+    array_free(inputs);
+
+    return 1;
+}
+
+void world_script_free(struct w_script *sp)
+{
+    free(sp->iv);
+    memset(sp, 0, sizeof (*sp));
+}
+
+/*---------------------------------------------------------------------------*/
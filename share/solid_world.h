@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef SOLID_WORLD_H
+#define SOLID_WORLD_H
+
+#include "solid_vary.h"
+#include "solid_all.h"
+#include "fs.h"
+
+struct s_pack;
+
+/*
+ * The game world of the ball server: the varying SOL data, its
+ * simulation and the game rules, with the state they keep.  The game
+ * server steps one of these and so do the headless tools, so that a
+ * replay plays out the same in both.
+ *
+ * A world only reads its s_base and the s_pack given to world_init,
+ * which the caller builds and keeps until world_free.  Nothing else is
+ * shared, so separate worlds may be created, stepped and freed on
+ * separate threads.  Commands describing each step go to the cmd_fn
+ * given at init, if any.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Outcome of a game.
+ */
+enum
+{
+    GAME_NONE = 0,
+
+    GAME_TIME,
+    GAME_GOAL,
+    GAME_FALL,
+
+    GAME_MAX
+};
+
+extern const float GRAVITY_UP[];
+extern const float GRAVITY_DN[];
+
+struct game_tilt
+{
+    float x[3], rx;
+    float z[3], rz;
+};
+
+void game_tilt_init(struct game_tilt *);
+void game_tilt_grav(float h[3], const float g[3], const struct game_tilt *);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * What happened during the last step, for the sounds and the camera.
+ */
+enum
+{
+    WORLD_ITEM   = (1 << 0),            /* An item was picked up             */
+    WORLD_CLOCK  = (1 << 1),            /* ... which was a clock             */
+    WORLD_GROW   = (1 << 2),            /* ... which grew the ball           */
+    WORLD_SHRINK = (1 << 3),            /* ... which shrank the ball         */
+    WORLD_SWITCH = (1 << 4),            /* The ball entered a switch         */
+    WORLD_JUMP   = (1 << 5),            /* The ball entered a jump           */
+    WORLD_LEAP   = (1 << 6)             /* The jump moved the ball           */
+};
+
+struct s_world
+{
+    struct s_vary vary;
+
+    cmd_fn cmd;
+
+    int   status;                       /* Outcome of the game               */
+    int   coins;                        /* Collected coins                   */
+    int   goal_e;                       /* Goal enabled flag                 */
+    float time_limit;                   /* Effective time limit              */
+    float time_elapsed;                 /* Time elapsed                      */
+    float timer;                        /* Clock                             */
+
+    int   jump_e;                       /* Jumping enabled flag              */
+    int   jump_b;                       /* Jump-in-progress flag             */
+    float jump_dt;                      /* Jump duration                     */
+    float jump_p[3];                    /* Jump destination                  */
+
+    int   events;                       /* Events of the last step           */
+    float bump;                         /* Bounce of the last step           */
+
+    unsigned int hash;                  /* FNV-1a of the ball after steps    */
+};
+
+int  world_init(struct s_world *, struct s_base *, const struct s_pack *,
+                cmd_fn, float time_limit, int goal_e);
+void world_free(struct s_world *);
+
+int  world_step(struct s_world *, const struct game_tilt *, float dt);
+void world_goal(struct s_world *);
+int  world_timer(const struct s_world *);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Input to one step, as recorded.
+ */
+struct w_input
+{
+    struct game_tilt tilt;
+    int goal;                           /* The goal opened before the step   */
+};
+
+/*
+ * The input of a replay: one input for each update after the first,
+ * which is the initial state.
+ */
+struct w_script
+{
+    int   goal_e;                       /* Goal open from the start          */
+    float dt;
+
+    struct w_input *iv;
+    int             ic;
+};
+
+int  world_script_read(struct w_script *, fs_file, int version);
+void world_script_free(struct w_script *);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
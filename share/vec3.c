@@ -15,6 +15,10 @@
 #include <stdio.h>
 #include <math.h>
 
+#if ENABLE_MATH_FAST && defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 #include "vec3.h"
 
 #define A 10
@@ -28,6 +32,43 @@
 
 /*---------------------------------------------------------------------------*/
 
+#if ENABLE_MATH_FAST
+
+/*
+ * Approximate 1 / sqrt(x), refined with one Newton-Raphson step.
+ */
+static float frsqrtf(float x)
+{
+#if defined(__SSE__)
+    float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+    float y = 1.0f / sqrtf(x);
+#endif
+    return y * (1.5f - 0.5f * x * y * y);
+}
+
+void v_nrm_f(float *n, const float *v)
+{
+    float d = v_dot(v, v);
+
+    if (d == 0.0f)
+    {
+        n[0] = 0.0f;
+        n[1] = 0.0f;
+        n[2] = 0.0f;
+    }
+    else
+    {
+        d = frsqrtf(d);
+
+        n[0] = v[0] * d;
+        n[1] = v[1] * d;
+        n[2] = v[2] * d;
+    }
+}
+
+#else
+
 void v_nrm_f(float *n, const float *v)
 {
     float d = v_len_f(v);
@@ -46,6 +87,8 @@ void v_nrm_f(float *n, const float *v)
     }
 }
 
+#endif
+
 void v_nrm_d(double *n, const double *v)
 {
     double d = v_len_d(v);
@@ -263,6 +306,26 @@ void q_by_axisangle(float q[4], const float u[3], float a)
 
 void q_nrm(float q[4], const float r[4])
 {
+#if ENABLE_MATH_FAST
+    float d = q_dot(r, r);
+
+    if (d == 0.0f)
+    {
+        q[0] = 1.0f;
+        q[1] = 0.0f;
+        q[2] = 0.0f;
+        q[3] = 0.0f;
+    }
+    else
+    {
+        d = frsqrtf(d);
+
+        q[0] = r[0] * d;
+        q[1] = r[1] * d;
+        q[2] = r[2] * d;
+        q[3] = r[3] * d;
+    }
+#else
     float d = q_len(r);
 
     if (d == 0.0f)
@@ -279,6 +342,7 @@ void q_nrm(float q[4], const float r[4])
         q[2] = r[2] / d;
         q[3] = r[3] / d;
     }
+#endif
 }
 
 void q_mul(float q[4], const float a[4], const float b[4])
@@ -22,6 +22,26 @@
 #define V_RAD(d) ((d) * V_PI / 180.f)
 #define V_DEG(r) ((r) * 180.f / V_PI)
 
+/*
+ * Scalar math backend, chosen at build time with ENABLE_MATH.  The
+ * default goes through the double precision functions.  "float" and
+ * "fast" use the C99 single precision functions; "fast" also
+ * normalizes with an approximate reciprocal square root.
+ */
+
+#if ENABLE_MATH_FLOAT || ENABLE_MATH_FAST
+
+#define fsinf(a)      sinf(a)
+#define fcosf(a)      cosf(a)
+#define ftanf(a)      tanf(a)
+#define fsqrtf(a)     sqrtf(a)
+#define fpowf(x,y)    powf((x), (y))
+#define fasinf(a)     asinf(a)
+#define facosf(a)     acosf(a)
+#define fatan2f(x, y) atan2f((x), (y))
+
+#else
+
 #define fsinf(a)      ((float) sin((double) (a)))
 #define fcosf(a)      ((float) cos((double) (a)))
 #define ftanf(a)      ((float) tan((double) (a)))
@@ -33,6 +53,8 @@
 #define fmodf(x,y)    ((float) fmod((double) (x), (double) (y)))
 #define fatan2f(x, y) ((float) atan2((double) (x), (double) (y)))
 
+#endif
+
 #define flerp(f0, f1, a) ((f0) + ((f1) - (f0)) * (a))
 
 /*---------------------------------------------------------------------------*/
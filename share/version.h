@@ -0,0 +1,4 @@
+#ifndef VERSION_H
+#define VERSION_H 1
+#define VERSION "1.6.0"
+#endif
@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "writer.h"
+#include "common.h"
+#include "zip.h"
+#include "fs.h"
+#include "log.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define WRITER_BLOCK (64 * 1024)
+#define WRITER_OPS   64                 /* Requests in flight, 4 MiB         */
+
+enum
+{
+    OP_WRITE,
+    OP_PATCH,
+    OP_DEFLATE,
+    OP_CLOSE
+};
+
+struct op
+{
+    int type;
+
+    unsigned char *block;               /* Bytes to write                    */
+    int            size;
+
+    long          pos;                  /* Where to patch                    */
+    unsigned char patch[WRITER_PATCH_MAX];
+
+    tdefl_compressor *defl;             /* What to deflate with from now on  */
+
+    void (*fn)(void *);                 /* What to run after closing         */
+    void  *data;
+};
+
+/*
+ * Counters of a single-producer, single-consumer ring.  Each end moves
+ * only its own counter, after a barrier that publishes what it did to
+ * the slot.
+ */
+struct ring
+{
+    SDL_atomic_t head;                  /* Next slot to take                 */
+    SDL_atomic_t tail;                  /* Next slot to fill                 */
+};
+
+struct writer
+{
+    fs_file fp;
+    int     failed;
+
+    tdefl_compressor *defl;             /* Deflating, on the writer thread   */
+
+    /* Requests, from the caller to the writer thread. */
+
+    struct op   ops[WRITER_OPS];
+    struct ring op_ring;
+
+    /* Written blocks, from the writer thread back to the caller. */
+
+    unsigned char *free_v[WRITER_OPS];
+    struct ring    free_ring;
+
+    /* The block being filled. */
+
+    unsigned char *block;
+    int            len;
+
+    long put;                           /* Bytes put so far                  */
+    long raw;                           /* Bytes put before deflating, or -1 */
+
+    SDL_sem    *wake;                   /* A request was queued              */
+    SDL_sem    *done;                   /* The file is closed                */
+    SDL_Thread *thread;
+};
+
+static unsigned int ring_len(struct ring *rp)
+{
+    return (unsigned int) SDL_AtomicGet(&rp->tail) -
+           (unsigned int) SDL_AtomicGet(&rp->head);
+}
+
+static void ring_fill(struct ring *rp)
+{
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicAdd(&rp->tail, 1);
+}
+
+static void ring_take(struct ring *rp)
+{
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicAdd(&rp->head, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static unsigned char *block_get(struct writer *w)
+{
+    unsigned char *block;
+
+    if (ring_len(&w->free_ring))
+    {
+        SDL_MemoryBarrierAcquire();
+        block = w->free_v[SDL_AtomicGet(&w->free_ring.head) % WRITER_OPS];
+        ring_take(&w->free_ring);
+        return block;
+    }
+    return malloc(WRITER_BLOCK);
+}
+
+static void block_put(struct writer *w, unsigned char *block)
+{
+    if (ring_len(&w->free_ring) < WRITER_OPS)
+    {
+        w->free_v[SDL_AtomicGet(&w->free_ring.tail) % WRITER_OPS] = block;
+        ring_fill(&w->free_ring);
+    }
+    else free(block);
+}
+
+/*
+ * Write bytes to the file, as they are or as deflated.
+ */
+static mz_bool writer_out(const void *data, int size, void *user)
+{
+    struct writer *w = user;
+
+    if (!w->failed && fs_write(data, size, w->fp) != size)
+    {
+        log_printf("Failure to write replay data: %s\n", fs_error());
+        w->failed = 1;
+    }
+    return !w->failed;
+}
+
+static void writer_defl(struct writer *w, const void *data, int size,
+                        tdefl_flush flush)
+{
+    tdefl_status s;
+
+    if (w->failed)
+        return;
+
+    s = tdefl_compress_buffer(w->defl, data, size, flush);
+
+    if (s != TDEFL_STATUS_OKAY && s != TDEFL_STATUS_DONE && !w->failed)
+    {
+        log_printf("Failure to deflate replay data\n");
+        w->failed = 1;
+    }
+}
+
+/*
+ * Carry out a request.  Returns 0 once the file is closed.
+ */
+static int writer_run(struct writer *w, struct op *op)
+{
+    long end;
+
+    switch (op->type)
+    {
+    case OP_WRITE:
+        if (w->defl)
+            writer_defl(w, op->block, op->size, TDEFL_NO_FLUSH);
+        else
+            writer_out(op->block, op->size, w);
+
+        block_put(w, op->block);
+        break;
+
+    case OP_PATCH:
+        if ((end = fs_tell(w->fp)) >= 0 &&
+            fs_seek(w->fp, op->pos, SEEK_SET) == 0)
+        {
+            fs_write(op->patch, op->size, w->fp);
+            fs_seek(w->fp, end, SEEK_SET);
+        }
+        break;
+
+    case OP_DEFLATE:
+        w->defl = op->defl;
+        break;
+
+    case OP_CLOSE:
+        if (w->defl)
+        {
+            writer_defl(w, NULL, 0, TDEFL_FINISH);
+            tdefl_compressor_free(w->defl);
+            w->defl = NULL;
+        }
+
+        fs_close(w->fp);
+        w->fp = NULL;
+
+        if (op->fn)
+            op->fn(op->data);
+
+        return 0;
+    }
+    return 1;
+}
+
+static int writer_main(void *data)
+{
+    struct writer *w = data;
+    struct op *op;
+    int run = 1;
+
+    while (run)
+    {
+        SDL_SemWait(w->wake);
+        SDL_MemoryBarrierAcquire();
+
+        op  = w->ops + SDL_AtomicGet(&w->op_ring.head) % WRITER_OPS;
+        run = writer_run(w, op);
+
+        ring_take(&w->op_ring);
+    }
+
+    SDL_SemPost(w->done);
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Return a free request slot.  A full ring means the disk is far
+ * behind, and then there is nothing to do but wait for it.
+ */
+static struct op *op_next(struct writer *w)
+{
+    while (ring_len(&w->op_ring) >= WRITER_OPS)
+        SDL_Delay(1);
+
+    return w->ops + SDL_AtomicGet(&w->op_ring.tail) % WRITER_OPS;
+}
+
+static void op_send(struct writer *w, struct op *op)
+{
+    if (w->thread)
+    {
+        ring_fill(&w->op_ring);
+        SDL_SemPost(w->wake);
+    }
+    else writer_run(w, op);
+}
+
+static void writer_send_block(struct writer *w)
+{
+    struct op *op;
+
+    if (w->block && w->len)
+    {
+        op = op_next(w);
+
+        op->type  = OP_WRITE;
+        op->block = w->block;
+        op->size  = w->len;
+
+        op_send(w, op);
+
+        w->block = NULL;
+        w->len   = 0;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+struct writer *writer_open(const char *path)
+{
+    struct writer *w;
+
+    if ((w = calloc(1, sizeof (*w))))
+    {
+        w->raw = -1;
+
+        if ((w->fp = fs_open_write(path)))
+        {
+#ifndef __EMSCRIPTEN__
+            w->wake = SDL_CreateSemaphore(0);
+            w->done = SDL_CreateSemaphore(0);
+
+            if (w->wake && w->done)
+                w->thread = SDL_CreateThread(writer_main, "writer", w);
+#endif
+            /* Without a thread, requests are carried out as queued. */
+
+            if (!w->thread)
+                log_printf("Writing \"%s\" on the calling thread\n", path);
+
+            return w;
+        }
+        free(w);
+    }
+    return NULL;
+}
+
+/*
+ * Append bytes to the file.
+ */
+int writer_put(struct writer *w, const void *data, int size)
+{
+    const unsigned char *p = data;
+    int n;
+
+    while (size > 0)
+    {
+        if (!w->block && !(w->block = block_get(w)))
+            return 0;
+
+        n = MIN(size, WRITER_BLOCK - w->len);
+
+        memcpy(w->block + w->len, p, n);
+
+        w->len += n;
+        w->put += n;
+        p      += n;
+        size   -= n;
+
+        if (w->len == WRITER_BLOCK)
+            writer_send_block(w);
+    }
+    return 1;
+}
+
+/*
+ * Deflate, as a zlib stream, everything put from here on.
+ */
+int writer_deflate(struct writer *w)
+{
+    tdefl_compressor *defl;
+    struct op *op;
+
+    if (w->raw >= 0 || !(defl = tdefl_compressor_alloc()))
+        return 0;
+
+    if (tdefl_init(defl, writer_out, w, (TDEFL_WRITE_ZLIB_HEADER |
+                                         TDEFL_DEFAULT_MAX_PROBES)) !=
+        TDEFL_STATUS_OKAY)
+    {
+        tdefl_compressor_free(defl);
+        return 0;
+    }
+
+    writer_send_block(w);
+
+    op = op_next(w);
+
+    op->type = OP_DEFLATE;
+    op->defl = defl;
+
+    op_send(w, op);
+
+    w->raw = w->put;
+
+    return 1;
+}
+
+/*
+ * Overwrite a few bytes already put, such as a header field.  Deflated
+ * bytes cannot be patched.
+ */
+int writer_patch(struct writer *w, long pos, const void *data, int size)
+{
+    struct op *op;
+
+    if (size > WRITER_PATCH_MAX)
+        return 0;
+
+    if (w->raw >= 0 && pos + size > w->raw)
+        return 0;
+
+    writer_send_block(w);
+
+    op = op_next(w);
+
+    op->type = OP_PATCH;
+    op->pos  = pos;
+    op->size = size;
+
+    memcpy(op->patch, data, size);
+
+    op_send(w, op);
+
+    return 1;
+}
+
+/*
+ * Queue the rest of the file and its closing, and after that FN.
+ */
+void writer_close(struct writer *w, void (*fn)(void *), void *data)
+{
+    struct op *op;
+
+    writer_send_block(w);
+
+    op = op_next(w);
+
+    op->type = OP_CLOSE;
+    op->fn   = fn;
+    op->data = data;
+
+    op_send(w, op);
+}
+
+/*
+ * Wait up to MS milliseconds, or for good if MS is negative, for a
+ * closed writer to finish.  If it has, free it and return 1.
+ */
+int writer_wait(struct writer *w, int ms)
+{
+    unsigned char *block;
+
+    if (w->thread)
+    {
+        if ((ms < 0 ? SDL_SemWait(w->done) : SDL_SemWaitTimeout(w->done, ms)))
+            return 0;
+
+        SDL_WaitThread(w->thread, NULL);
+    }
+
+    while (ring_len(&w->free_ring))
+    {
+        block = block_get(w);
+        free(block);
+    }
+
+    free(w->block);
+
+    if (w->wake) SDL_DestroySemaphore(w->wake);
+    if (w->done) SDL_DestroySemaphore(w->done);
+
+    free(w);
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2025 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+/*
+ * Background file writer.
+ *
+ * Bytes put to a writer are gathered into large blocks that a thread
+ * of its own writes out, so a slow disk does not hold up the caller.
+ * Blocks and requests pass between the two threads through lock-free
+ * single-producer, single-consumer rings.  Where threads are not
+ * available, writes happen on the calling thread.
+ *
+ * All calls are made from one thread.  After writer_deflate, bytes
+ * put are deflated on the writer thread on their way to the file.
+ * writer_close queues the end of the file and, after it, a function to
+ * run on the writer thread; writer_wait then waits for both and frees
+ * the writer.
+ */
+
+/*---------------------------------------------------------------------------*/
+
+#define WRITER_PATCH_MAX 16
+
+struct writer;
+
+struct writer *writer_open(const char *path);
+
+int  writer_put    (struct writer *, const void *data, int size);
+int  writer_patch  (struct writer *, long pos, const void *data, int size);
+int  writer_deflate(struct writer *);
+void writer_close  (struct writer *, void (*fn)(void *), void *data);
+int  writer_wait   (struct writer *, int ms);
+
+/*---------------------------------------------------------------------------*/
+
+#endif